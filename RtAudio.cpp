@@ -41,6 +41,10 @@
 // RtAudio: Version 4.0.10
 
 #include "RtAudio.h"
+#include "RtConvert.h"
+#include "RtConvertPool.h"
+#include "RtMix.h"
+#include "RtResample.h"
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
@@ -67,6 +71,21 @@ const unsigned int RtApi::SAMPLE_RATES[] = {
 #else
   #define MUTEX_INITIALIZE(A) abs(*A) // dummy definitions
   #define MUTEX_DESTROY(A)    abs(*A) // dummy definitions
+  #define MUTEX_LOCK(A)       abs(*A) // dummy definitions
+  #define MUTEX_UNLOCK(A)     abs(*A) // dummy definitions
+#endif
+
+// Loads and stores of an int-sized value that other threads make
+// without the mutex: an acquire load and a release store.
+#if defined(__WINDOWS_DS__) || defined(__WINDOWS_ASIO__)
+  #define ATOMIC_LOAD(A)      InterlockedCompareExchange( (volatile LONG *) (A), 0, 0 )
+  #define ATOMIC_STORE(A, B)  InterlockedExchange( (volatile LONG *) (A), (LONG) (B) )
+#elif defined(__GNUC__)
+  #define ATOMIC_LOAD(A)      __atomic_load_n( A, __ATOMIC_ACQUIRE )
+  #define ATOMIC_STORE(A, B)  __atomic_store_n( A, B, __ATOMIC_RELEASE )
+#else
+  #define ATOMIC_LOAD(A)      ( *(volatile int *) (A) ) // dummy definitions
+  #define ATOMIC_STORE(A, B)  ( *(volatile int *) (A) = (int) (B) ) // dummy definitions
 #endif
 
 // *************************************************** //
@@ -205,6 +224,8 @@ RtApi :: RtApi()
 
 RtApi :: ~RtApi()
 {
+  for ( int i=0; i<2; i++ ) delete stream_.resample[i].resampler;
+  stopConvertPool();
   MUTEX_DESTROY( &stream_.mutex );
 }
 
@@ -240,6 +261,18 @@ void RtApi :: openStream( RtAudio::StreamParameters *oParams,
     error( RtError::INVALID_USE );
   }
 
+  if ( oParams && oParams->mixChannels > 0 &&
+       oParams->mixMatrix.size() != oParams->nChannels * oParams->mixChannels ) {
+    errorText_ = "RtApi::openStream: the output mixMatrix must hold nChannels times mixChannels gains.";
+    error( RtError::INVALID_USE );
+  }
+
+  if ( iParams && iParams->mixChannels > 0 &&
+       iParams->mixMatrix.size() != iParams->nChannels * iParams->mixChannels ) {
+    errorText_ = "RtApi::openStream: the input mixMatrix must hold nChannels times mixChannels gains.";
+    error( RtError::INVALID_USE );
+  }
+
   unsigned int nDevices = getDeviceCount();
   unsigned int oChannels = 0;
   if ( oParams ) {
@@ -260,25 +293,63 @@ void RtApi :: openStream( RtAudio::StreamParameters *oParams,
   }
 
   clearStreamInfo();
+  if ( options && options->flags & RTAUDIO_CLIP_METER ) stream_.clipMeter = true;
   bool result;
 
+  // A direction with a mixing matrix opens the device channels of the
+  // mix, and the mix is put in front of (or after) their conversion.
+  // A matrix that changes nothing is left out.
+  unsigned int oDeviceChannels = oChannels;
+  if ( oParams && oParams->mixChannels > 0 &&
+       !rtMixIdentity( oParams->mixMatrix, oChannels, oParams->mixChannels ) ) {
+    stream_.doMix[0] = true;
+    oDeviceChannels = oParams->mixChannels;
+  }
+
+  unsigned int iDeviceChannels = iChannels;
+  if ( iParams && iParams->mixChannels > 0 &&
+       !rtMixIdentity( iParams->mixMatrix, iParams->mixChannels, iChannels ) ) {
+    stream_.doMix[1] = true;
+    iDeviceChannels = iParams->mixChannels;
+  }
+
   if ( oChannels > 0 ) {
 
-    result = probeDeviceOpen( oParams->deviceId, OUTPUT, oChannels, oParams->firstChannel,
+    result = probeDeviceOpen( oParams->deviceId, OUTPUT, oDeviceChannels, oParams->firstChannel,
                               sampleRate, format, bufferFrames, options );
     if ( result == false ) error( RtError::SYSTEM_ERROR );
+
+    if ( stream_.doMix[0] && setMixInfo( OUTPUT, oChannels, oParams->mixMatrix ) == FAILURE ) {
+      closeStream();
+      error( RtError::SYSTEM_ERROR );
+    }
   }
 
   if ( iChannels > 0 ) {
 
-    result = probeDeviceOpen( iParams->deviceId, INPUT, iChannels, iParams->firstChannel,
+    result = probeDeviceOpen( iParams->deviceId, INPUT, iDeviceChannels, iParams->firstChannel,
                               sampleRate, format, bufferFrames, options );
     if ( result == false ) {
       if ( oChannels > 0 ) closeStream();
       error( RtError::SYSTEM_ERROR );
     }
+
+    if ( stream_.doMix[1] && setMixInfo( INPUT, iChannels, iParams->mixMatrix ) == FAILURE ) {
+      closeStream();
+      error( RtError::SYSTEM_ERROR );
+    }
   }
 
+  // A non-interleaved zero-copy direction hands the callback one
+  // pointer per channel, since JACK ports are not adjacent in memory.
+  if ( options && options->flags & RTAUDIO_ZERO_COPY && !stream_.userInterleaved ) {
+    stream_.channelPointers = true;
+    stream_.channelBuffer[0].resize( oChannels );
+    stream_.channelBuffer[1].resize( iChannels );
+  }
+
+  startConvertPool( options );
+
   stream_.callbackInfo.callback = (void *) callback;
   stream_.callbackInfo.userData = userData;
 
@@ -326,6 +397,16 @@ void RtApi :: tickStreamTime( void )
 #endif
 }
 
+RtApi::StreamState RtApi :: streamState( void )
+{
+  return (StreamState) ATOMIC_LOAD( &stream_.state );
+}
+
+void RtApi :: setStreamState( StreamState state )
+{
+  ATOMIC_STORE( &stream_.state, state );
+}
+
 long RtApi :: getStreamLatency( void )
 {
   verifyStream();
@@ -339,6 +420,92 @@ long RtApi :: getStreamLatency( void )
   return totalLatency;
 }
 
+long RtApi :: getStreamDuplexOffset( void )
+{
+  verifyStream();
+  return stream_.duplexOffset;
+}
+
+std::string RtApi :: getStreamConversion( void )
+{
+  verifyStream();
+
+  std::string conversion;
+  const char *direction[2] = { "output: ", "input: " };
+  for ( int i=0; i<2; i++ ) {
+    if ( i > 0 ) conversion += "; ";
+    conversion += direction[i];
+    if ( stream_.mode != i && stream_.mode != DUPLEX )
+      conversion += "unused";
+    else if ( stream_.resample[i].resampler ) {
+      ResampleInfo &info = stream_.resample[i];
+      std::ostringstream rates;
+      rates << ( i == 0 ? stream_.sampleRate : info.deviceRate ) << " Hz to "
+            << ( i == 0 ? info.deviceRate : stream_.sampleRate ) << " Hz";
+      ConvertInfo &first = ( i == 0 ) ? stream_.convertInfo[i] : info.convert;
+      ConvertInfo &last = ( i == 0 ) ? info.convert : stream_.convertInfo[i];
+      conversion += conversionName( first ) + ", then resampled from " + rates.str() + " (" +
+        info.resampler->name() + "), then " + conversionName( last );
+    }
+    else if ( stream_.doConvertBuffer[i] ) {
+      conversion += conversionName( stream_.convertInfo[i] );
+      if ( stream_.mapped[i] ) conversion += ( i == 0 ) ? ", into the mmap area" : ", out of the mmap area";
+    }
+    else
+      conversion += "none";
+  }
+
+  return conversion;
+}
+
+bool RtApi :: isStreamZeroCopy( void )
+{
+  verifyStream();
+
+  for ( int i=0; i<2; i++ )
+    if ( ( stream_.mode == i || stream_.mode == DUPLEX ) && !stream_.zeroCopy[i] ) return false;
+
+  return true;
+}
+
+RtAudio::ClipInfo RtApi :: getStreamClipping( void )
+{
+  verifyStream();
+
+  MUTEX_LOCK( &stream_.mutex );
+  RtAudio::ClipInfo clipping = stream_.clipping;
+  MUTEX_UNLOCK( &stream_.mutex );
+
+  return clipping;
+}
+
+RtAudio::ConvertTiming RtApi :: getStreamConvertTiming( void )
+{
+  verifyStream();
+
+  MUTEX_LOCK( &stream_.mutex );
+  RtAudio::ConvertTiming timing = stream_.convertTiming;
+  MUTEX_UNLOCK( &stream_.mutex );
+
+  if ( timing.conversions > 0 )
+    timing.saved = ( timing.work - timing.parallel ) / timing.conversions * stream_.sampleRate / stream_.bufferSize;
+  return timing;
+}
+
+RtAudio::WakeTiming RtApi :: getStreamWakeTiming( void )
+{
+  verifyStream();
+
+  MUTEX_LOCK( &stream_.mutex );
+  RtAudio::WakeTiming timing = stream_.wakeTiming;
+  unsigned long intervals = stream_.wakeIntervals;
+  MUTEX_UNLOCK( &stream_.mutex );
+
+  if ( timing.wakeups > 0 ) timing.meanLate /= timing.wakeups;
+  if ( intervals > 0 ) timing.meanJitter /= intervals;
+  return timing;
+}
+
 double RtApi :: getStreamTime( void )
 {
   verifyStream();
@@ -1170,6 +1337,8 @@ bool RtApiCore :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   }
   else if ( monoMode && stream_.userInterleaved )
     stream_.doConvertBuffer[mode] = true;
+  if ( stream_.doMix[mode] )
+    stream_.doConvertBuffer[mode] = true;
 
   // Allocate our CoreHandle structure for the stream.
   CoreHandle *handle = 0;
@@ -1338,6 +1507,7 @@ void RtApiCore :: closeStream( void )
   delete handle;
   stream_.apiHandle = 0;
 
+  stopConvertPool();
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
 }
@@ -1507,7 +1677,8 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
       handle->xrun[1] = false;
     }
 
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+    handle->drainCounter = callback( callbackBuffer( OUTPUT, stream_.userBuffer[0] ),
+                                     callbackBuffer( INPUT, stream_.userBuffer[1] ),
                                      stream_.bufferSize, streamTime, status, info->userData );
     if ( handle->drainCounter == 2 ) {
       MUTEX_UNLOCK( &stream_.mutex );
@@ -2118,6 +2289,13 @@ bool RtApiJack :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
+  if ( stream_.doMix[mode] )
+    stream_.doConvertBuffer[mode] = true;
+
+  // Without a conversion, the callback can use the port buffers themselves.
+  stream_.zeroCopy[mode] = false;
+  if ( options && options->flags & RTAUDIO_ZERO_COPY && !stream_.doConvertBuffer[mode] )
+    stream_.zeroCopy[mode] = true;
 
   // Allocate our JackHandle structure for the stream.
   if ( handle == 0 ) {
@@ -2281,6 +2459,7 @@ void RtApiJack :: closeStream( void )
     stream_.deviceBuffer = 0;
   }
 
+  stopConvertPool();
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
 }
@@ -2471,7 +2650,25 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+
+    // A zero-copy direction is handed the port buffers for this cycle
+    // (a single port when the stream is interleaved, so mono).
+    void *buffers[2];
+    for ( int i=0; i<2; i++ ) {
+      if ( stream_.zeroCopy[i] ) {
+        if ( stream_.channelPointers ) {
+          for ( unsigned int j=0; j<stream_.nUserChannels[i]; j++ )
+            stream_.channelBuffer[i][j] = jack_port_get_buffer( handle->ports[i][j], (jack_nframes_t) nframes );
+          buffers[i] = (void *) &stream_.channelBuffer[i][0];
+        }
+        else
+          buffers[i] = jack_port_get_buffer( handle->ports[i][0], (jack_nframes_t) nframes );
+      }
+      else
+        buffers[i] = callbackBuffer( (StreamMode) i, stream_.userBuffer[i] );
+    }
+
+    handle->drainCounter = callback( buffers[0], buffers[1],
                                      stream_.bufferSize, streamTime, status, info->userData );
     if ( handle->drainCounter == 2 ) {
       MUTEX_UNLOCK( &stream_.mutex );
@@ -2504,7 +2701,7 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
         memcpy( jackbuffer, &stream_.deviceBuffer[i*bufferBytes], bufferBytes );
       }
     }
-    else { // no buffer conversion
+    else if ( !stream_.zeroCopy[0] ) { // no buffer conversion
       for ( unsigned int i=0; i<stream_.nUserChannels[0]; i++ ) {
         jackbuffer = (jack_default_audio_sample_t *) jack_port_get_buffer( handle->ports[0][i], (jack_nframes_t) nframes );
         memcpy( jackbuffer, &stream_.userBuffer[0][i*bufferBytes], bufferBytes );
@@ -2526,7 +2723,7 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
       }
       convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
     }
-    else { // no buffer conversion
+    else if ( !stream_.zeroCopy[1] ) { // no buffer conversion
       for ( unsigned int i=0; i<stream_.nUserChannels[1]; i++ ) {
         jackbuffer = (jack_default_audio_sample_t *) jack_port_get_buffer( handle->ports[1][i], (jack_nframes_t) nframes );
         memcpy( &stream_.userBuffer[1][i*bufferBytes], jackbuffer, bufferBytes );
@@ -3012,6 +3209,8 @@ bool RtApiAsio :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
+  if ( stream_.doMix[mode] )
+    stream_.doConvertBuffer[mode] = true;
 
   // Allocate necessary internal buffers
   unsigned long bufferBytes;
@@ -3138,6 +3337,7 @@ void RtApiAsio :: closeStream()
     stream_.deviceBuffer = 0;
   }
 
+  stopConvertPool();
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
 }
@@ -3300,7 +3500,8 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
       status |= RTAUDIO_INPUT_OVERFLOW;
       asioXRun = false;
     }
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+    handle->drainCounter = callback( callbackBuffer( OUTPUT, stream_.userBuffer[0] ),
+                                     callbackBuffer( INPUT, stream_.userBuffer[1] ),
                                      stream_.bufferSize, streamTime, status, info->userData );
     if ( handle->drainCounter == 2 ) {
       //      MUTEX_UNLOCK( &stream_.mutex );
@@ -3331,11 +3532,8 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
     }
     else if ( stream_.doConvertBuffer[0] ) {
 
+      // The conversion also does any byte swapping.
       convertBuffer( stream_.deviceBuffer, stream_.userBuffer[0], stream_.convertInfo[0] );
-      if ( stream_.doByteSwap[0] )
-        byteSwapBuffer( stream_.deviceBuffer,
-                        stream_.bufferSize * stream_.nDeviceChannels[0],
-                        stream_.deviceFormat[0] );
 
       for ( i=0, j=0; i<nChannels; i++ ) {
         if ( handle->bufferInfos[i].isInput != ASIOTrue )
@@ -3379,10 +3577,7 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
                   bufferBytes );
       }
 
-      if ( stream_.doByteSwap[1] )
-        byteSwapBuffer( stream_.deviceBuffer,
-                        stream_.bufferSize * stream_.nDeviceChannels[1],
-                        stream_.deviceFormat[1] );
+      // The conversion also does any byte swapping.
       convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
 
     }
@@ -4226,6 +4421,8 @@ bool RtApiDs :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
+  if ( stream_.doMix[mode] )
+    stream_.doConvertBuffer[mode] = true;
 
   // Allocate necessary internal buffers
   long bufferBytes = stream_.nUserChannels[mode] * *bufferSize * formatBytes( stream_.userFormat );
@@ -4395,6 +4592,7 @@ void RtApiDs :: closeStream()
     stream_.deviceBuffer = 0;
   }
 
+  stopConvertPool();
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
 }
@@ -4634,7 +4832,8 @@ void RtApiDs :: callbackEvent()
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+    handle->drainCounter = callback( callbackBuffer( OUTPUT, stream_.userBuffer[0] ),
+                                     callbackBuffer( INPUT, stream_.userBuffer[1] ),
                                      stream_.bufferSize, streamTime, status, info->userData );
     if ( handle->drainCounter == 2 ) {
       //      MUTEX_UNLOCK( &stream_.mutex );
@@ -4738,7 +4937,8 @@ void RtApiDs :: callbackEvent()
     LPDIRECTSOUNDBUFFER dsBuffer = (LPDIRECTSOUNDBUFFER) handle->buffer[0];
 
     if ( handle->drainCounter > 1 ) { // write zeros to the output stream
-      bufferBytes = stream_.bufferSize * stream_.nUserChannels[0];
+      bufferBytes = stream_.bufferSize;
+      bufferBytes *= stream_.doMix[0] ? stream_.convertInfo[0].mix.inChannels : stream_.nUserChannels[0];
       bufferBytes *= formatBytes( stream_.userFormat );
       memset( stream_.userBuffer[0], 0, bufferBytes );
     }
@@ -5143,6 +5343,15 @@ static const char* getErrorString( int code )
 
 #include <alsa/asoundlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+// The most threads that probe devices at once.
+static const unsigned int ALSA_PROBE_THREADS = 8;
 
   // A structure to hold various information related to the ALSA API
   // implementation.
@@ -5150,43 +5359,156 @@ struct AlsaHandle {
   snd_pcm_t *handles[2];
   bool synchronized;
   bool xrun[2];
+  bool mmap[2];
   pthread_cond_t runnable_cv;
   bool runnable;
+  std::vector<struct pollfd> fds[2];
+  snd_pcm_uframes_t availMin[2];
+  snd_pcm_uframes_t ring[2];
+  double lastWake;
+  bool realign;
+  unsigned long prime;
+  std::vector<char> silence;
+  bool parked;
+  bool draining;
+  int wake;
 
   AlsaHandle()
-    :synchronized(false), runnable(false) { xrun[0] = false; xrun[1] = false; }
+    :synchronized(false), runnable(false), lastWake(0.0), realign(false), prime(0), parked(false), draining(false), wake(-1) { xrun[0] = false; xrun[1] = false; mmap[0] = false; mmap[1] = false; availMin[0] = 0; availMin[1] = 0; ring[0] = 0; ring[1] = 0; }
 };
 
 extern "C" void *alsaCallbackHandler( void * ptr );
 
 RtApiAlsa :: RtApiAlsa()
+  : watch_( -1 ), scanned_( false ), filled_( false )
 {
-  // Nothing to do here.
+  // Watch /dev/snd for cards coming and going, so that the devices
+  // found and probed are kept until then (see scanDevices).
+  watch_ = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+  if ( watch_ >= 0 && inotify_add_watch( watch_, "/dev/snd", IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO ) < 0 ) {
+    close( watch_ );
+    watch_ = -1;
+  }
 }
 
 RtApiAlsa :: ~RtApiAlsa()
 {
   if ( stream_.state != STREAM_CLOSED ) closeStream();
+  if ( watch_ >= 0 ) close( watch_ );
 }
 
 unsigned int RtApiAlsa :: getDeviceCount( void )
 {
-  unsigned nDevices = 0;
+  // Without a watch on /dev/snd, each count finds the devices afresh.
+  scanDevices( watch_ < 0 );
+  return cards_.size();
+}
+
+RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
+{
+  RtAudio::DeviceInfo info;
+  info.probed = false;
+
+  scanDevices( false );
+  if ( cards_.size() == 0 ) {
+    errorText_ = "RtApiAlsa::getDeviceInfo: no devices found!";
+    error( RtError::INVALID_USE );
+  }
+
+  if ( device >= cards_.size() ) {
+    errorText_ = "RtApiAlsa::getDeviceInfo: device ID is invalid!";
+    error( RtError::INVALID_USE );
+  }
+
+  if ( cached_[device] ) return devices_[device];
+
+  // If a stream is already open, we cannot probe the stream devices.
+  // Their info is cached before the stream opens, unless they were not
+  // present then.
+  if ( stream_.state != STREAM_CLOSED &&
+       ( stream_.device[0] == device || stream_.device[1] == device ) ) {
+    errorText_ = "RtApiAlsa::getDeviceInfo: device ID was not present before stream was opened.";
+    error( RtError::WARNING );
+    return info;
+  }
+
+  // The first miss after a scan probes every device at once; a probe
+  // that failed then is tried again alone.
+  if ( !filled_ ) {
+    saveDeviceInfo();
+
+    // saveDeviceInfo scans again, and a card removed in between takes
+    // its devices with it.
+    if ( device >= cards_.size() ) {
+      errorText_ = "RtApiAlsa::getDeviceInfo: device ID is no longer present.";
+      error( RtError::WARNING );
+      return info;
+    }
+    return devices_[device];
+  }
+
+  std::ostringstream warnings;
+  devices_[device] = probeDevice( device, warnings );
+  cached_[device] = devices_[device].probed;
+  reportWarnings( warnings );
+  return devices_[device];
+}
+
+void RtApiAlsa :: scanDevices( bool force )
+{
+  // Find the devices of every card, unless those found last time still
+  // stand.  The watch on /dev/snd reports the device files each card
+  // adds or removes (controlC0, pcmC0D0p and so on), and the probes of
+  // the devices on other cards are kept.  Without the watch, a forced
+  // scan keeps only the probes of an open stream's devices, which
+  // cannot be probed again while it is open.
+  std::vector<int> changed;
+  bool all = ( watch_ < 0 );
+  bool stale = force || !scanned_;
+
+  if ( watch_ >= 0 ) {
+    char events[4096] __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    ssize_t length;
+    bool lost = false;
+    while ( ( length = read( watch_, events, sizeof( events ) ) ) > 0 ) {
+      stale = true;
+      for ( char *p = events; p < events + length; ) {
+        const struct inotify_event *event = (const struct inotify_event *) p;
+        p += sizeof( struct inotify_event ) + event->len;
+        int card;
+        if ( event->mask & IN_IGNORED ) lost = true;
+        if ( event->mask & ( IN_Q_OVERFLOW | IN_IGNORED ) )
+          all = true;
+        else if ( event->len && ( sscanf( event->name, "controlC%d", &card ) == 1 || sscanf( event->name, "pcmC%d", &card ) == 1 ) )
+          changed.push_back( card );
+      }
+    }
+
+    // /dev/snd itself went away, and nothing more will be reported.
+    if ( lost ) {
+      close( watch_ );
+      watch_ = -1;
+    }
+  }
+
+  if ( !stale ) return;
+
+  std::vector<int> cards, pcms;
   int result, subdevice, card;
   char name[64];
   snd_ctl_t *handle;
 
-  // Count cards and devices
   card = -1;
   snd_card_next( &card );
   while ( card >= 0 ) {
     sprintf( name, "hw:%d", card );
-    result = snd_ctl_open( &handle, name, 0 );
+    result = snd_ctl_open( &handle, name, SND_CTL_NONBLOCK );
     if ( result < 0 ) {
       errorStream_ << "RtApiAlsa::getDeviceCount: control open, card = " << card << ", " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
       error( RtError::WARNING );
-      goto nextcard;
+      snd_card_next( &card );
+      continue;
     }
     subdevice = -1;
     while( 1 ) {
@@ -5199,82 +5521,65 @@ unsigned int RtApiAlsa :: getDeviceCount( void )
       }
       if ( subdevice < 0 )
         break;
-      nDevices++;
+      cards.push_back( card );
+      pcms.push_back( subdevice );
     }
-  nextcard:
     snd_ctl_close( handle );
     snd_card_next( &card );
   }
 
-  return nDevices;
+  // Carry the probes over to the new device numbers.
+  std::vector<RtAudio::DeviceInfo> devices( cards.size() );
+  std::vector<bool> cached( cards.size(), false );
+  for ( unsigned int i=0; i<cards_.size(); i++ ) {
+    if ( !cached_[i] ) continue;
+    bool keep = !all || ( stream_.state != STREAM_CLOSED && ( stream_.device[0] == i || stream_.device[1] == i ) );
+    for ( unsigned int k=0; keep && k<changed.size(); k++ )
+      if ( changed[k] == cards_[i] ) keep = false;
+    for ( unsigned int j=0; keep && j<cards.size(); j++ ) {
+      if ( cards[j] != cards_[i] || pcms[j] != pcms_[i] ) continue;
+      devices[j] = devices_[i];
+      cached[j] = true;
+      break;
+    }
+  }
+
+  // The default devices are the first ones found.
+  for ( unsigned int j=0; j<devices.size(); j++ ) {
+    if ( !cached[j] ) continue;
+    devices[j].isDefaultOutput = ( j == 0 && devices[j].outputChannels > 0 );
+    devices[j].isDefaultInput = ( j == 0 && devices[j].inputChannels > 0 );
+  }
+
+  cards_.swap( cards );
+  pcms_.swap( pcms );
+  devices_.swap( devices );
+  cached_.swap( cached );
+  scanned_ = true;
+  filled_ = false;
 }
 
-RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
+RtAudio::DeviceInfo RtApiAlsa :: probeDevice( unsigned int device, std::ostringstream &warnings )
 {
+  // Probe a device found by the last scan.  Any warnings go to
+  // warnings instead of error(), since several probes may run at once
+  // (see saveDeviceInfo).
   RtAudio::DeviceInfo info;
   info.probed = false;
 
-  unsigned nDevices = 0;
   int result, subdevice, card;
   char name[64];
   snd_ctl_t *chandle;
 
-  // Count cards and devices
-  card = -1;
-  snd_card_next( &card );
-  while ( card >= 0 ) {
-    sprintf( name, "hw:%d", card );
-    result = snd_ctl_open( &chandle, name, SND_CTL_NONBLOCK );
-    if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::getDeviceInfo: control open, card = " << card << ", " << snd_strerror( result ) << ".";
-      errorText_ = errorStream_.str();
-      error( RtError::WARNING );
-      goto nextcard;
-    }
-    subdevice = -1;
-    while( 1 ) {
-      result = snd_ctl_pcm_next_device( chandle, &subdevice );
-      if ( result < 0 ) {
-        errorStream_ << "RtApiAlsa::getDeviceInfo: control next device, card = " << card << ", " << snd_strerror( result ) << ".";
-        errorText_ = errorStream_.str();
-        error( RtError::WARNING );
-        break;
-      }
-      if ( subdevice < 0 ) break;
-      if ( nDevices == device ) {
-        sprintf( name, "hw:%d,%d", card, subdevice );
-        goto foundDevice;
-      }
-      nDevices++;
-    }
-  nextcard:
-    snd_ctl_close( chandle );
-    snd_card_next( &card );
-  }
-
-  if ( nDevices == 0 ) {
-    errorText_ = "RtApiAlsa::getDeviceInfo: no devices found!";
-    error( RtError::INVALID_USE );
-  }
-
-  if ( device >= nDevices ) {
-    errorText_ = "RtApiAlsa::getDeviceInfo: device ID is invalid!";
-    error( RtError::INVALID_USE );
-  }
-
- foundDevice:
-
-  // If a stream is already open, we cannot probe the stream devices.
-  // Thus, use the saved results.
-  if ( stream_.state != STREAM_CLOSED &&
-       ( stream_.device[0] == device || stream_.device[1] == device ) ) {
-    if ( device >= devices_.size() ) {
-      errorText_ = "RtApiAlsa::getDeviceInfo: device ID was not present before stream was opened.";
-      error( RtError::WARNING );
-      return info;
-    }
-    return devices_[ device ];
+  card = cards_[device];
+  subdevice = pcms_[device];
+  sprintf( name, "hw:%d", card );
+  result = snd_ctl_open( &chandle, name, SND_CTL_NONBLOCK );
+  if ( result < 0 ) {
+    warnings << "RtApiAlsa::getDeviceInfo: control open, card = " << card << ", " << snd_strerror( result ) << "." << '\n';
+    return info;
   }
+  sprintf( name, "hw:%d,%d", card, subdevice );
 
   int openMode = SND_PCM_ASYNC;
   snd_pcm_stream_t stream;
@@ -5298,9 +5603,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
 
   result = snd_pcm_open( &phandle, name, stream, openMode | SND_PCM_NONBLOCK );
   if ( result < 0 ) {
-    errorStream_ << "RtApiAlsa::getDeviceInfo: snd_pcm_open error for device (" << name << "), " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: snd_pcm_open error for device (" << name << "), " << snd_strerror( result ) << "." << '\n';
     goto captureProbe;
   }
 
@@ -5308,9 +5611,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   result = snd_pcm_hw_params_any( phandle, params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    errorStream_ << "RtApiAlsa::getDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << "." << '\n';
     goto captureProbe;
   }
 
@@ -5319,9 +5620,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   result = snd_pcm_hw_params_get_channels_max( params, &value );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    errorStream_ << "RtApiAlsa::getDeviceInfo: error getting device (" << name << ") output channels, " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: error getting device (" << name << ") output channels, " << snd_strerror( result ) << "." << '\n';
     goto captureProbe;
   }
   info.outputChannels = value;
@@ -5342,9 +5641,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
 
   result = snd_pcm_open( &phandle, name, stream, openMode | SND_PCM_NONBLOCK);
   if ( result < 0 ) {
-    errorStream_ << "RtApiAlsa::getDeviceInfo: snd_pcm_open error for device (" << name << "), " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: snd_pcm_open error for device (" << name << "), " << snd_strerror( result ) << "." << '\n';
     if ( info.outputChannels == 0 ) return info;
     goto probeParameters;
   }
@@ -5353,9 +5650,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   result = snd_pcm_hw_params_any( phandle, params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    errorStream_ << "RtApiAlsa::getDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << "." << '\n';
     if ( info.outputChannels == 0 ) return info;
     goto probeParameters;
   }
@@ -5363,9 +5658,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   result = snd_pcm_hw_params_get_channels_max( params, &value );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    errorStream_ << "RtApiAlsa::getDeviceInfo: error getting device (" << name << ") input channels, " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: error getting device (" << name << ") input channels, " << snd_strerror( result ) << "." << '\n';
     if ( info.outputChannels == 0 ) return info;
     goto probeParameters;
   }
@@ -5397,9 +5690,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
 
   result = snd_pcm_open( &phandle, name, stream, openMode | SND_PCM_NONBLOCK);
   if ( result < 0 ) {
-    errorStream_ << "RtApiAlsa::getDeviceInfo: snd_pcm_open error for device (" << name << "), " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: snd_pcm_open error for device (" << name << "), " << snd_strerror( result ) << "." << '\n';
     return info;
   }
 
@@ -5407,9 +5698,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   result = snd_pcm_hw_params_any( phandle, params );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
-    errorStream_ << "RtApiAlsa::getDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << ".";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: snd_pcm_hw_params error for device (" << name << "), " << snd_strerror( result ) << "." << '\n';
     return info;
   }
 
@@ -5421,9 +5710,7 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   }
   if ( info.sampleRates.size() == 0 ) {
     snd_pcm_close( phandle );
-    errorStream_ << "RtApiAlsa::getDeviceInfo: no supported sample rates found for device (" << name << ").";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: no supported sample rates found for device (" << name << ")." << '\n';
     return info;
   }
 
@@ -5439,6 +5726,9 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   format = SND_PCM_FORMAT_S24;
   if ( snd_pcm_hw_params_test_format( phandle, params, format ) == 0 )
     info.nativeFormats |= RTAUDIO_SINT24;
+  format = SND_PCM_FORMAT_S24_3LE;
+  if ( snd_pcm_hw_params_test_format( phandle, params, format ) == 0 )
+    info.nativeFormats |= RTAUDIO_SINT24_PACKED;
   format = SND_PCM_FORMAT_S32;
   if ( snd_pcm_hw_params_test_format( phandle, params, format ) == 0 )
     info.nativeFormats |= RTAUDIO_SINT32;
@@ -5451,17 +5741,17 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
 
   // Check that we have at least one supported format
   if ( info.nativeFormats == 0 ) {
-    errorStream_ << "RtApiAlsa::getDeviceInfo: pcm device (" << name << ") data format not supported by RtAudio.";
-    errorText_ = errorStream_.str();
-    error( RtError::WARNING );
+    warnings << "RtApiAlsa::getDeviceInfo: pcm device (" << name << ") data format not supported by RtAudio." << '\n';
     return info;
   }
 
   // Get the device name
   char *cardname;
   result = snd_card_get_name( card, &cardname );
-  if ( result >= 0 )
-    sprintf( name, "hw:%s,%d", cardname, subdevice );
+  if ( result >= 0 ) {
+    snprintf( name, sizeof( name ), "hw:%s,%d", cardname, subdevice );
+    free( cardname );
+  }
   info.name = name;
 
   // That's all ... close the device and return
@@ -5470,14 +5760,77 @@ RtAudio::DeviceInfo RtApiAlsa :: getDeviceInfo( unsigned int device )
   return info;
 }
 
-void RtApiAlsa :: saveDeviceInfo( void )
+void RtApiAlsa :: reportWarnings( std::ostringstream &warnings )
 {
-  devices_.clear();
+  std::string text = warnings.str();
+  while ( !text.empty() ) {
+    size_t end = text.find( '\n' );
+    errorText_ = text.substr( 0, end );
+    error( RtError::WARNING );
+    text.erase( 0, end == std::string::npos ? end : end + 1 );
+  }
+}
 
-  unsigned int nDevices = getDeviceCount();
-  devices_.resize( nDevices );
-  for ( unsigned int i=0; i<nDevices; i++ )
-    devices_[i] = getDeviceInfo( i );
+// The probes that saveDeviceInfo shares between threads.
+struct AlsaProbe {
+  RtApiAlsa *api;
+  std::vector<unsigned int> devices;
+  std::vector<RtAudio::DeviceInfo> info;
+  std::vector<std::ostringstream *> warnings;
+  unsigned int next;
+};
+
+void *RtApiAlsa :: probeThread( void *ptr )
+{
+  AlsaProbe *probe = (AlsaProbe *) ptr;
+  unsigned int k;
+  while ( ( k = __atomic_fetch_add( &probe->next, 1, __ATOMIC_RELAXED ) ) < probe->devices.size() )
+    probe->info[k] = probe->api->probeDevice( probe->devices[k], *probe->warnings[k] );
+  return NULL;
+}
+
+void RtApiAlsa :: saveDeviceInfo( void )
+{
+  // Probe every device not cached yet, except those of an open stream.
+  // Opening a device mostly waits on the kernel, so up to
+  // ALSA_PROBE_THREADS threads probe different devices at once.
+  scanDevices( false );
+  filled_ = true;
+
+  AlsaProbe probe;
+  probe.api = this;
+  probe.next = 0;
+  for ( unsigned int i=0; i<cards_.size(); i++ ) {
+    if ( cached_[i] ) continue;
+    if ( stream_.state != STREAM_CLOSED && ( stream_.device[0] == i || stream_.device[1] == i ) ) continue;
+    probe.devices.push_back( i );
+  }
+  unsigned int count = probe.devices.size();
+  if ( count == 0 ) return;
+  probe.info.resize( count );
+  for ( unsigned int k=0; k<count; k++ )
+    probe.warnings.push_back( new std::ostringstream );
+
+  // Load the configuration here, so that the probes only read it.
+  if ( count > 1 ) snd_config_update();
+
+  pthread_t threads[ALSA_PROBE_THREADS];
+  unsigned int started = 0;
+  while ( started + 1 < ALSA_PROBE_THREADS && started + 1 < count &&
+          pthread_create( &threads[started], NULL, probeThread, &probe ) == 0 )
+    started++;
+  probeThread( &probe );
+  for ( unsigned int t=0; t<started; t++ )
+    pthread_join( threads[t], NULL );
+
+  // Report the warnings in device order, as a serial probe would.
+  for ( unsigned int k=0; k<count; k++ ) {
+    unsigned int i = probe.devices[k];
+    devices_[i] = probe.info[k];
+    cached_[i] = probe.info[k].probed;
+    reportWarnings( *probe.warnings[k] );
+    delete probe.warnings[k];
+  }
 }
 
 bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels,
@@ -5493,56 +5846,27 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
 
   // I'm not using the "plug" interface ... too much inconsistent behavior.
 
-  unsigned nDevices = 0;
-  int result, subdevice, card;
+  int result;
   char name[64];
-  snd_ctl_t *chandle;
 
   if ( options && options->flags & RTAUDIO_ALSA_USE_DEFAULT )
     snprintf(name, sizeof(name), "%s", "default");
   else {
-    // Count cards and devices
-    card = -1;
-    snd_card_next( &card );
-    while ( card >= 0 ) {
-      sprintf( name, "hw:%d", card );
-      result = snd_ctl_open( &chandle, name, SND_CTL_NONBLOCK );
-      if ( result < 0 ) {
-        errorStream_ << "RtApiAlsa::probeDeviceOpen: control open, card = " << card << ", " << snd_strerror( result ) << ".";
-        errorText_ = errorStream_.str();
-        return FAILURE;
-      }
-      subdevice = -1;
-      while( 1 ) {
-        result = snd_ctl_pcm_next_device( chandle, &subdevice );
-        if ( result < 0 ) break;
-        if ( subdevice < 0 ) break;
-        if ( nDevices == device ) {
-          sprintf( name, "hw:%d,%d", card, subdevice );
-          snd_ctl_close( chandle );
-          goto foundDevice;
-        }
-        nDevices++;
-      }
-      snd_ctl_close( chandle );
-      snd_card_next( &card );
-    }
-
-    if ( nDevices == 0 ) {
+    scanDevices( false );
+    if ( cards_.size() == 0 ) {
       // This should not happen because a check is made before this function is called.
       errorText_ = "RtApiAlsa::probeDeviceOpen: no devices found!";
       return FAILURE;
     }
 
-    if ( device >= nDevices ) {
+    if ( device >= cards_.size() ) {
       // This should not happen because a check is made before this function is called.
       errorText_ = "RtApiAlsa::probeDeviceOpen: device ID is invalid!";
       return FAILURE;
     }
+    sprintf( name, "hw:%d,%d", cards_[device], pcms_[device] );
   }
 
- foundDevice:
-
   // The getDeviceInfo() function will not work for a device that is
   // already open.  Thus, we'll probe the system before opening a
   // stream and save the results for use by getDeviceInfo().
@@ -5583,26 +5907,51 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   snd_pcm_hw_params_dump( hw_params, out );
 #endif
 
-  // Set access ... check user preference.
+  // Set access ... check user preference.  For an mmap or zero-copy
+  // stream, try for access to the ring buffer itself.  Only an mmap
+  // stream wants it for non-interleaved buffers, which are then
+  // (de)interleaved straight out of or into the ring.
+  bool mmapAccess = false;
   if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
     stream_.userInterleaved = false;
-    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
-    if ( result < 0 ) {
-      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
-      stream_.deviceInterleaved[mode] =  true;
+    if ( options->flags & RTAUDIO_ALSA_MMAP ) {
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED );
+      if ( result == 0 ) {
+        mmapAccess = true;
+        stream_.deviceInterleaved[mode] =  true;
+      }
+    }
+
+    if ( !mmapAccess ) {
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
+      if ( result < 0 ) {
+        result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
+        stream_.deviceInterleaved[mode] =  true;
+      }
+      else
+        stream_.deviceInterleaved[mode] = false;
     }
-    else
-      stream_.deviceInterleaved[mode] = false;
   }
   else {
     stream_.userInterleaved = true;
-    result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
-    if ( result < 0 ) {
-      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
-      stream_.deviceInterleaved[mode] =  false;
+
+    if ( options && options->flags & ( RTAUDIO_ZERO_COPY | RTAUDIO_ALSA_MMAP ) ) {
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED );
+      if ( result == 0 ) {
+        mmapAccess = true;
+        stream_.deviceInterleaved[mode] =  true;
+      }
+    }
+
+    if ( !mmapAccess ) {
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED );
+      if ( result < 0 ) {
+        result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
+        stream_.deviceInterleaved[mode] =  false;
+      }
+      else
+        stream_.deviceInterleaved[mode] =  true;
     }
-    else
-      stream_.deviceInterleaved[mode] =  true;
   }
 
   if ( result < 0 ) {
@@ -5622,6 +5971,8 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     deviceFormat = SND_PCM_FORMAT_S16;
   else if ( format == RTAUDIO_SINT24 )
     deviceFormat = SND_PCM_FORMAT_S24;
+  else if ( format == RTAUDIO_SINT24_PACKED )
+    deviceFormat = SND_PCM_FORMAT_S24_3LE;
   else if ( format == RTAUDIO_SINT32 )
     deviceFormat = SND_PCM_FORMAT_S32;
   else if ( format == RTAUDIO_FLOAT32 )
@@ -5659,7 +6010,14 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     goto setFormat;
   }
 
-  deviceFormat = SND_PCM_FORMAT_S16;
+  // Many USB and HDMI devices only take packed 24-bit samples.
+  deviceFormat = SND_PCM_FORMAT_S24_3LE;
+  if ( snd_pcm_hw_params_test_format(phandle, hw_params, deviceFormat ) == 0 ) {
+    stream_.deviceFormat[mode] = RTAUDIO_SINT24_PACKED;
+    goto setFormat;
+  }
+
+  deviceFormat = SND_PCM_FORMAT_S16;
   if ( snd_pcm_hw_params_test_format(phandle, hw_params, deviceFormat ) == 0 ) {
     stream_.deviceFormat[mode] = RTAUDIO_SINT16;
     goto setFormat;
@@ -5700,7 +6058,8 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   }
 
   // Set the sample rate.
-  result = snd_pcm_hw_params_set_rate_near( phandle, hw_params, (unsigned int*) &sampleRate, 0 );
+  unsigned int deviceRate = sampleRate;
+  result = snd_pcm_hw_params_set_rate_near( phandle, hw_params, &deviceRate, 0 );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
     errorStream_ << "RtApiAlsa::probeDeviceOpen: error setting sample rate on device (" << name << "), " << snd_strerror( result ) << ".";
@@ -5708,6 +6067,16 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     return FAILURE;
   }
 
+  // A device that cannot run at the requested rate runs the stream at
+  // its own rate, unless the stream asked to be resampled.
+  bool resample = false;
+  if ( deviceRate != sampleRate ) {
+    if ( options && options->resampleQuality != RTAUDIO_RESAMPLE_NONE )
+      resample = true;
+    else
+      sampleRate = deviceRate;
+  }
+
   // Determine the number of channels for this device.  We support a possible
   // minimum device channel number > than the value requested by the user.
   stream_.nUserChannels[mode] = channels;
@@ -5741,9 +6110,12 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     return FAILURE;
   }
 
-  // Set the buffer (or period) size.
+  // Set the buffer (or period) size.  A resampled stream keeps its
+  // buffer size and asks for periods of the same duration.
   int dir = 0;
   snd_pcm_uframes_t periodSize = *bufferSize;
+  if ( resample )
+    periodSize = (snd_pcm_uframes_t) ( (unsigned long long) *bufferSize * deviceRate / sampleRate );
   result = snd_pcm_hw_params_set_period_size_near( phandle, hw_params, &periodSize, &dir );
   if ( result < 0 ) {
     snd_pcm_close( phandle );
@@ -5751,7 +6123,7 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     errorText_ = errorStream_.str();
     return FAILURE;
   }
-  *bufferSize = periodSize;
+  if ( !resample ) *bufferSize = periodSize;
 
   // Set the buffer number, which in ALSA is referred to as the "period".
   unsigned int periods = 0;
@@ -5794,13 +6166,13 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   snd_pcm_sw_params_t *sw_params = NULL;
   snd_pcm_sw_params_alloca( &sw_params );
   snd_pcm_sw_params_current( phandle, sw_params );
-  snd_pcm_sw_params_set_start_threshold( phandle, sw_params, *bufferSize );
+  snd_pcm_sw_params_set_start_threshold( phandle, sw_params, periodSize );
   snd_pcm_sw_params_set_stop_threshold( phandle, sw_params, ULONG_MAX );
   snd_pcm_sw_params_set_silence_threshold( phandle, sw_params, 0 );
 
-  // The following two settings were suggested by Theo Veenker
-  //snd_pcm_sw_params_set_avail_min( phandle, sw_params, *bufferSize );
-  //snd_pcm_sw_params_set_xfer_align( phandle, sw_params, 1 );
+  // Wake the callback thread once a whole period can be transferred
+  // (see RtApiAlsa::waitForPeriod).
+  snd_pcm_sw_params_set_avail_min( phandle, sw_params, periodSize );
 
   // here are two options for a fix
   //snd_pcm_sw_params_set_silence_size( phandle, sw_params, ULONG_MAX );
@@ -5830,6 +6202,20 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
+  if ( resample )
+    stream_.doConvertBuffer[mode] = true;
+  if ( stream_.doMix[mode] )
+    stream_.doConvertBuffer[mode] = true;
+
+  // With mmap access and nothing to convert or swap, the callback can
+  // use the ring buffer itself.  Otherwise the conversion can, unless
+  // the device transfers a varying number of frames.
+  stream_.zeroCopy[mode] = false;
+  stream_.mapped[mode] = false;
+  if ( mmapAccess && !stream_.doConvertBuffer[mode] && !stream_.doByteSwap[mode] )
+    stream_.zeroCopy[mode] = true;
+  if ( mmapAccess && stream_.doConvertBuffer[mode] && !resample )
+    stream_.mapped[mode] = true;
 
   // Allocate the ApiHandle if necessary and then save.
   AlsaHandle *apiInfo = 0;
@@ -5847,6 +6233,14 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
       goto error;
     }
 
+    // Stopping the stream writes to this to wake the callback thread
+    // from its poll.
+    apiInfo->wake = eventfd( 0, EFD_NONBLOCK );
+    if ( apiInfo->wake < 0 ) {
+      errorText_ = "RtApiAlsa::probeDeviceOpen: error creating wake-up descriptor.";
+      goto error;
+    }
+
     stream_.apiHandle = (void *) apiInfo;
     apiInfo->handles[0] = 0;
     apiInfo->handles[1] = 0;
@@ -5855,6 +6249,21 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     apiInfo = (AlsaHandle *) stream_.apiHandle;
   }
   apiInfo->handles[mode] = phandle;
+  {
+    // Save the descriptors the callback thread polls the device with.
+    apiInfo->availMin[mode] = periodSize;
+    apiInfo->ring[mode] = periodSize * periods;
+    int count = snd_pcm_poll_descriptors_count( phandle );
+    apiInfo->fds[mode].resize( count > 0 ? count : 0 );
+    if ( count > 0 ) snd_pcm_poll_descriptors( phandle, &apiInfo->fds[mode][0], count );
+  }
+  apiInfo->mmap[mode] = mmapAccess;
+
+  // Set up the resampler, which decides how many device frames the
+  // device buffer must hold.
+  if ( resample && setResampleInfo( mode, sampleRate, deviceRate, firstChannel,
+                                    options->resampleQuality ) == FAILURE )
+    goto error;
 
   // Allocate necessary internal buffers.
   unsigned long bufferBytes;
@@ -5868,16 +6277,17 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   if ( stream_.doConvertBuffer[mode] ) {
 
     bool makeBuffer = true;
-    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
+    unsigned long frames = resample ? stream_.resample[mode].maxFrames : *bufferSize;
+    bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] ) * frames;
     if ( mode == INPUT ) {
       if ( stream_.mode == OUTPUT && stream_.deviceBuffer ) {
-        unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] );
+        unsigned long framesOut = stream_.resample[0].resampler ? stream_.resample[0].maxFrames : stream_.bufferSize;
+        unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] ) * framesOut;
         if ( bufferBytes <= bytesOut ) makeBuffer = false;
       }
     }
 
     if ( makeBuffer ) {
-      bufferBytes *= *bufferSize;
       if ( stream_.deviceBuffer ) free( stream_.deviceBuffer );
       stream_.deviceBuffer = (char *) calloc( bufferBytes, 1 );
       if ( stream_.deviceBuffer == NULL ) {
@@ -5891,9 +6301,10 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   stream_.nBuffers = periods;
   stream_.device[mode] = device;
   stream_.state = STREAM_STOPPED;
+  stream_.wakeTiming.period = (double) stream_.bufferSize / sampleRate;
 
   // Setup the buffer conversion information structure.
-  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+  if ( stream_.doConvertBuffer[mode] && !resample ) setConvertInfo( mode, firstChannel );
 
   // Setup thread if necessary.
   if ( stream_.mode == OUTPUT && mode == INPUT ) {
@@ -5904,9 +6315,20 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     if ( snd_pcm_link( apiInfo->handles[0], apiInfo->handles[1] ) == 0 )
       apiInfo->synchronized = true;
     else {
-      errorText_ = "RtApiAlsa::probeDeviceOpen: unable to synchronize input and output devices.";
+      errorText_ = "RtApiAlsa::probeDeviceOpen: unable to synchronize input and output devices, aligning them in software.";
       error( RtError::WARNING );
     }
+
+    // Prime the playback device with two periods of silence where its
+    // ring holds them: one to play while the first input period comes
+    // in, one to cover the callback.  Output then lags the input it was
+    // computed from by the primed frames plus the period an input
+    // buffer waits for, unless the callback reads that period in place.
+    apiInfo->prime = apiInfo->availMin[0] * ( apiInfo->ring[0] >= 2 * apiInfo->availMin[0] ? 2 : 1 );
+    apiInfo->silence.assign( apiInfo->availMin[0] * stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] ), 0 );
+    unsigned int outputRate = stream_.resample[0].resampler ? stream_.resample[0].deviceRate : sampleRate;
+    stream_.duplexOffset = (long) ( (unsigned long long) apiInfo->prime * sampleRate / outputRate );
+    if ( !stream_.zeroCopy[1] ) stream_.duplexOffset += stream_.bufferSize;
   }
   else {
     stream_.mode = mode;
@@ -5956,6 +6378,7 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
  error:
   if ( apiInfo ) {
     pthread_cond_destroy( &apiInfo->runnable_cv );
+    if ( apiInfo->wake >= 0 ) close( apiInfo->wake );
     if ( apiInfo->handles[0] ) snd_pcm_close( apiInfo->handles[0] );
     if ( apiInfo->handles[1] ) snd_pcm_close( apiInfo->handles[1] );
     delete apiInfo;
@@ -5986,17 +6409,21 @@ void RtApiAlsa :: closeStream()
   }
 
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
-  stream_.callbackInfo.isRunning = false;
   MUTEX_LOCK( &stream_.mutex );
-  if ( stream_.state == STREAM_STOPPED ) {
-    apiInfo->runnable = true;
-    pthread_cond_signal( &apiInfo->runnable_cv );
-  }
+  bool running = ( stream_.state == STREAM_RUNNING );
+
+  // Let the output stopStream left queued play out before the device
+  // is closed.  The callback thread has to keep running to drain it.
+  if ( !running ) waitForDrain();
+  stream_.callbackInfo.isRunning = false;
+  setStreamState( STREAM_STOPPED );
+  apiInfo->runnable = true;
+  pthread_cond_broadcast( &apiInfo->runnable_cv );
   MUTEX_UNLOCK( &stream_.mutex );
+  eventfd_write( apiInfo->wake, 1 );
   pthread_join( stream_.callbackInfo.thread, NULL );
 
-  if ( stream_.state == STREAM_RUNNING ) {
-    stream_.state = STREAM_STOPPED;
+  if ( running ) {
     if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX )
       snd_pcm_drop( apiInfo->handles[0] );
     if ( stream_.mode == INPUT || stream_.mode == DUPLEX )
@@ -6005,6 +6432,7 @@ void RtApiAlsa :: closeStream()
 
   if ( apiInfo ) {
     pthread_cond_destroy( &apiInfo->runnable_cv );
+    if ( apiInfo->wake >= 0 ) close( apiInfo->wake );
     if ( apiInfo->handles[0] ) snd_pcm_close( apiInfo->handles[0] );
     if ( apiInfo->handles[1] ) snd_pcm_close( apiInfo->handles[1] );
     delete apiInfo;
@@ -6023,6 +6451,7 @@ void RtApiAlsa :: closeStream()
     stream_.deviceBuffer = 0;
   }
 
+  stopConvertPool();
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
 }
@@ -6044,7 +6473,18 @@ void RtApiAlsa :: startStream()
   snd_pcm_state_t state;
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+
+  // Wait for the callback thread to park, so that no transfer it
+  // began before the stream stopped reaches the restarted devices.
+  // This takes no longer than the rest of the buffer it was on, plus
+  // the output stopStream left queued, which is played out first.
+  if ( !pthread_equal( pthread_self(), stream_.callbackInfo.thread ) ) {
+    waitForDrain();
+    while ( !apiInfo->parked )
+      pthread_cond_wait( &apiInfo->runnable_cv, &stream_.mutex );
+  }
+
+  if ( stream_.mode == OUTPUT ) {
     state = snd_pcm_state( handle[0] );
     if ( state != SND_PCM_STATE_PREPARED ) {
       result = snd_pcm_prepare( handle[0] );
@@ -6056,7 +6496,7 @@ void RtApiAlsa :: startStream()
     }
   }
 
-  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && !apiInfo->synchronized ) {
+  if ( stream_.mode == INPUT ) {
     state = snd_pcm_state( handle[1] );
     if ( state != SND_PCM_STATE_PREPARED ) {
       result = snd_pcm_prepare( handle[1] );
@@ -6068,11 +6508,18 @@ void RtApiAlsa :: startStream()
     }
   }
 
-  stream_.state = STREAM_RUNNING;
+  // Start both directions of a duplex stream together.
+  if ( stream_.mode == DUPLEX ) {
+    result = alignDuplex();
+    if ( result < 0 ) goto unlock;
+  }
 
- unlock:
+  setStreamState( STREAM_RUNNING );
+  apiInfo->lastWake = 0.0;
   apiInfo->runnable = true;
-  pthread_cond_signal( &apiInfo->runnable_cv );
+  pthread_cond_broadcast( &apiInfo->runnable_cv );
+
+ unlock:
   MUTEX_UNLOCK( &stream_.mutex );
 
   if ( result >= 0 ) return;
@@ -6088,26 +6535,27 @@ void RtApiAlsa :: stopStream()
     return;
   }
 
-  stream_.state = STREAM_STOPPED;
+  // Stop the callback thread, which parks once the buffer it is on is
+  // through, and wake it if it is waiting on the devices.  Nothing
+  // here waits for the devices, so that the call returns at once.
+  // The callback thread plays out the queued output before it parks.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  bool output = ( stream_.mode == OUTPUT || stream_.mode == DUPLEX );
   MUTEX_LOCK( &stream_.mutex );
-
-  //if ( stream_.state == STREAM_STOPPED ) {
-  //  MUTEX_UNLOCK( &stream_.mutex );
-  //  return;
-  //}
+  setStreamState( STREAM_STOPPED );
+  apiInfo->runnable = false;
+  apiInfo->draining = output && !apiInfo->synchronized;
+  MUTEX_UNLOCK( &stream_.mutex );
+  eventfd_write( apiInfo->wake, 1 );
 
   int result = 0;
-  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
-    if ( apiInfo->synchronized )
-      result = snd_pcm_drop( handle[0] );
-    else
-      result = snd_pcm_drain( handle[0] );
+  if ( output && apiInfo->synchronized ) {
+    result = snd_pcm_drop( handle[0] );
     if ( result < 0 ) {
-      errorStream_ << "RtApiAlsa::stopStream: error draining output pcm device, " << snd_strerror( result ) << ".";
+      errorStream_ << "RtApiAlsa::stopStream: error stopping output pcm device, " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
-      goto unlock;
+      error( RtError::SYSTEM_ERROR );
     }
   }
 
@@ -6116,16 +6564,9 @@ void RtApiAlsa :: stopStream()
     if ( result < 0 ) {
       errorStream_ << "RtApiAlsa::stopStream: error stopping input pcm device, " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
-      goto unlock;
+      error( RtError::SYSTEM_ERROR );
     }
   }
-
- unlock:
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
-
-  if ( result >= 0 ) return;
-  error( RtError::SYSTEM_ERROR );
 }
 
 void RtApiAlsa :: abortStream()
@@ -6137,23 +6578,22 @@ void RtApiAlsa :: abortStream()
     return;
   }
 
-  stream_.state = STREAM_STOPPED;
+  // As in stopStream, without the drain.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   MUTEX_LOCK( &stream_.mutex );
-
-  //if ( stream_.state == STREAM_STOPPED ) {
-  //  MUTEX_UNLOCK( &stream_.mutex );
-  //  return;
-  //}
+  setStreamState( STREAM_STOPPED );
+  apiInfo->runnable = false;
+  MUTEX_UNLOCK( &stream_.mutex );
+  eventfd_write( apiInfo->wake, 1 );
 
   int result = 0;
-  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
   snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
     result = snd_pcm_drop( handle[0] );
     if ( result < 0 ) {
       errorStream_ << "RtApiAlsa::abortStream: error aborting output pcm device, " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
-      goto unlock;
+      error( RtError::SYSTEM_ERROR );
     }
   }
 
@@ -6162,25 +6602,42 @@ void RtApiAlsa :: abortStream()
     if ( result < 0 ) {
       errorStream_ << "RtApiAlsa::abortStream: error aborting input pcm device, " << snd_strerror( result ) << ".";
       errorText_ = errorStream_.str();
-      goto unlock;
+      error( RtError::SYSTEM_ERROR );
     }
   }
-
- unlock:
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
-
-  if ( result >= 0 ) return;
-  error( RtError::SYSTEM_ERROR );
 }
 
 void RtApiAlsa :: callbackEvent()
 {
   AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
-  if ( stream_.state == STREAM_STOPPED ) {
+  if ( streamState() == STREAM_STOPPED ) {
+    // Play out the output stopStream left queued.  The drain blocks
+    // here, off the thread that stopped the stream; waitForDrain cuts
+    // it short if it takes too long.
+    MUTEX_LOCK( &stream_.mutex );
+    bool drain = apiInfo->draining;
+    MUTEX_UNLOCK( &stream_.mutex );
+    if ( drain ) {
+      int result = snd_pcm_drain( apiInfo->handles[0] );
+      if ( result < 0 ) {
+        errorStream_ << "RtApiAlsa::callbackEvent: error draining output pcm device, " << snd_strerror( result ) << ".";
+        errorText_ = errorStream_.str();
+        error( RtError::WARNING );
+      }
+    }
+
+    // Park until the stream starts again (see startStream).
     MUTEX_LOCK( &stream_.mutex );
+    apiInfo->draining = false;
+    apiInfo->parked = true;
+    pthread_cond_broadcast( &apiInfo->runnable_cv );
     while ( !apiInfo->runnable )
       pthread_cond_wait( &apiInfo->runnable_cv, &stream_.mutex );
+    apiInfo->parked = false;
+
+    // Forget the wake-up of the stop.
+    eventfd_t wakes;
+    eventfd_read( apiInfo->wake, &wakes );
 
     if ( stream_.state != STREAM_RUNNING ) {
       MUTEX_UNLOCK( &stream_.mutex );
@@ -6189,12 +6646,31 @@ void RtApiAlsa :: callbackEvent()
     MUTEX_UNLOCK( &stream_.mutex );
   }
 
-  if ( stream_.state == STREAM_CLOSED ) {
+  if ( streamState() == STREAM_CLOSED ) {
     errorText_ = "RtApiAlsa::callbackEvent(): the stream is closed ... this shouldn't happen!";
     error( RtError::WARNING );
     return;
   }
 
+  // Wait until every direction can transfer a whole period.
+  double wake = 0.0, late = 0.0;
+  if ( !waitForPeriod( &wake, &late ) ) return;
+
+  // Map a period of the ring buffer for each zero-copy direction.  A
+  // direction left unmapped goes through the user buffer as usual.
+  char *mapped[2] = { 0, 0 };
+  unsigned long offset[2] = { 0, 0 };
+  if ( stream_.zeroCopy[0] || stream_.zeroCopy[1] ) {
+    MUTEX_LOCK( &stream_.mutex );
+    if ( stream_.state == STREAM_STOPPED ) {
+      MUTEX_UNLOCK( &stream_.mutex );
+      return;
+    }
+    for ( int i=0; i<2; i++ )
+      if ( stream_.zeroCopy[i] ) mapped[i] = mapPeriod( (StreamMode) i, &offset[i] );
+    MUTEX_UNLOCK( &stream_.mutex );
+  }
+
   int doStopStream = 0;
   RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
   double streamTime = getStreamTime();
@@ -6207,7 +6683,8 @@ void RtApiAlsa :: callbackEvent()
     status |= RTAUDIO_INPUT_OVERFLOW;
     apiInfo->xrun[1] = false;
   }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+  doStopStream = callback( callbackBuffer( OUTPUT, mapped[0] ? mapped[0] : stream_.userBuffer[0] ),
+                           callbackBuffer( INPUT, mapped[1] ? mapped[1] : stream_.userBuffer[1] ),
                            stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
 
   if ( doStopStream == 2 ) {
@@ -6220,17 +6697,53 @@ void RtApiAlsa :: callbackEvent()
   // The state might change while waiting on a mutex.
   if ( stream_.state == STREAM_STOPPED ) goto unlock;
 
+  // Account for the wake-up.  The first after a start or an error has
+  // no interval to measure.
+  if ( wake > 0.0 ) {
+    stream_.wakeTiming.wakeups++;
+    stream_.wakeTiming.meanLate += late;
+    if ( late > stream_.wakeTiming.maxLate ) stream_.wakeTiming.maxLate = late;
+    if ( apiInfo->lastWake > 0.0 ) {
+      double jitter = fabs( wake - apiInfo->lastWake - stream_.wakeTiming.period );
+      stream_.wakeIntervals++;
+      stream_.wakeTiming.meanJitter += jitter;
+      if ( jitter > stream_.wakeTiming.maxJitter ) stream_.wakeTiming.maxJitter = jitter;
+    }
+  }
+  apiInfo->lastWake = wake;
+
   int result;
   char *buffer;
   int channels;
   snd_pcm_t **handle;
   snd_pcm_sframes_t frames;
   RtAudioFormat format;
+  unsigned int deviceFrames, pitch;
   handle = (snd_pcm_t **) apiInfo->handles;
 
   if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
 
-    // Setup parameters.
+    // The callback has already read a mapped period in place.
+    if ( mapped[1] ) {
+      commitPeriod( INPUT, offset[1] );
+      goto tryOutput;
+    }
+
+    // An mmap stream converts a mapped period straight into the user
+    // buffer.  A period that cannot be mapped is read as usual.
+    if ( stream_.mapped[1] && ( buffer = mapPeriod( INPUT, &offset[1] ) ) ) {
+      convertBuffer( stream_.userBuffer[1], buffer, stream_.convertInfo[1] );
+      commitPeriod( INPUT, offset[1] );
+      goto tryOutput;
+    }
+
+    // Setup parameters.  A resampled stream reads as many device
+    // frames as the next user buffer needs.
+    deviceFrames = pitch = stream_.bufferSize;
+    if ( stream_.resample[1].resampler ) {
+      deviceFrames = resampleInputFrames();
+      pitch = stream_.resample[1].maxFrames;
+    }
     if ( stream_.doConvertBuffer[1] ) {
       buffer = stream_.deviceBuffer;
       channels = stream_.nDeviceChannels[1];
@@ -6242,49 +6755,48 @@ void RtApiAlsa :: callbackEvent()
       format = stream_.userFormat;
     }
 
-    // Read samples from device in interleaved/non-interleaved format.
-    if ( stream_.deviceInterleaved[1] )
-      result = snd_pcm_readi( handle[1], buffer, stream_.bufferSize );
+    // Read samples from device in interleaved/non-interleaved format,
+    // without the mutex, which the control methods then never wait on
+    // for a device.
+    MUTEX_UNLOCK( &stream_.mutex );
+    if ( deviceFrames == 0 )
+      result = 0;
+    else if ( apiInfo->mmap[1] )
+      result = snd_pcm_mmap_readi( handle[1], buffer, deviceFrames );
+    else if ( stream_.deviceInterleaved[1] )
+      result = snd_pcm_readi( handle[1], buffer, deviceFrames );
     else {
       void *bufs[channels];
-      size_t offset = stream_.bufferSize * formatBytes( format );
+      size_t offset = pitch * formatBytes( format );
       for ( int i=0; i<channels; i++ )
         bufs[i] = (void *) (buffer + (i * offset));
-      result = snd_pcm_readn( handle[1], bufs, stream_.bufferSize );
+      result = snd_pcm_readn( handle[1], bufs, deviceFrames );
     }
+    MUTEX_LOCK( &stream_.mutex );
 
-    if ( result < (int) stream_.bufferSize ) {
+    // The stream might have stopped during the read.
+    if ( stream_.state == STREAM_STOPPED ) goto unlock;
+
+    if ( result < (int) deviceFrames ) {
       // Either an error or overrun occured.
-      if ( result == -EPIPE ) {
-        snd_pcm_state_t state = snd_pcm_state( handle[1] );
-        if ( state == SND_PCM_STATE_XRUN ) {
-          apiInfo->xrun[1] = true;
-          result = snd_pcm_prepare( handle[1] );
-          if ( result < 0 ) {
-            errorStream_ << "RtApiAlsa::callbackEvent: error preparing device after overrun, " << snd_strerror( result ) << ".";
-            errorText_ = errorStream_.str();
-          }
-        }
-        else {
-          errorStream_ << "RtApiAlsa::callbackEvent: error, current state is " << snd_pcm_state_name( state ) << ", " << snd_strerror( result ) << ".";
-          errorText_ = errorStream_.str();
-        }
-      }
+      if ( result == -EPIPE )
+        recoverDevice( INPUT, result, "reading" );
       else {
         errorStream_ << "RtApiAlsa::callbackEvent: audio read error, " << snd_strerror( result ) << ".";
         errorText_ = errorStream_.str();
+        error( RtError::WARNING );
       }
-      error( RtError::WARNING );
       goto tryOutput;
     }
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[1] )
-      byteSwapBuffer( buffer, stream_.bufferSize * channels, format );
-
-    // Do buffer conversion if necessary.
-    if ( stream_.doConvertBuffer[1] )
+    // Do buffer conversion and/or byte swapping if necessary.  The
+    // conversion swaps the device samples itself.
+    if ( stream_.resample[1].resampler )
+      resampleInput( deviceFrames );
+    else if ( stream_.doConvertBuffer[1] )
       convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
+    else if ( stream_.doByteSwap[1] )
+      byteSwapBuffer( buffer, stream_.bufferSize * channels, format );
 
     // Check stream latency
     result = snd_pcm_delay( handle[1], &frames );
@@ -6295,8 +6807,34 @@ void RtApiAlsa :: callbackEvent()
 
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
 
-    // Setup parameters and do buffer conversion if necessary.
-    if ( stream_.doConvertBuffer[0] ) {
+    // The callback has already written a mapped period in place.
+    if ( mapped[0] ) {
+      commitPeriod( OUTPUT, offset[0] );
+      goto unlock;
+    }
+
+    // An mmap stream converts the user buffer straight into a mapped
+    // period, clearing any channels the conversion leaves out first.
+    // A period that cannot be mapped is written as usual.
+    if ( stream_.mapped[0] && ( buffer = mapPeriod( OUTPUT, &offset[0] ) ) ) {
+      if ( stream_.nUserChannels[0] < stream_.nDeviceChannels[0] )
+        memset( buffer, 0, stream_.bufferSize * stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] ) );
+      convertBuffer( buffer, stream_.userBuffer[0], stream_.convertInfo[0] );
+      commitPeriod( OUTPUT, offset[0] );
+      goto unlock;
+    }
+
+    // Setup parameters and do buffer conversion if necessary.  A
+    // resampled stream writes however many device frames it made.
+    deviceFrames = pitch = stream_.bufferSize;
+    if ( stream_.resample[0].resampler ) {
+      buffer = stream_.deviceBuffer;
+      deviceFrames = resampleOutput();
+      pitch = stream_.resample[0].maxFrames;
+      channels = stream_.nDeviceChannels[0];
+      format = stream_.deviceFormat[0];
+    }
+    else if ( stream_.doConvertBuffer[0] ) {
       buffer = stream_.deviceBuffer;
       convertBuffer( buffer, stream_.userBuffer[0], stream_.convertInfo[0] );
       channels = stream_.nDeviceChannels[0];
@@ -6308,43 +6846,40 @@ void RtApiAlsa :: callbackEvent()
       format = stream_.userFormat;
     }
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[0] )
+    // Do byte swapping if necessary (already done by any conversion).
+    if ( stream_.doByteSwap[0] && !stream_.doConvertBuffer[0] )
       byteSwapBuffer(buffer, stream_.bufferSize * channels, format);
 
-    // Write samples to device in interleaved/non-interleaved format.
-    if ( stream_.deviceInterleaved[0] )
-      result = snd_pcm_writei( handle[0], buffer, stream_.bufferSize );
+    // Write samples to device in interleaved/non-interleaved format,
+    // without the mutex (as the read above).
+    MUTEX_UNLOCK( &stream_.mutex );
+    if ( deviceFrames == 0 )
+      result = 0;
+    else if ( apiInfo->mmap[0] )
+      result = snd_pcm_mmap_writei( handle[0], buffer, deviceFrames );
+    else if ( stream_.deviceInterleaved[0] )
+      result = snd_pcm_writei( handle[0], buffer, deviceFrames );
     else {
       void *bufs[channels];
-      size_t offset = stream_.bufferSize * formatBytes( format );
+      size_t offset = pitch * formatBytes( format );
       for ( int i=0; i<channels; i++ )
         bufs[i] = (void *) (buffer + (i * offset));
-      result = snd_pcm_writen( handle[0], bufs, stream_.bufferSize );
+      result = snd_pcm_writen( handle[0], bufs, deviceFrames );
     }
+    MUTEX_LOCK( &stream_.mutex );
 
-    if ( result < (int) stream_.bufferSize ) {
+    // The stream might have stopped during the write.
+    if ( stream_.state == STREAM_STOPPED ) goto unlock;
+
+    if ( result < (int) deviceFrames ) {
       // Either an error or underrun occured.
-      if ( result == -EPIPE ) {
-        snd_pcm_state_t state = snd_pcm_state( handle[0] );
-        if ( state == SND_PCM_STATE_XRUN ) {
-          apiInfo->xrun[0] = true;
-          result = snd_pcm_prepare( handle[0] );
-          if ( result < 0 ) {
-            errorStream_ << "RtApiAlsa::callbackEvent: error preparing device after underrun, " << snd_strerror( result ) << ".";
-            errorText_ = errorStream_.str();
-          }
-        }
-        else {
-          errorStream_ << "RtApiAlsa::callbackEvent: error, current state is " << snd_pcm_state_name( state ) << ", " << snd_strerror( result ) << ".";
-          errorText_ = errorStream_.str();
-        }
-      }
+      if ( result == -EPIPE )
+        recoverDevice( OUTPUT, result, "writing" );
       else {
         errorStream_ << "RtApiAlsa::callbackEvent: audio write error, " << snd_strerror( result ) << ".";
         errorText_ = errorStream_.str();
+        error( RtError::WARNING );
       }
-      error( RtError::WARNING );
       goto unlock;
     }
 
@@ -6354,83 +6889,415 @@ void RtApiAlsa :: callbackEvent()
   }
 
  unlock:
+  // Restart both directions together after an xrun of either.
+  if ( apiInfo->realign && stream_.state == STREAM_RUNNING && alignDuplex() < 0 )
+    error( RtError::WARNING );
   MUTEX_UNLOCK( &stream_.mutex );
 
   RtApi::tickStreamTime();
   if ( doStopStream == 1 ) this->stopStream();
 }
 
-extern "C" void *alsaCallbackHandler( void *ptr )
+void RtApiAlsa :: waitForDrain( void )
 {
-  CallbackInfo *info = (CallbackInfo *) ptr;
-  RtApiAlsa *object = (RtApiAlsa *) info->object;
-  bool *isRunning = &info->isRunning;
-
-  while ( *isRunning == true ) {
-    pthread_testcancel();
-    object->callbackEvent();
+  // Wait, with the mutex held, for the callback thread to play out the
+  // output stopStream left queued, but for no longer than the ring
+  // takes to play.  After that the drain is cut short, which makes the
+  // blocking snd_pcm_drain in the callback thread return.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  if ( !apiInfo->draining ) return;
+
+  unsigned int rate = stream_.resample[0].resampler ? stream_.resample[0].deviceRate : stream_.sampleRate;
+  double limit = (double) apiInfo->ring[0] / rate + 0.1;
+  struct timespec deadline;
+  clock_gettime( CLOCK_REALTIME, &deadline );
+  long long ns = deadline.tv_nsec + (long long) ( limit * 1e9 );
+  deadline.tv_sec += (time_t) ( ns / 1000000000 );
+  deadline.tv_nsec = (long) ( ns % 1000000000 );
+
+  while ( apiInfo->draining ) {
+    if ( pthread_cond_timedwait( &apiInfo->runnable_cv, &stream_.mutex, &deadline ) == ETIMEDOUT ) {
+      snd_pcm_drop( apiInfo->handles[0] );
+      while ( apiInfo->draining )
+        pthread_cond_wait( &apiInfo->runnable_cv, &stream_.mutex );
+    }
   }
-
-  pthread_exit( NULL );
 }
 
-//******************** End of __LINUX_ALSA__ *********************//
-#endif
+int RtApiAlsa :: alignDuplex( void )
+{
+  // Restart both directions of a duplex stream together, so that the
+  // output lags the input by stream_.duplexOffset frames however often
+  // the stream recovers from an xrun.  The playback device starts once
+  // a period of the primed silence is queued, a linked capture device
+  // with it and an unlinked one straight after.  The latter is then
+  // behind by however long its start took, and the playback device is
+  // given as much more silence, measured by the trigger time stamps of
+  // both.  Returns a negative error code, with errorText_ set, on
+  // failure.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t **handle = (snd_pcm_t **) apiInfo->handles;
+  apiInfo->realign = false;
+  apiInfo->lastWake = 0.0;
 
+  // The input read before the restart would reach the output at the
+  // wrong offset, so the next callback gets silence instead.
+  memset( stream_.userBuffer[1], 0, stream_.nUserChannels[1] * stream_.bufferSize * formatBytes( stream_.userFormat ) );
 
-#if defined(__LINUX_OSS__)
+  int result = 0;
+  for ( int i=0; i<2 && result >= 0; i++ ) {
+    if ( i == 1 && apiInfo->synchronized ) break;
+    snd_pcm_drop( handle[i] );
+    result = snd_pcm_prepare( handle[i] );
+  }
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::alignDuplex: error preparing devices, " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    return result;
+  }
 
-#include <unistd.h>
-#include <sys/ioctl.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include "soundcard.h"
-#include <errno.h>
-#include <math.h>
+  result = writeSilence( apiInfo->prime );
+  if ( result >= 0 && snd_pcm_state( handle[0] ) == SND_PCM_STATE_PREPARED )
+    result = snd_pcm_start( handle[0] );
+  if ( result >= 0 && !apiInfo->synchronized )
+    result = snd_pcm_start( handle[1] );
+  if ( result < 0 ) {
+    errorStream_ << "RtApiAlsa::alignDuplex: error starting devices, " << snd_strerror( result ) << ".";
+    errorText_ = errorStream_.str();
+    return result;
+  }
 
-extern "C" void *ossCallbackHandler(void * ptr);
+  if ( !apiInfo->synchronized ) {
+    snd_pcm_status_t *status;
+    snd_pcm_status_alloca( &status );
+    snd_htimestamp_t trigger[2];
+    for ( int i=0; i<2 && result >= 0; i++ ) {
+      result = snd_pcm_status( handle[i], status );
+      if ( result >= 0 ) snd_pcm_status_get_trigger_htstamp( status, &trigger[i] );
+    }
 
-// A structure to hold various information related to the OSS API
-// implementation.
-struct OssHandle {
-  int id[2];    // device ids
-  bool xrun[2];
-  bool triggered;
-  pthread_cond_t runnable;
+    // Without time stamps the devices are taken to have started together.
+    if ( result >= 0 ) {
+      double skew = ( trigger[1].tv_sec - trigger[0].tv_sec ) + ( trigger[1].tv_nsec - trigger[0].tv_nsec ) * 1e-9;
+      unsigned int rate = stream_.resample[0].resampler ? stream_.resample[0].deviceRate : stream_.sampleRate;
+      unsigned long frames = ( skew > 0.0 ) ? (unsigned long) ( skew * rate + 0.5 ) : 0;
+      if ( frames > 0 && frames < apiInfo->prime ) writeSilence( frames );
+    }
+    result = 0;
+  }
 
-  OssHandle()
-    :triggered(false) { id[0] = 0; id[1] = 0; xrun[0] = false; xrun[1] = false; }
-};
+  return result;
+}
 
-RtApiOss :: RtApiOss()
+int RtApiAlsa :: writeSilence( unsigned long frames )
 {
-  // Nothing to do here.
+  // Queue frames of silence on the playback device, a period at most
+  // at a time.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[0];
+  char *silence = &apiInfo->silence[0];
+  int channels = stream_.nDeviceChannels[0];
+
+  while ( frames > 0 ) {
+    snd_pcm_uframes_t count = ( frames < apiInfo->availMin[0] ) ? frames : apiInfo->availMin[0];
+    snd_pcm_sframes_t result;
+    if ( apiInfo->mmap[0] )
+      result = snd_pcm_mmap_writei( handle, silence, count );
+    else if ( stream_.deviceInterleaved[0] )
+      result = snd_pcm_writei( handle, silence, count );
+    else {
+      void *bufs[channels];
+      for ( int i=0; i<channels; i++ )
+        bufs[i] = (void *) silence;
+      result = snd_pcm_writen( handle, bufs, count );
+    }
+    if ( result < 0 ) return (int) result;
+    frames -= result;
+  }
+
+  return 0;
 }
 
-RtApiOss :: ~RtApiOss()
+bool RtApiAlsa :: waitForPeriod( double *wake, double *late )
 {
-  if ( stream_.state != STREAM_CLOSED ) closeStream();
+  // Poll every direction of the stream at once until each can read or
+  // write the frames of the next buffer, so that neither the read nor
+  // the write that follow block.  avail_min wakes us for a whole
+  // period; a resampled direction may need a frame or two more, which
+  // we sleep for rather than poll on.  Returns false if the stream
+  // stopped meanwhile; a stop wakes the poll through apiInfo->wake.
+  // On success, *wake is the time of the wake-up and *late the
+  // seconds of audio ready beyond the buffer.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  int timeout = 4 * 1000 * stream_.bufferSize / stream_.sampleRate + 10;
+  struct pollfd fds[17];
+
+  for (;;) {
+    if ( streamState() != STREAM_RUNNING ) return false;
+
+    bool ready = true;
+    unsigned int nfds = 0, first[2] = { 0, 0 }, count[2] = { 0, 0 }, shortest = 0;
+    *late = -1.0;
+    for ( int i=0; i<2; i++ ) {
+      if ( stream_.mode != i && stream_.mode != DUPLEX ) continue;
+      snd_pcm_t *handle = apiInfo->handles[i];
+      unsigned int rate = stream_.sampleRate, need = stream_.bufferSize;
+      if ( stream_.resample[i].resampler ) {
+        rate = stream_.resample[i].deviceRate;
+        need = ( i == 0 ) ? stream_.resample[0].maxFrames : resampleInputFrames();
+      }
+
+      // Unlike a read, polling does not start a prepared capture device.
+      int result = 0;
+      if ( i == 1 && snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED )
+        result = snd_pcm_start( handle );
+      snd_pcm_sframes_t avail = ( result < 0 ) ? result : snd_pcm_avail_update( handle );
+
+      // The devices do not stop on an xrun (see probeDeviceOpen), so a
+      // direction of a duplex stream more than a ring behind has lost
+      // its alignment with the other.  Both are restarted together
+      // before the next buffer.
+      if ( stream_.mode == DUPLEX ) {
+        if ( avail > (snd_pcm_sframes_t) apiInfo->ring[i] ) {
+          apiInfo->xrun[i] = true;
+          apiInfo->realign = true;
+        }
+        else if ( avail < 0 )
+          recoverDevice( (StreamMode) i, (int) avail, "waiting on" );
+        if ( apiInfo->realign ) break;
+      }
+
+      if ( avail < 0 ) {
+        // Leave the recovery to the transfer that follows.
+        *wake = 0.0;
+        return true;
+      }
+
+      // The direction that became ready last woke us, so the smallest
+      // surplus is how late we are.
+      if ( avail >= (snd_pcm_sframes_t) need ) {
+        double extra = (double) ( avail - need ) / rate;
+        if ( *late < 0.0 || extra < *late ) *late = extra;
+        continue;
+      }
+
+      ready = false;
+      unsigned int missing = ( need - avail ) * 1000000 / rate + 1;
+      if ( avail >= (snd_pcm_sframes_t) apiInfo->availMin[i] ) {
+        // Past avail_min, so a poll would return at once.
+        if ( shortest == 0 || missing < shortest ) shortest = missing;
+        continue;
+      }
+      first[i] = nfds;
+      for ( unsigned int k=0; k<apiInfo->fds[i].size() && nfds<16; k++ )
+        fds[nfds++] = apiInfo->fds[i][k];
+      count[i] = nfds - first[i];
+    }
+
+    if ( apiInfo->realign ) {
+      MUTEX_LOCK( &stream_.mutex );
+      if ( stream_.state == STREAM_RUNNING && alignDuplex() < 0 )
+        error( RtError::WARNING );
+      MUTEX_UNLOCK( &stream_.mutex );
+      continue;
+    }
+
+    if ( ready ) {
+      struct timespec now;
+      clock_gettime( CLOCK_MONOTONIC, &now );
+      *wake = now.tv_sec + now.tv_nsec * 1e-9;
+      return true;
+    }
+
+    if ( nfds == 0 ) {
+      usleep( shortest );
+      continue;
+    }
+
+    fds[nfds].fd = apiInfo->wake;
+    fds[nfds].events = POLLIN;
+    fds[nfds].revents = 0;
+    int result = poll( fds, nfds + 1, shortest ? shortest / 1000 + 1 : timeout );
+    if ( result < 0 && errno != EINTR ) {
+      errorStream_ << "RtApiAlsa::callbackEvent: error polling devices, " << strerror( errno ) << ".";
+      errorText_ = errorStream_.str();
+      error( RtError::WARNING );
+      *wake = 0.0;
+      return true;
+    }
+
+    // Let each device make sense of its events; xruns and errors turn
+    // up in the next snd_pcm_avail_update.
+    unsigned short revents;
+    for ( int i=0; i<2 && result > 0; i++ )
+      if ( count[i] ) snd_pcm_poll_descriptors_revents( apiInfo->handles[i], &fds[first[i]], count[i], &revents );
+    if ( result > 0 && ( fds[nfds].revents & POLLIN ) ) {
+      eventfd_t wakes;
+      eventfd_read( apiInfo->wake, &wakes );
+    }
+  }
 }
 
-unsigned int RtApiOss :: getDeviceCount( void )
+char *RtApiAlsa :: mapPeriod( StreamMode mode, unsigned long *offset )
 {
-  int mixerfd = open( "/dev/mixer", O_RDWR, 0 );
-  if ( mixerfd == -1 ) {
-    errorText_ = "RtApiOss::getDeviceCount: error opening '/dev/mixer'.";
-    error( RtError::WARNING );
+  // Return the address of the period of the ring buffer that
+  // waitForPeriod made available.  This never waits, so the mutex may
+  // be held.  NULL is returned after an xrun or error, when the period
+  // is not all there, or when it wraps around the end of the ring, and
+  // the caller then copies the period instead.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[mode];
+  int result;
+
+  snd_pcm_sframes_t avail = snd_pcm_avail_update( handle );
+  if ( avail < 0 ) {
+    recoverDevice( mode, (int) avail, "mapping" );
     return 0;
   }
+  if ( avail < (snd_pcm_sframes_t) stream_.bufferSize ) return 0;
 
-  oss_sysinfo sysinfo;
-  if ( ioctl( mixerfd, SNDCTL_SYSINFO, &sysinfo ) == -1 ) {
-    close( mixerfd );
-    errorText_ = "RtApiOss::getDeviceCount: error getting sysinfo, OSS version >= 4.0 is required.";
-    error( RtError::WARNING );
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t first, frames = stream_.bufferSize;
+  result = snd_pcm_mmap_begin( handle, &areas, &first, &frames );
+  if ( result < 0 ) {
+    recoverDevice( mode, result, "mapping" );
     return 0;
   }
 
-  close( mixerfd );
-  return sysinfo.numaudios;
+  *offset = first;
+  if ( frames < stream_.bufferSize ) {
+    snd_pcm_mmap_commit( handle, first, 0 );
+    return 0;
+  }
+
+  return (char *) areas[0].addr + ( areas[0].first + first * areas[0].step ) / 8;
+}
+
+void RtApiAlsa :: commitPeriod( StreamMode mode, unsigned long offset )
+{
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[mode];
+
+  snd_pcm_sframes_t result = snd_pcm_mmap_commit( handle, offset, stream_.bufferSize );
+  if ( result < (snd_pcm_sframes_t) stream_.bufferSize ) {
+    recoverDevice( mode, result < 0 ? (int) result : -EIO, "committing" );
+    return;
+  }
+
+  // Unlike a write, a commit does not start a prepared playback device.
+  if ( mode == OUTPUT && snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED )
+    snd_pcm_start( handle );
+
+  // Check stream latency
+  snd_pcm_sframes_t frames;
+  if ( snd_pcm_delay( handle, &frames ) == 0 && frames > 0 ) stream_.latency[mode] = frames;
+}
+
+void RtApiAlsa :: recoverDevice( StreamMode mode, int result, const char *action )
+{
+  // Flag and recover from an xrun, or report any other error.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[mode];
+
+  if ( result == -EPIPE ) {
+    snd_pcm_state_t state = snd_pcm_state( handle );
+    if ( state == SND_PCM_STATE_XRUN ) {
+      apiInfo->xrun[mode] = true;
+
+      // A duplex stream restarts both directions together once this
+      // buffer is through (see alignDuplex).
+      if ( stream_.mode == DUPLEX ) {
+        apiInfo->realign = true;
+        return;
+      }
+
+      result = snd_pcm_prepare( handle );
+      if ( result >= 0 ) return;
+      errorStream_ << "RtApiAlsa::callbackEvent: error preparing device after xrun, " << snd_strerror( result ) << ".";
+    }
+    else
+      errorStream_ << "RtApiAlsa::callbackEvent: error, current state is " << snd_pcm_state_name( state ) << ", " << snd_strerror( result ) << ".";
+  }
+  else
+    errorStream_ << "RtApiAlsa::callbackEvent: error " << action << " device memory, " << snd_strerror( result ) << ".";
+
+  errorText_ = errorStream_.str();
+  error( RtError::WARNING );
+}
+
+extern "C" void *alsaCallbackHandler( void *ptr )
+{
+  CallbackInfo *info = (CallbackInfo *) ptr;
+  RtApiAlsa *object = (RtApiAlsa *) info->object;
+  bool *isRunning = &info->isRunning;
+
+  while ( *isRunning == true ) {
+    pthread_testcancel();
+    object->callbackEvent();
+  }
+
+  pthread_exit( NULL );
+}
+
+//******************** End of __LINUX_ALSA__ *********************//
+#endif
+
+
+#if defined(__LINUX_OSS__)
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "soundcard.h"
+#include <errno.h>
+#include <math.h>
+
+extern "C" void *ossCallbackHandler(void * ptr);
+
+// A structure to hold various information related to the OSS API
+// implementation.
+struct OssHandle {
+  int id[2];    // device ids
+  bool xrun[2];
+  bool triggered;
+  pthread_cond_t runnable;
+  bool flush;   // the callback thread flushes the output before it parks
+  bool parked;  // the callback thread waits for the stream to start
+
+  OssHandle()
+    :triggered(false), flush(false), parked(false) { id[0] = 0; id[1] = 0; xrun[0] = false; xrun[1] = false; }
+};
+
+RtApiOss :: RtApiOss()
+{
+  // Nothing to do here.
+}
+
+RtApiOss :: ~RtApiOss()
+{
+  if ( stream_.state != STREAM_CLOSED ) closeStream();
+}
+
+unsigned int RtApiOss :: getDeviceCount( void )
+{
+  int mixerfd = open( "/dev/mixer", O_RDWR, 0 );
+  if ( mixerfd == -1 ) {
+    errorText_ = "RtApiOss::getDeviceCount: error opening '/dev/mixer'.";
+    error( RtError::WARNING );
+    return 0;
+  }
+
+  oss_sysinfo sysinfo;
+  if ( ioctl( mixerfd, SNDCTL_SYSINFO, &sysinfo ) == -1 ) {
+    close( mixerfd );
+    errorText_ = "RtApiOss::getDeviceCount: error getting sysinfo, OSS version >= 4.0 is required.";
+    error( RtError::WARNING );
+    return 0;
+  }
+
+  close( mixerfd );
+  return sysinfo.numaudios;
 }
 
 RtAudio::DeviceInfo RtApiOss :: getDeviceInfo( unsigned int device )
@@ -6843,6 +7710,8 @@ bool RtApiOss :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigned
   if ( stream_.userInterleaved != stream_.deviceInterleaved[mode] &&
        stream_.nUserChannels[mode] > 1 )
     stream_.doConvertBuffer[mode] = true;
+  if ( stream_.doMix[mode] )
+    stream_.doConvertBuffer[mode] = true;
 
   // Allocate the stream handles if necessary and then save.
   if ( stream_.apiHandle == 0 ) {
@@ -6986,11 +7855,13 @@ void RtApiOss :: closeStream()
   OssHandle *handle = (OssHandle *) stream_.apiHandle;
   stream_.callbackInfo.isRunning = false;
   MUTEX_LOCK( &stream_.mutex );
-  if ( stream_.state == STREAM_STOPPED )
-    pthread_cond_signal( &handle->runnable );
+  pthread_cond_broadcast( &handle->runnable );
   MUTEX_UNLOCK( &stream_.mutex );
   pthread_join( stream_.callbackInfo.thread, NULL );
 
+  // Finish a stop the callback thread exited before getting to.
+  if ( handle->flush ) haltDevices( true );
+
   if ( stream_.state == STREAM_RUNNING ) {
     if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX )
       ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
@@ -7019,6 +7890,7 @@ void RtApiOss :: closeStream()
     stream_.deviceBuffer = 0;
   }
 
+  stopConvertPool();
   stream_.mode = UNINITIALIZED;
   stream_.state = STREAM_CLOSED;
 }
@@ -7034,15 +7906,23 @@ void RtApiOss :: startStream()
 
   MUTEX_LOCK( &stream_.mutex );
 
-  stream_.state = STREAM_RUNNING;
+  // Wait for the callback thread to finish stopping the stream (see
+  // callbackEvent), so that nothing it writes or halts reaches the
+  // restarted devices.
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( !pthread_equal( pthread_self(), stream_.callbackInfo.thread ) ) {
+    while ( !handle->parked )
+      pthread_cond_wait( &handle->runnable, &stream_.mutex );
+  }
+
+  handle->flush = false;
+  setStreamState( STREAM_RUNNING );
 
   // No need to do anything else here ... OSS automatically starts
   // when fed samples.
 
+  pthread_cond_broadcast( &handle->runnable );
   MUTEX_UNLOCK( &stream_.mutex );
-
-  OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  pthread_cond_signal( &handle->runnable );
 }
 
 void RtApiOss :: stopStream()
@@ -7054,67 +7934,17 @@ void RtApiOss :: stopStream()
     return;
   }
 
+  // The callback thread flushes the output and halts the devices once
+  // the buffer it is on is through, so that the call returns at once.
+  // Errors in doing so are reported there, as warnings, since this
+  // call has already returned.
   MUTEX_LOCK( &stream_.mutex );
-
-  // The state might change while waiting on a mutex.
-  if ( stream_.state == STREAM_STOPPED ) {
-    MUTEX_UNLOCK( &stream_.mutex );
-    return;
-  }
-
-  int result = 0;
   OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
-
-    // Flush the output with zeros a few times.
-    char *buffer;
-    int samples;
-    RtAudioFormat format;
-
-    if ( stream_.doConvertBuffer[0] ) {
-      buffer = stream_.deviceBuffer;
-      samples = stream_.bufferSize * stream_.nDeviceChannels[0];
-      format = stream_.deviceFormat[0];
-    }
-    else {
-      buffer = stream_.userBuffer[0];
-      samples = stream_.bufferSize * stream_.nUserChannels[0];
-      format = stream_.userFormat;
-    }
-
-    memset( buffer, 0, samples * formatBytes(format) );
-    for ( unsigned int i=0; i<stream_.nBuffers+1; i++ ) {
-      result = write( handle->id[0], buffer, samples * formatBytes(format) );
-      if ( result == -1 ) {
-        errorText_ = "RtApiOss::stopStream: audio write error.";
-        error( RtError::WARNING );
-      }
-    }
-
-    result = ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
-    if ( result == -1 ) {
-      errorStream_ << "RtApiOss::stopStream: system error stopping callback procedure on device (" << stream_.device[0] << ").";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-    handle->triggered = false;
+  if ( stream_.state != STREAM_STOPPED ) {
+    setStreamState( STREAM_STOPPED );
+    handle->flush = true;
   }
-
-  if ( stream_.mode == INPUT || ( stream_.mode == DUPLEX && handle->id[0] != handle->id[1] ) ) {
-    result = ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 );
-    if ( result == -1 ) {
-      errorStream_ << "RtApiOss::stopStream: system error stopping input callback procedure on device (" << stream_.device[0] << ").";
-      errorText_ = errorStream_.str();
-      goto unlock;
-    }
-  }
-
- unlock:
-  stream_.state = STREAM_STOPPED;
   MUTEX_UNLOCK( &stream_.mutex );
-
-  if ( result != -1 ) return;
-  error( RtError::SYSTEM_ERROR );
 }
 
 void RtApiOss :: abortStream()
@@ -7134,16 +7964,22 @@ void RtApiOss :: abortStream()
     return;
   }
 
-  int result = 0;
   OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  setStreamState( STREAM_STOPPED );
+  handle->triggered = false;
+  MUTEX_UNLOCK( &stream_.mutex );
+
+  // Halting the devices also ends a transfer the callback thread is
+  // making.  It halts them again before it parks, in case it wrote a
+  // buffer meanwhile.
+  int result = 0;
   if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
     result = ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 );
     if ( result == -1 ) {
       errorStream_ << "RtApiOss::abortStream: system error stopping callback procedure on device (" << stream_.device[0] << ").";
       errorText_ = errorStream_.str();
-      goto unlock;
+      error( RtError::SYSTEM_ERROR );
     }
-    handle->triggered = false;
   }
 
   if ( stream_.mode == INPUT || ( stream_.mode == DUPLEX && handle->id[0] != handle->id[1] ) ) {
@@ -7151,24 +7987,79 @@ void RtApiOss :: abortStream()
     if ( result == -1 ) {
       errorStream_ << "RtApiOss::abortStream: system error stopping input callback procedure on device (" << stream_.device[0] << ").";
       errorText_ = errorStream_.str();
-      goto unlock;
+      error( RtError::SYSTEM_ERROR );
     }
   }
+}
 
- unlock:
-  stream_.state = STREAM_STOPPED;
-  MUTEX_UNLOCK( &stream_.mutex );
+void RtApiOss :: haltDevices( bool flush )
+{
+  // Halt the devices of a stopped stream, after flushing the output
+  // with zeros a few times if asked to.  Only the callback thread
+  // calls this, without the mutex.
+  OssHandle *handle = (OssHandle *) stream_.apiHandle;
+  if ( stream_.mode == OUTPUT || stream_.mode == DUPLEX ) {
+    if ( flush ) {
+      char *buffer;
+      int samples;
+      RtAudioFormat format;
 
-  if ( result != -1 ) return;
-  error( RtError::SYSTEM_ERROR );
+      if ( stream_.doConvertBuffer[0] ) {
+        buffer = stream_.deviceBuffer;
+        samples = stream_.bufferSize * stream_.nDeviceChannels[0];
+        format = stream_.deviceFormat[0];
+      }
+      else {
+        buffer = stream_.userBuffer[0];
+        samples = stream_.bufferSize * stream_.nUserChannels[0];
+        format = stream_.userFormat;
+      }
+
+      memset( buffer, 0, samples * formatBytes(format) );
+      for ( unsigned int i=0; i<stream_.nBuffers+1; i++ ) {
+        if ( write( handle->id[0], buffer, samples * formatBytes(format) ) == -1 ) {
+          errorText_ = "RtApiOss::stopStream: audio write error.";
+          error( RtError::WARNING );
+          break;
+        }
+      }
+    }
+
+    if ( ioctl( handle->id[0], SNDCTL_DSP_HALT, 0 ) == -1 ) {
+      errorStream_ << "RtApiOss::stopStream: system error stopping callback procedure on device (" << stream_.device[0] << ").";
+      errorText_ = errorStream_.str();
+      error( RtError::WARNING );
+    }
+  }
+
+  if ( stream_.mode == INPUT || ( stream_.mode == DUPLEX && handle->id[0] != handle->id[1] ) ) {
+    if ( ioctl( handle->id[1], SNDCTL_DSP_HALT, 0 ) == -1 ) {
+      errorStream_ << "RtApiOss::stopStream: system error stopping input callback procedure on device (" << stream_.device[0] << ").";
+      errorText_ = errorStream_.str();
+      error( RtError::WARNING );
+    }
+  }
 }
 
 void RtApiOss :: callbackEvent()
 {
   OssHandle *handle = (OssHandle *) stream_.apiHandle;
-  if ( stream_.state == STREAM_STOPPED ) {
+  if ( streamState() == STREAM_STOPPED ) {
+    // Finish the stop, then park until the stream starts again (see
+    // startStream).
     MUTEX_LOCK( &stream_.mutex );
-    pthread_cond_wait( &handle->runnable, &stream_.mutex );
+    bool flush = handle->flush;
+    handle->flush = false;
+    MUTEX_UNLOCK( &stream_.mutex );
+    haltDevices( flush );
+
+    MUTEX_LOCK( &stream_.mutex );
+    handle->triggered = false;
+    handle->parked = true;
+    pthread_cond_broadcast( &handle->runnable );
+    while ( stream_.state == STREAM_STOPPED && stream_.callbackInfo.isRunning )
+      pthread_cond_wait( &handle->runnable, &stream_.mutex );
+    handle->parked = false;
     if ( stream_.state != STREAM_RUNNING ) {
       MUTEX_UNLOCK( &stream_.mutex );
       return;
@@ -7176,7 +8067,7 @@ void RtApiOss :: callbackEvent()
     MUTEX_UNLOCK( &stream_.mutex );
   }
 
-  if ( stream_.state == STREAM_CLOSED ) {
+  if ( streamState() == STREAM_CLOSED ) {
     errorText_ = "RtApiOss::callbackEvent(): the stream is closed ... this shouldn't happen!";
     error( RtError::WARNING );
     return;
@@ -7195,7 +8086,8 @@ void RtApiOss :: callbackEvent()
     status |= RTAUDIO_INPUT_OVERFLOW;
     handle->xrun[1] = false;
   }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
+  doStopStream = callback( callbackBuffer( OUTPUT, stream_.userBuffer[0] ),
+                           callbackBuffer( INPUT, stream_.userBuffer[1] ),
                            stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
   if ( doStopStream == 2 ) {
     this->abortStream();
@@ -7227,21 +8119,28 @@ void RtApiOss :: callbackEvent()
       format = stream_.userFormat;
     }
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[0] )
+    // Do byte swapping if necessary (already done by any conversion).
+    if ( stream_.doByteSwap[0] && !stream_.doConvertBuffer[0] )
       byteSwapBuffer( buffer, samples, format );
 
-    if ( stream_.mode == DUPLEX && handle->triggered == false ) {
-      int trig = 0;
+    int trig = 0;
+    if ( stream_.mode == DUPLEX && handle->triggered == false )
       ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
-      result = write( handle->id[0], buffer, samples * formatBytes(format) );
+
+    // Write samples to device, without the mutex, which the control
+    // methods then never wait on for a device.
+    MUTEX_UNLOCK( &stream_.mutex );
+    result = write( handle->id[0], buffer, samples * formatBytes(format) );
+    MUTEX_LOCK( &stream_.mutex );
+
+    // The stream might have stopped during the write.
+    if ( stream_.state == STREAM_STOPPED ) goto unlock;
+
+    if ( stream_.mode == DUPLEX && handle->triggered == false ) {
       trig = PCM_ENABLE_INPUT|PCM_ENABLE_OUTPUT;
       ioctl( handle->id[0], SNDCTL_DSP_SETTRIGGER, &trig );
       handle->triggered = true;
     }
-    else
-      // Write samples to device.
-      result = write( handle->id[0], buffer, samples * formatBytes(format) );
 
     if ( result == -1 ) {
       // We'll assume this is an underrun, though there isn't a
@@ -7267,8 +8166,13 @@ void RtApiOss :: callbackEvent()
       format = stream_.userFormat;
     }
 
-    // Read samples from device.
+    // Read samples from device, without the mutex (as the write above).
+    MUTEX_UNLOCK( &stream_.mutex );
     result = read( handle->id[1], buffer, samples * formatBytes(format) );
+    MUTEX_LOCK( &stream_.mutex );
+
+    // The stream might have stopped during the read.
+    if ( stream_.state == STREAM_STOPPED ) goto unlock;
 
     if ( result == -1 ) {
       // We'll assume this is an overrun, though there isn't a
@@ -7279,13 +8183,12 @@ void RtApiOss :: callbackEvent()
       goto unlock;
     }
 
-    // Do byte swapping if necessary.
-    if ( stream_.doByteSwap[1] )
-      byteSwapBuffer( buffer, samples, format );
-
-    // Do buffer conversion if necessary.
+    // Do buffer conversion and/or byte swapping if necessary.  The
+    // conversion swaps the device samples itself.
     if ( stream_.doConvertBuffer[1] )
       convertBuffer( stream_.userBuffer[1], stream_.deviceBuffer, stream_.convertInfo[1] );
+    else if ( stream_.doByteSwap[1] )
+      byteSwapBuffer( buffer, samples, format );
   }
 
  unlock:
@@ -7353,11 +8256,24 @@ void RtApi :: clearStreamInfo()
   stream_.callbackInfo.callback = 0;
   stream_.callbackInfo.userData = 0;
   stream_.callbackInfo.isRunning = false;
+  stream_.channelPointers = false;
+  stream_.clipMeter = false;
+  stream_.clipping = RtAudio::ClipInfo();
+  stopConvertPool();
+  stream_.convertThreshold = 0;
+  stream_.convertTiming = RtAudio::ConvertTiming();
+  stream_.wakeTiming = RtAudio::WakeTiming();
+  stream_.wakeIntervals = 0;
+  stream_.duplexOffset = 0;
   for ( int i=0; i<2; i++ ) {
     stream_.device[i] = 11111;
     stream_.doConvertBuffer[i] = false;
     stream_.deviceInterleaved[i] = true;
     stream_.doByteSwap[i] = false;
+    stream_.doMix[i] = false;
+    stream_.zeroCopy[i] = false;
+    stream_.mapped[i] = false;
+    stream_.channelBuffer[i].clear();
     stream_.nUserChannels[i] = 0;
     stream_.nDeviceChannels[i] = 0;
     stream_.channelOffset[i] = 0;
@@ -7371,6 +8287,12 @@ void RtApi :: clearStreamInfo()
     stream_.convertInfo[i].outFormat = 0;
     stream_.convertInfo[i].inOffset.clear();
     stream_.convertInfo[i].outOffset.clear();
+    stream_.convertInfo[i].plan = RtConvertPlan();
+    stream_.convertInfo[i].mix = RtMixPlan();
+    stream_.convertInfo[i].mixed = RtConvertPlan();
+    stream_.convertInfo[i].mixFrames.clear();
+    delete stream_.resample[i].resampler;
+    stream_.resample[i] = ResampleInfo();
   }
 }
 
@@ -7378,6 +8300,8 @@ unsigned int RtApi :: formatBytes( RtAudioFormat format )
 {
   if ( format == RTAUDIO_SINT16 )
     return 2;
+  else if ( format == RTAUDIO_SINT24_PACKED )
+    return 3;
   else if ( format == RTAUDIO_SINT24 || format == RTAUDIO_SINT32 ||
             format == RTAUDIO_FLOAT32 )
     return 4;
@@ -7394,515 +8318,411 @@ unsigned int RtApi :: formatBytes( RtAudioFormat format )
 
 void RtApi :: setConvertInfo( StreamMode mode, unsigned int firstChannel )
 {
+  ConvertSide user = { stream_.userFormat, stream_.nUserChannels[mode], stream_.userInterleaved,
+                       stream_.bufferSize, false };
+  ConvertSide device = { stream_.deviceFormat[mode], stream_.nDeviceChannels[mode], stream_.deviceInterleaved[mode],
+                         stream_.bufferSize, stream_.doByteSwap[mode] };
+  setConvertInfo( stream_.convertInfo[mode], mode, user, device, firstChannel );
+}
+
+void RtApi :: setConvertInfo( ConvertInfo &info, StreamMode mode, const ConvertSide &user,
+                              const ConvertSide &device, unsigned int firstChannel )
+{
+  info.inOffset.clear();
+  info.outOffset.clear();
   if ( mode == INPUT ) { // convert device to user buffer
-    stream_.convertInfo[mode].inJump = stream_.nDeviceChannels[1];
-    stream_.convertInfo[mode].outJump = stream_.nUserChannels[1];
-    stream_.convertInfo[mode].inFormat = stream_.deviceFormat[1];
-    stream_.convertInfo[mode].outFormat = stream_.userFormat;
+    info.inJump = device.channels;
+    info.outJump = user.channels;
+    info.inFormat = device.format;
+    info.outFormat = user.format;
   }
   else { // convert user to device buffer
-    stream_.convertInfo[mode].inJump = stream_.nUserChannels[0];
-    stream_.convertInfo[mode].outJump = stream_.nDeviceChannels[0];
-    stream_.convertInfo[mode].inFormat = stream_.userFormat;
-    stream_.convertInfo[mode].outFormat = stream_.deviceFormat[0];
+    info.inJump = user.channels;
+    info.outJump = device.channels;
+    info.inFormat = user.format;
+    info.outFormat = device.format;
   }
 
-  if ( stream_.convertInfo[mode].inJump < stream_.convertInfo[mode].outJump )
-    stream_.convertInfo[mode].channels = stream_.convertInfo[mode].inJump;
+  if ( info.inJump < info.outJump )
+    info.channels = info.inJump;
   else
-    stream_.convertInfo[mode].channels = stream_.convertInfo[mode].outJump;
+    info.channels = info.outJump;
 
   // Set up the interleave/deinterleave offsets.
-  if ( stream_.deviceInterleaved[mode] != stream_.userInterleaved ) {
-    if ( ( mode == OUTPUT && stream_.deviceInterleaved[mode] ) ||
-         ( mode == INPUT && stream_.userInterleaved ) ) {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].outOffset.push_back( k );
-        stream_.convertInfo[mode].inJump = 1;
+  unsigned int inFrames = ( mode == INPUT ) ? device.frames : user.frames;
+  unsigned int outFrames = ( mode == INPUT ) ? user.frames : device.frames;
+  if ( device.interleaved != user.interleaved ) {
+    if ( ( mode == OUTPUT && device.interleaved ) ||
+         ( mode == INPUT && user.interleaved ) ) {
+      for ( int k=0; k<info.channels; k++ ) {
+        info.inOffset.push_back( k * inFrames );
+        info.outOffset.push_back( k );
+        info.inJump = 1;
       }
     }
     else {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k );
-        stream_.convertInfo[mode].outOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].outJump = 1;
+      for ( int k=0; k<info.channels; k++ ) {
+        info.inOffset.push_back( k );
+        info.outOffset.push_back( k * outFrames );
+        info.outJump = 1;
       }
     }
   }
   else { // no (de)interleaving
-    if ( stream_.userInterleaved ) {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k );
-        stream_.convertInfo[mode].outOffset.push_back( k );
+    if ( user.interleaved ) {
+      for ( int k=0; k<info.channels; k++ ) {
+        info.inOffset.push_back( k );
+        info.outOffset.push_back( k );
       }
     }
     else {
-      for ( int k=0; k<stream_.convertInfo[mode].channels; k++ ) {
-        stream_.convertInfo[mode].inOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].outOffset.push_back( k * stream_.bufferSize );
-        stream_.convertInfo[mode].inJump = 1;
-        stream_.convertInfo[mode].outJump = 1;
+      for ( int k=0; k<info.channels; k++ ) {
+        info.inOffset.push_back( k * inFrames );
+        info.outOffset.push_back( k * outFrames );
+        info.inJump = 1;
+        info.outJump = 1;
       }
     }
   }
 
   // Add channel offset.
   if ( firstChannel > 0 ) {
-    if ( stream_.deviceInterleaved[mode] ) {
+    if ( device.interleaved ) {
       if ( mode == OUTPUT ) {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].outOffset[k] += firstChannel;
+        for ( int k=0; k<info.channels; k++ )
+          info.outOffset[k] += firstChannel;
       }
       else {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].inOffset[k] += firstChannel;
+        for ( int k=0; k<info.channels; k++ )
+          info.inOffset[k] += firstChannel;
       }
     }
     else {
       if ( mode == OUTPUT ) {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].outOffset[k] += ( firstChannel * stream_.bufferSize );
+        for ( int k=0; k<info.channels; k++ )
+          info.outOffset[k] += ( firstChannel * device.frames );
       }
       else {
-        for ( int k=0; k<stream_.convertInfo[mode].channels; k++ )
-          stream_.convertInfo[mode].inOffset[k] += ( firstChannel  * stream_.bufferSize );
+        for ( int k=0; k<info.channels; k++ )
+          info.inOffset[k] += ( firstChannel  * device.frames );
       }
     }
   }
+
+  // Pick the conversion code path once, so that convertBuffer() does
+  // not have to look at the formats or offsets again.  The offsets of
+  // consecutive channels are always a constant distance apart.
+  RtConvertPlan &plan = info.plan;
+  plan.channels = info.channels;
+  plan.inJump = info.inJump;
+  plan.outJump = info.outJump;
+  plan.inBase = plan.inStride = plan.outBase = plan.outStride = 0;
+  if ( info.channels > 0 ) {
+    plan.inBase = info.inOffset[0];
+    plan.outBase = info.outOffset[0];
+  }
+  if ( info.channels > 1 ) {
+    plan.inStride = info.inOffset[1] - info.inOffset[0];
+    plan.outStride = info.outOffset[1] - info.outOffset[0];
+  }
+
+  // Device samples in the other byte order are swapped as they are converted.
+  plan.swap = 0;
+  if ( device.byteSwap ) {
+    plan.swap = rtSwapKernel( device.format );
+    plan.swapInput = ( mode == INPUT );
+    plan.swapChannels = device.channels;
+    if ( device.interleaved ) {
+      plan.swapStride = 1;
+      plan.swapPitch = plan.swapChannels;
+    }
+    else {
+      plan.swapStride = device.frames;
+      plan.swapPitch = 1;
+    }
+  }
+  rtConvertPrepare( plan, info.inFormat, info.outFormat );
+
+  // Floating-point output converted to integers is clipped at full
+  // scale, so measure it first if asked to.
+  plan.meter = 0;
+  if ( mode == OUTPUT && stream_.clipMeter &&
+       ( info.outFormat != RTAUDIO_FLOAT32 && info.outFormat != RTAUDIO_FLOAT64 ) )
+    plan.meter = rtMeterKernel( info.inFormat );
+
+#if defined(__RTAUDIO_DEBUG__)
+  fprintf( stderr, "\nRtApi: %s conversion is %s.\n\n", ( mode == INPUT ) ? "input" : "output",
+           plan.name.c_str() );
+#endif
 }
 
 void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info )
 {
   // This function does format conversion, input/output channel compensation, and
   // data interleaving/deinterleaving.  24-bit integers are assumed to occupy
-  // the lower three bytes of a 32-bit integer.
+  // the lower three bytes of a 32-bit integer.  The code path was chosen by
+  // setConvertInfo() when the stream was opened (see RtConvert.cpp).
 
   // Clear our device buffer when in/out duplex device channels are different
   if ( outBuffer == stream_.deviceBuffer && stream_.mode == DUPLEX &&
        ( stream_.nDeviceChannels[0] < stream_.nDeviceChannels[1] ) )
     memset( outBuffer, 0, stream_.bufferSize * info.outJump * formatBytes( info.outFormat ) );
 
-  int j;
-  if (info.outFormat == RTAUDIO_FLOAT64) {
-    Float64 scale;
-    Float64 *out = (Float64 *)outBuffer;
-
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      scale = 1.0 / 127.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      scale = 1.0 / 32767.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int32 *in = (Int32 *)inBuffer;
-      scale = 1.0 / 8388607.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) (in[info.inOffset[j]] & 0x00ffffff);
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      scale = 1.0 / 2147483647.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      // Channel compensation and/or (de)interleaving only.
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
+  convertFrames( outBuffer, inBuffer, info, stream_.bufferSize );
+}
+
+void RtApi :: convertFrames( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames )
+{
+  RtConvertPool *pool = stream_.convertPool;
+  if ( pool && frames * conversionWidth( info ) >= stream_.convertThreshold ) {
+    ConvertJob job = { &info, outBuffer, inBuffer, frames };
+    pool->run( &convertPart, &job );
+    RtAudio::ConvertTiming &timing = stream_.convertTiming;
+    timing.conversions++;
+    timing.parallel += pool->wall();
+    timing.work += pool->work();
   }
-  else if (info.outFormat == RTAUDIO_FLOAT32) {
-    Float32 scale;
-    Float32 *out = (Float32 *)outBuffer;
+  else
+    convertRange( info, outBuffer, inBuffer, 0, frames );
 
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      scale = (Float32) ( 1.0 / 127.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      scale = (Float32) ( 1.0 / 32767.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int32 *in = (Int32 *)inBuffer;
-      scale = (Float32) ( 1.0 / 8388607.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) (in[info.inOffset[j]] & 0x00ffffff);
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      scale = (Float32) ( 1.0 / 2147483647.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
-          out[info.outOffset[j]] += 0.5;
-          out[info.outOffset[j]] *= scale;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      // Channel compensation and/or (de)interleaving only.
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
+  // The input of the last step is left as it was, so it is measured
+  // once every part is converted.
+  RtConvertPlan *plan = info.mix.function ? &info.mixed : &info.plan;
+  if ( plan->meter ) {
+    if ( info.mix.function ) inBuffer = (char *) &info.mixFrames[info.mix.inChannels * info.mix.pitch];
+    RtAudio::ClipInfo &clipping = stream_.clipping;
+    clipping.clipped = plan->meter( inBuffer, frames * plan->channels, &clipping.peak );
+    if ( clipping.clipped ) {
+      clipping.totalClipped += clipping.clipped;
+      clipping.clippedBuffers++;
     }
   }
-  else if (info.outFormat == RTAUDIO_SINT32) {
-    Int32 *out = (Int32 *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 24;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 16;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) { // Hmmm ... we could just leave it in the lower 3 bytes
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      // Channel compensation and/or (de)interleaving only.
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 2147483647.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 2147483647.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
+}
+
+void RtApi :: convertRange( ConvertInfo &info, char *outBuffer, char *inBuffer, unsigned int first,
+                            unsigned int frames )
+{
+  // Frame i of every plan is i jumps from its base, so a range of
+  // frames starts that many jumps into each buffer.  A mix only ever
+  // runs on whole user buffers, so its planar frames are always
+  // mix.pitch frames long.
+  RtConvertPlan *plan = &info.plan;
+  inBuffer += first * plan->inJump * plan->inBytes;
+  if ( info.mix.function ) {
+    float *mixIn = &info.mixFrames[first];
+    float *mixOut = mixIn + info.mix.inChannels * info.mix.pitch;
+    plan->function( *plan, (char *) mixIn, inBuffer, frames );
+    info.mix.function( info.mix, mixOut, mixIn, frames );
+    inBuffer = (char *) mixOut;
+    plan = &info.mixed;
+  }
+
+  plan->function( *plan, outBuffer + first * plan->outJump * plan->outBytes, inBuffer, frames );
+}
+
+void RtApi :: convertPart( void *ptr, unsigned int part, unsigned int parts )
+{
+  // Parts start on multiples of 16 frames, so that no two of them
+  // write to the same cache line.
+  ConvertJob &job = *(ConvertJob *) ptr;
+  unsigned int first = (unsigned int) ( (unsigned long long) job.frames * part / parts ) & ~15u;
+  unsigned int last = job.frames;
+  if ( part + 1 < parts ) last = (unsigned int) ( (unsigned long long) job.frames * ( part + 1 ) / parts ) & ~15u;
+  if ( last > first ) convertRange( *job.info, job.outBuffer, job.inBuffer, first, last - first );
+}
+
+unsigned int RtApi :: conversionWidth( const ConvertInfo &info )
+{
+  if ( !info.mix.function ) return info.plan.channels;
+  return ( info.mix.inChannels > info.mix.outChannels ) ? info.mix.inChannels : info.mix.outChannels;
+}
+
+void RtApi :: startConvertPool( RtAudio::StreamOptions *options )
+{
+  RtAudio::StreamOptions defaults;
+  if ( options == NULL ) options = &defaults;
+  if ( options->convertThreads == 0 ) return;
+
+  // The largest conversion of the stream decides.  A resampled
+  // direction converts up to maxFrames device frames at a time.
+  unsigned long samples = 0;
+  for ( int i=0; i<2; i++ ) {
+    if ( stream_.mode != i && stream_.mode != DUPLEX ) continue;
+    unsigned long n = (unsigned long) stream_.bufferSize * conversionWidth( stream_.convertInfo[i] );
+    if ( stream_.resample[i].resampler ) {
+      ResampleInfo &info = stream_.resample[i];
+      unsigned long m = (unsigned long) info.maxFrames * conversionWidth( info.convert );
+      if ( m > n ) n = m;
+    }
+    if ( ( stream_.doConvertBuffer[i] || stream_.resample[i].resampler ) && n > samples ) samples = n;
+  }
+  if ( samples == 0 || samples < options->convertThreshold ) return;
+
+  RtConvertPool *pool = new RtConvertPool;
+  bool realtime = ( options->flags & RTAUDIO_SCHEDULE_REALTIME ) != 0;
+  if ( !pool->start( options->convertThreads, (double) stream_.bufferSize / stream_.sampleRate,
+                     realtime, options->priority ) ) {
+    delete pool;
+    return;
   }
-  else if (info.outFormat == RTAUDIO_SINT24) {
-    Int32 *out = (Int32 *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 16;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      // Channel compensation and/or (de)interleaving only.
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
-          out[info.outOffset[j]] >>= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 8388607.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 8388607.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
+
+  stream_.convertPool = pool;
+  stream_.convertThreshold = options->convertThreshold;
+  stream_.convertTiming.threads = pool->threads();
+
+#if defined(__RTAUDIO_DEBUG__)
+  fprintf( stderr, "\nRtApi: conversions of %u samples or more shared between %u threads.\n\n",
+           stream_.convertThreshold, pool->threads() );
+#endif
+}
+
+void RtApi :: stopConvertPool( void )
+{
+  delete stream_.convertPool;
+  stream_.convertPool = 0;
+}
+
+std::string RtApi :: conversionName( const ConvertInfo &info )
+{
+  if ( !info.mix.function ) return info.plan.name;
+
+  std::ostringstream channels;
+  channels << info.mix.inChannels << " to " << info.mix.outChannels
+           << ( info.mix.outChannels == 1 ? " channel" : " channels" );
+  return info.plan.name + ", then mixed from " + channels.str() + " (" + info.mix.name + "), then " +
+    info.mixed.name;
+}
+
+bool RtApi :: setMixInfo( StreamMode mode, unsigned int channels, const std::vector<float> &matrix )
+{
+  ConvertInfo &info = stream_.convertInfo[mode];
+  unsigned int frames = stream_.bufferSize;
+  int inChannels = ( mode == OUTPUT ) ? channels : stream_.nUserChannels[mode];
+  int outChannels = ( mode == OUTPUT ) ? stream_.nUserChannels[mode] : channels;
+
+  free( stream_.userBuffer[mode] );
+  stream_.userBuffer[mode] = (char *) calloc( channels * frames * formatBytes( stream_.userFormat ), 1 );
+  if ( stream_.userBuffer[mode] == NULL ) {
+    errorText_ = "RtApi::setMixInfo: error allocating user buffer memory.";
+    return FAILURE;
   }
-  else if (info.outFormat == RTAUDIO_SINT16) {
-    Int16 *out = (Int16 *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) in[info.inOffset[j]];
-          out[info.outOffset[j]] <<= 8;
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT16) {
-      // Channel compensation and/or (de)interleaving only.
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) ((in[info.inOffset[j]] >> 8) & 0x0000ffff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) ((in[info.inOffset[j]] >> 16) & 0x0000ffff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]] * 32767.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]] * 32767.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
+  try {
+    info.mixFrames.assign( ( inChannels + outChannels ) * frames, 0.0f );
   }
-  else if (info.outFormat == RTAUDIO_SINT8) {
-    signed char *out = (signed char *)outBuffer;
-    if (info.inFormat == RTAUDIO_SINT8) {
-      // Channel compensation and/or (de)interleaving only.
-      signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = in[info.inOffset[j]];
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    if (info.inFormat == RTAUDIO_SINT16) {
-      Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 8) & 0x00ff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT24) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 16) & 0x000000ff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_SINT32) {
-      Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 24) & 0x000000ff);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
-    }
-    else if (info.inFormat == RTAUDIO_FLOAT32) {
-      Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]] * 127.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
+  catch ( std::bad_alloc& ) {
+    errorText_ = "RtApi::setMixInfo: error allocating mix memory.";
+    return FAILURE;
+  }
+
+  // The user buffer is converted to or from planar float frames of its
+  // own channels.
+  ConvertSide user = { stream_.userFormat, channels, stream_.userInterleaved, frames, false };
+  ConvertSide planar = { RTAUDIO_FLOAT32, channels, false, frames, false };
+  ConvertInfo userInfo;
+  setConvertInfo( userInfo, mode, user, planar, 0 );
+
+  // The conversion set up for the device side of the mix keeps its
+  // channel offsets and byte swapping, but meets planar float frames
+  // where the user buffer was.
+  if ( mode == OUTPUT ) {
+    info.mixed = info.plan;
+    info.mixed.inBase = 0;
+    info.mixed.inStride = frames;
+    info.mixed.inJump = 1;
+    rtConvertPrepare( info.mixed, RTAUDIO_FLOAT32, info.outFormat );
+    info.mixed.meter = 0;
+    if ( stream_.clipMeter && info.outFormat != RTAUDIO_FLOAT32 && info.outFormat != RTAUDIO_FLOAT64 )
+      info.mixed.meter = rtMeterKernel( RTAUDIO_FLOAT32 );
+    info.plan = userInfo.plan;
+  }
+  else {
+    info.plan.outBase = 0;
+    info.plan.outStride = frames;
+    info.plan.outJump = 1;
+    rtConvertPrepare( info.plan, info.inFormat, RTAUDIO_FLOAT32 );
+    info.mixed = userInfo.plan;
+  }
+
+  rtMixPrepare( info.mix, matrix, inChannels, outChannels, frames );
+
+#if defined(__RTAUDIO_DEBUG__)
+  fprintf( stderr, "\nRtApi: %s conversion is %s.\n\n", ( mode == INPUT ) ? "input" : "output",
+           conversionName( info ).c_str() );
+#endif
+  return SUCCESS;
+}
+
+bool RtApi :: setResampleInfo( StreamMode mode, unsigned int streamRate, unsigned int deviceRate,
+                               unsigned int firstChannel, RtAudioResampleQuality quality )
+{
+  ResampleInfo &info = stream_.resample[mode];
+  unsigned int channels = stream_.nUserChannels[mode];
+  try {
+    delete info.resampler;
+    info.resampler = 0;
+    if ( mode == OUTPUT ) {
+      info.resampler = new RtResampler( streamRate, deviceRate, channels, quality );
+      info.maxFrames = info.resampler->maxOutput( stream_.bufferSize );
+      info.resampler->reserve( stream_.bufferSize );
     }
-    else if (info.inFormat == RTAUDIO_FLOAT64) {
-      Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
-        for (j=0; j<info.channels; j++) {
-          out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]] * 127.5 - 0.5);
-        }
-        in += info.inJump;
-        out += info.outJump;
-      }
+    else {
+      info.resampler = new RtResampler( deviceRate, streamRate, channels, quality );
+      info.maxFrames = info.resampler->maxInput( stream_.bufferSize );
+      info.resampler->reserve( info.maxFrames );
     }
+    info.streamFrames.resize( stream_.bufferSize * channels );
+    info.deviceFrames.resize( info.maxFrames * channels );
   }
+  catch ( std::bad_alloc& ) {
+    errorText_ = "RtApi::setResampleInfo: error allocating resampler memory.";
+    return FAILURE;
+  }
+  info.deviceRate = deviceRate;
+
+  // Both rates carry interleaved float frames of the user channels;
+  // only the device side has a channel offset and swapped bytes.
+  ConvertSide user = { stream_.userFormat, channels, stream_.userInterleaved, stream_.bufferSize, false };
+  ConvertSide streamFrames = { RTAUDIO_FLOAT32, channels, true, stream_.bufferSize, false };
+  ConvertSide deviceFrames = { RTAUDIO_FLOAT32, channels, true, info.maxFrames, false };
+  ConvertSide device = { stream_.deviceFormat[mode], stream_.nDeviceChannels[mode], stream_.deviceInterleaved[mode],
+                         info.maxFrames, stream_.doByteSwap[mode] };
+  setConvertInfo( stream_.convertInfo[mode], mode, user, streamFrames, 0 );
+  setConvertInfo( info.convert, mode, deviceFrames, device, firstChannel );
+
+#if defined(__RTAUDIO_DEBUG__)
+  fprintf( stderr, "\nRtApi: %s resampled between %u and %u Hz (%s).\n\n", ( mode == INPUT ) ? "input" : "output",
+           streamRate, deviceRate, info.resampler->name().c_str() );
+#endif
+  return SUCCESS;
+}
+
+unsigned int RtApi :: resampleOutput( void )
+{
+  ResampleInfo &info = stream_.resample[0];
+  convertBuffer( (char *) &info.streamFrames[0], stream_.userBuffer[0], stream_.convertInfo[0] );
+  unsigned int frames = info.resampler->process( &info.deviceFrames[0], info.maxFrames,
+                                                 &info.streamFrames[0], stream_.bufferSize );
+
+  // A device buffer shared with the input holds its samples in the
+  // channels the output does not write.
+  if ( stream_.mode == DUPLEX && stream_.nUserChannels[0] < stream_.nDeviceChannels[0] )
+    memset( stream_.deviceBuffer, 0, info.maxFrames * stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] ) );
+
+  convertFrames( stream_.deviceBuffer, (char *) &info.deviceFrames[0], info.convert, frames );
+  return frames;
+}
+
+unsigned int RtApi :: resampleInputFrames( void )
+{
+  return stream_.resample[1].resampler->inputFrames( stream_.bufferSize );
+}
+
+void RtApi :: resampleInput( unsigned int frames )
+{
+  ResampleInfo &info = stream_.resample[1];
+  convertFrames( (char *) &info.deviceFrames[0], stream_.deviceBuffer, info.convert, frames );
+  info.resampler->process( &info.streamFrames[0], stream_.bufferSize, &info.deviceFrames[0], frames );
+  convertBuffer( stream_.userBuffer[1], (char *) &info.streamFrames[0], stream_.convertInfo[1] );
 }
 
   //static inline uint16_t bswap_16(uint16_t x) { return (x>>8) | (x<<8); }
@@ -7911,69 +8731,21 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
 
 void RtApi :: byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format )
 {
-  register char val;
-  register char *ptr;
-
-  ptr = buffer;
-  if ( format == RTAUDIO_SINT16 ) {
-    for ( unsigned int i=0; i<samples; i++ ) {
-      // Swap 1st and 2nd bytes.
-      val = *(ptr);
-      *(ptr) = *(ptr+1);
-      *(ptr+1) = val;
-
-      // Increment 2 bytes.
-      ptr += 2;
-    }
-  }
-  else if ( format == RTAUDIO_SINT24 ||
-            format == RTAUDIO_SINT32 ||
-            format == RTAUDIO_FLOAT32 ) {
-    for ( unsigned int i=0; i<samples; i++ ) {
-      // Swap 1st and 4th bytes.
-      val = *(ptr);
-      *(ptr) = *(ptr+3);
-      *(ptr+3) = val;
-
-      // Swap 2nd and 3rd bytes.
-      ptr += 1;
-      val = *(ptr);
-      *(ptr) = *(ptr+1);
-      *(ptr+1) = val;
-
-      // Increment 3 more bytes.
-      ptr += 3;
-    }
-  }
-  else if ( format == RTAUDIO_FLOAT64 ) {
-    for ( unsigned int i=0; i<samples; i++ ) {
-      // Swap 1st and 8th bytes
-      val = *(ptr);
-      *(ptr) = *(ptr+7);
-      *(ptr+7) = val;
-
-      // Swap 2nd and 7th bytes
-      ptr += 1;
-      val = *(ptr);
-      *(ptr) = *(ptr+5);
-      *(ptr+5) = val;
-
-      // Swap 3rd and 6th bytes
-      ptr += 1;
-      val = *(ptr);
-      *(ptr) = *(ptr+3);
-      *(ptr+3) = val;
-
-      // Swap 4th and 5th bytes
-      ptr += 1;
-      val = *(ptr);
-      *(ptr) = *(ptr+1);
-      *(ptr+1) = val;
-
-      // Increment 5 more bytes.
-      ptr += 5;
-    }
-  }
+  // Reverse the bytes of each sample in place, a vector at a time
+  // where the CPU allows (see RtConvert.cpp).
+  RtConvertKernel swap = rtSwapKernel( format );
+  if ( swap ) swap( buffer, buffer, samples );
+}
+
+void *RtApi :: callbackBuffer( StreamMode mode, char *buffer )
+{
+  if ( !stream_.channelPointers || !stream_.zeroCopy[mode] || buffer == 0 ) return buffer;
+
+  std::vector<void *> &channels = stream_.channelBuffer[mode];
+  unsigned int offset = stream_.bufferSize * formatBytes( stream_.userFormat );
+  for ( unsigned int i=0; i<channels.size(); i++ )
+    channels[i] = (void *) ( buffer + i * offset );
+  return (void *) &channels[0];
 }
 
   // Indentation settings for Vim and Emacs
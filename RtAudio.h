@@ -59,8 +59,9 @@
     internal routines will automatically take care of any necessary
     byte-swapping between the host format and the soundcard.  Thus,
     endian-ness is not a concern in the following format definitions.
-    Note that 24-bit data is expected to be encapsulated in a 32-bit
-    format.
+    Note that RTAUDIO_SINT24 data is expected to be encapsulated in a
+    32-bit format, while RTAUDIO_SINT24_PACKED samples take three bytes
+    each, with no padding between them.
 
     - \e RTAUDIO_SINT8:   8-bit signed integer.
     - \e RTAUDIO_SINT16:  16-bit signed integer.
@@ -68,6 +69,7 @@
     - \e RTAUDIO_SINT32:  32-bit signed integer.
     - \e RTAUDIO_FLOAT32: Normalized between plus/minus 1.0.
     - \e RTAUDIO_FLOAT64: Normalized between plus/minus 1.0.
+    - \e RTAUDIO_SINT24_PACKED: 24-bit signed integer in 3 bytes.
 */
 typedef unsigned long RtAudioFormat;
 static const RtAudioFormat RTAUDIO_SINT8 = 0x1;    // 8-bit signed integer.
@@ -76,6 +78,7 @@ static const RtAudioFormat RTAUDIO_SINT24 = 0x4;   // Lower 3 bytes of 32-bit si
 static const RtAudioFormat RTAUDIO_SINT32 = 0x8;   // 32-bit signed integer.
 static const RtAudioFormat RTAUDIO_FLOAT32 = 0x10; // Normalized between plus/minus 1.0.
 static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/minus 1.0.
+static const RtAudioFormat RTAUDIO_SINT24_PACKED = 0x40; // 24-bit signed integer in 3 bytes.
 
 /*! \typedef typedef unsigned long RtAudioStreamFlags;
     \brief RtAudio stream option flags.
@@ -87,6 +90,9 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     - \e RTAUDIO_MINIMIZE_LATENCY: Attempt to set stream parameters for lowest possible latency.
     - \e RTAUDIO_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ZERO_COPY:        Hand the callback device memory when no conversion is needed.
+    - \e RTAUDIO_CLIP_METER:       Count the output samples clipped by conversion to an integer format.
+    - \e RTAUDIO_ALSA_MMAP:        Transfer through the mmap area of the device (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -118,6 +124,38 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     If the RTAUDIO_ALSA_USE_DEFAULT flag is set, RtAudio will attempt to
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
+
+    If the RTAUDIO_ZERO_COPY flag is set, RtAudio will attempt to pass
+    the callback pointers straight into device memory (the JACK port
+    buffers, or the mmap area of an ALSA device) instead of copying
+    through its own buffers.  This only happens for a direction whose
+    device format, channel layout and interleaving already match the
+    stream, and only with the JACK and ALSA APIs; other streams run as
+    usual, and isStreamZeroCopy() tells whether it took effect.  Device
+    memory is only valid for the duration of one callback, so the
+    callback must not keep the pointers.  Because JACK ports are
+    separate buffers, a non-interleaved stream opened with this flag
+    receives the buffer argument of each zero-copy direction as an
+    array of \c void pointers, one per channel, instead of the channels
+    concatenated back-to-back.  A direction that does not take the
+    zero-copy path is passed back-to-back as usual, whatever the API.
+
+    If the RTAUDIO_CLIP_METER flag is set, RtAudio measures each output
+    buffer of a floating-point stream before converting it to an
+    integer device format, which clips samples beyond plus/minus 1.0.
+    The peak and clipped samples of the latest buffer, and running
+    totals, are returned by getStreamClipping().
+
+    If the RTAUDIO_ALSA_MMAP flag is set, an ALSA stream transfers its
+    samples through the mmap area of the device instead of reading and
+    writing them, which saves the copy alsa-lib makes.  A direction
+    that is converted is converted straight into (or out of) a period
+    of the device's ring buffer, and a direction that is not hands the
+    callback the period itself, as with RTAUDIO_ZERO_COPY.  Resampled
+    directions, and periods that wrap around the end of the ring,
+    are still copied.  Devices that do not offer interleaved mmap
+    access are read and written as usual; getStreamConversion() tells
+    which conversions work on the mmap area.
 */
 typedef unsigned int RtAudioStreamFlags;
 static const RtAudioStreamFlags RTAUDIO_NONINTERLEAVED = 0x1;    // Use non-interleaved buffers (default = interleaved).
@@ -125,6 +163,9 @@ static const RtAudioStreamFlags RTAUDIO_MINIMIZE_LATENCY = 0x2;  // Attempt to s
 static const RtAudioStreamFlags RTAUDIO_HOG_DEVICE = 0x4;        // Attempt grab device and prevent use by others.
 static const RtAudioStreamFlags RTAUDIO_SCHEDULE_REALTIME = 0x8; // Try to select realtime scheduling for callback thread.
 static const RtAudioStreamFlags RTAUDIO_ALSA_USE_DEFAULT = 0x10; // Use the "default" PCM device (ALSA only).
+static const RtAudioStreamFlags RTAUDIO_ZERO_COPY = 0x20;        // Hand the callback device memory when no conversion is needed.
+static const RtAudioStreamFlags RTAUDIO_CLIP_METER = 0x40;       // Count the output samples clipped by conversion to an integer format.
+static const RtAudioStreamFlags RTAUDIO_ALSA_MMAP = 0x80;        // Transfer through the mmap area of the device (ALSA only).
 
 /*! \typedef typedef unsigned long RtAudioStreamStatus;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -141,6 +182,30 @@ typedef unsigned int RtAudioStreamStatus;
 static const RtAudioStreamStatus RTAUDIO_INPUT_OVERFLOW = 0x1;    // Input data was discarded because of an overflow condition at the driver.
 static const RtAudioStreamStatus RTAUDIO_OUTPUT_UNDERFLOW = 0x2;  // The output buffer ran low, likely causing a gap in the output sound.
 
+/*! \typedef typedef unsigned int RtAudioResampleQuality;
+    \brief RtAudio sample-rate conversion presets.
+
+    A device that cannot run at the sample rate a stream asks for
+    normally runs the stream at the nearest rate it supports.  With
+    one of the following presets in the \c resampleQuality stream
+    option, the stream keeps the requested rate instead and RtAudio
+    converts its buffers to and from the device rate:
+
+    - \e RTAUDIO_RESAMPLE_NONE:   Run the stream at the device rate (the default).
+    - \e RTAUDIO_RESAMPLE_FAST:   16-tap filters, 70% of the band passed, 42 dB of aliasing rejection.
+    - \e RTAUDIO_RESAMPLE_MEDIUM: 48-tap filters, 80% of the band passed, 76 dB of aliasing rejection.
+    - \e RTAUDIO_RESAMPLE_BEST:   96-tap filters, 86% of the band passed, 103 dB of aliasing rejection.
+
+    The filters delay the signal by half their taps, counted at the
+    input rate of each direction.  Decimating filters widen in
+    proportion to the rate ratio, up to 256 taps.
+*/
+typedef unsigned int RtAudioResampleQuality;
+static const RtAudioResampleQuality RTAUDIO_RESAMPLE_NONE = 0;   // Run the stream at the device rate.
+static const RtAudioResampleQuality RTAUDIO_RESAMPLE_FAST = 1;   // Lowest latency and CPU time.
+static const RtAudioResampleQuality RTAUDIO_RESAMPLE_MEDIUM = 2; // A balance for most uses.
+static const RtAudioResampleQuality RTAUDIO_RESAMPLE_BEST = 3;   // Highest quality.
+
 //! RtAudio callback function prototype.
 /*!
    All RtAudio clients must create a function of type RtAudioCallback
@@ -237,14 +302,72 @@ class RtAudio
   };
 
   //! The structure for specifying input or ouput stream parameters.
+  /*!
+    By default, the \c nChannels channels of a stream buffer go to or
+    come from as many device channels, starting at \c firstChannel.  A
+    non-zero \c mixChannels instead opens \c mixChannels device
+    channels from \c firstChannel on, and RtAudio mixes them with the
+    gains in \c mixMatrix.  The matrix has a row for every channel
+    the mix writes and a column for every channel it reads, so it holds
+    \c mixChannels rows of \c nChannels gains for output and \c
+    nChannels rows of \c mixChannels gains for input.  For example,
+    an output stream with one channel, \c mixChannels = 2 and gains {
+    1, 1 } plays a mono buffer on both channels of a stereo device,
+    and an input stream with the same fields and gains { 0.5, 0.5 }
+    records the average of the two.  Mixing takes place on float
+    samples after conversion from the stream format (and before
+    conversion to the device format, for output), so a mix that
+    exceeds full scale is clipped by an integer device format.
+  */
   struct StreamParameters {
     unsigned int deviceId;     /*!< Device index (0 to getDeviceCount() - 1). */
     unsigned int nChannels;    /*!< Number of channels. */
     unsigned int firstChannel; /*!< First channel index on device (default = 0). */
+    unsigned int mixChannels;  /*!< Number of device channels mixed to or from the stream channels (default = 0, no mixing). */
+    std::vector<float> mixMatrix; /*!< Gains of the mix, row by row (see above). */
 
     // Default constructor.
     StreamParameters()
-      : deviceId(0), nChannels(0), firstChannel(0) {}
+      : deviceId(0), nChannels(0), firstChannel(0), mixChannels(0) {}
+  };
+
+  //! The structure for returning the output clipping of a stream.
+  struct ClipInfo {
+    double peak;                 /*!< Largest sample magnitude of the latest output buffer. */
+    unsigned int clipped;        /*!< Samples of the latest output buffer beyond plus/minus 1.0. */
+    unsigned long totalClipped;  /*!< Samples clipped since the stream was opened. */
+    unsigned long clippedBuffers; /*!< Output buffers with at least one clipped sample. */
+
+    // Default constructor.
+    ClipInfo()
+      : peak(0.0), clipped(0), totalClipped(0), clippedBuffers(0) {}
+  };
+
+  //! The structure for returning how a stream shares its buffer conversions between threads.
+  struct ConvertTiming {
+    unsigned int threads;        /*!< Threads that share a large conversion, the callback thread included (1 if it converts alone). */
+    unsigned long conversions;   /*!< Conversions shared between the threads since the stream was opened. */
+    double parallel;             /*!< Seconds those conversions took. */
+    double work;                 /*!< Seconds of work the threads did for them, added up, which is about what one thread alone would take. */
+    double saved;                /*!< Share of a buffer period each conversion saved, on average. */
+
+    // Default constructor.
+    ConvertTiming()
+      : threads(1), conversions(0), parallel(0.0), work(0.0), saved(0.0) {}
+  };
+
+  //! The structure for returning how regularly the callback thread of a stream wakes up.
+  struct WakeTiming {
+    unsigned long wakeups;       /*!< Buffers the callback thread woke up for since the stream was opened. */
+    double period;               /*!< Seconds of audio in a buffer, the ideal time between two wake-ups. */
+    double meanJitter;           /*!< Mean seconds by which the time between two wake-ups differs from the period. */
+    double maxJitter;            /*!< Largest such difference. */
+    double meanLate;             /*!< Mean seconds of audio ready beyond a buffer, in the direction that woke the thread up. */
+    double maxLate;              /*!< Largest such lateness. */
+
+    // Default constructor.
+    WakeTiming()
+      : wakeups(0), period(0.0), meanJitter(0.0), maxJitter(0.0), meanLate(0.0), maxLate(0.0) {}
   };
 
   //! The structure for specifying stream options.
@@ -257,6 +380,9 @@ class RtAudio
     - \e RTAUDIO_HOG_DEVICE:        Attempt grab device for exclusive use.
     - \e RTAUDIO_SCHEDULE_REALTIME: Attempt to select realtime scheduling for callback thread.
     - \e RTAUDIO_ALSA_USE_DEFAULT:  Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ZERO_COPY:         Hand the callback device memory when no conversion is needed.
+    - \e RTAUDIO_CLIP_METER:        Count the output samples clipped by conversion to an integer format.
+    - \e RTAUDIO_ALSA_MMAP:         Transfer through the mmap area of the device (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -291,6 +417,21 @@ class RtAudio
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
 
+    If the RTAUDIO_ZERO_COPY flag is set, RtAudio will attempt to pass
+    the callback pointers straight into device memory (JACK and ALSA
+    only), for each direction that needs no conversion.  The pointers
+    are only valid during the callback.  A zero-copy direction of a
+    non-interleaved stream is handed an array of per-channel pointers
+    (see RtAudioStreamFlags).
+
+    If the RTAUDIO_CLIP_METER flag is set, floating-point output is
+    measured before it is converted to an integer device format, and
+    getStreamClipping() returns the peak and the samples clipped.
+
+    If the RTAUDIO_ALSA_MMAP flag is set, an ALSA stream reads and
+    writes the device's ring buffer through its mmap area, converting
+    straight into or out of it where it can (see RtAudioStreamFlags).
+
     The \c numberOfBuffers parameter can be used to control stream
     latency in the Windows DirectSound, Linux OSS, and Linux Alsa APIs
     only.  A value of two is usually the smallest allowed.  Larger
@@ -303,16 +444,44 @@ class RtAudio
     when using the Jack API.  By default, the client name is set to
     RtApiJack.  However, if you wish to create multiple instances of
     RtAudio with Jack, each instance must have a unique client name.
+
+    The \c resampleQuality parameter selects what happens when a device
+    cannot run at the requested sample rate (currently only used with
+    the Linux Alsa API).  By default (RTAUDIO_RESAMPLE_NONE) the stream
+    runs at the rate the device picks, which getStreamSampleRate()
+    returns.  With one of the other RtAudioResampleQuality presets, the
+    stream keeps the requested rate and its buffers are resampled to
+    and from the device rate, at the cost of some latency and CPU time.
+    The device then transfers a varying number of frames per callback.
+
+    A stream with many channels can have a few helper threads share
+    its buffer conversions: every conversion of at least \c
+    convertThreshold samples (channels times frames) is cut into parts
+    of consecutive frames, which the callback thread and the helpers
+    convert at once before the buffer goes to the device.  Where the
+    system allows, helpers are pinned to their own cores, chosen from
+    the cores the process may run on with the first of them left to
+    the callback thread, and the helpers take the scheduling of the
+    callback thread.  The callback thread's own affinity is never
+    changed.  By default (\c convertThreads -1) a stream whose
+    conversions reach the threshold starts one helper per core
+    besides the first, up to three; a positive number
+    starts that many, and zero none.  getStreamConvertTiming() tells
+    how much of each period the helpers saved.
   */
   struct StreamOptions {
-    RtAudioStreamFlags flags;      /*!< A bit-mask of stream flags (RTAUDIO_NONINTERLEAVED, RTAUDIO_MINIMIZE_LATENCY, RTAUDIO_HOG_DEVICE, RTAUDIO_ALSA_USE_DEFAULT). */
+    RtAudioStreamFlags flags;      /*!< A bit-mask of stream flags (RTAUDIO_NONINTERLEAVED, RTAUDIO_MINIMIZE_LATENCY, RTAUDIO_HOG_DEVICE, RTAUDIO_ALSA_USE_DEFAULT, RTAUDIO_ZERO_COPY, RTAUDIO_CLIP_METER, RTAUDIO_ALSA_MMAP). */
     unsigned int numberOfBuffers;  /*!< Number of stream buffers. */
     std::string streamName;        /*!< A stream name (currently used only in Jack). */
     int priority;                  /*!< Scheduling priority of callback thread (only used with flag RTAUDIO_SCHEDULE_REALTIME). */
+    RtAudioResampleQuality resampleQuality; /*!< Resample when the device cannot run at the stream rate (currently used only in Alsa). */
+    int convertThreads;            /*!< Helper threads for large conversions (-1 = one per core besides the first, up to three; 0 = none). */
+    unsigned int convertThreshold; /*!< Samples (channels times frames) from which a conversion is shared with the helpers. */
 
     // Default constructor.
     StreamOptions()
-    : flags(0), numberOfBuffers(0), priority(0) {}
+    : flags(0), numberOfBuffers(0), priority(0), resampleQuality(RTAUDIO_RESAMPLE_NONE),
+      convertThreads(-1), convertThreshold(32768) {}
   };
 
   //! A static function to determine the available compiled audio APIs.
@@ -450,7 +619,13 @@ class RtAudio
     An RtError (type = SYSTEM_ERROR) is thrown if an error occurs
     during processing.  An RtError (type = INVALID_USE) is thrown if a
     stream is not open.  A warning is issued if the stream is already
-    stopped.
+    stopped.  With the ALSA and OSS APIs the call returns without
+    waiting for the queue to play out, which the callback thread goes
+    on with in the background.  A following startStream() or
+    closeStream() waits for it to finish (with ALSA, for no longer
+    than the device buffer takes to play), so nothing queued is lost.
+    With these APIs an error in draining or stopping the devices is
+    issued as a warning from the callback thread rather than thrown.
   */
   void stopStream( void );
 
@@ -486,6 +661,19 @@ class RtAudio
   */
   long getStreamLatency( void );
 
+  //! Returns the sample frames by which the output of a duplex stream lags the input it was computed from.
+  /*!
+    The Linux ALSA API starts both directions of a duplex stream
+    together, the playback device primed with silence, and restarts
+    them the same way after an xrun of either, so that this offset
+    stays the same for as long as the stream is open.  It counts the
+    buffering of the stream itself, not that of the hardware or of any
+    resampler.  The return value is zero for other streams and APIs.
+    If a stream is not open, an RtError (type = INVALID_USE) will be
+    thrown.
+  */
+  long getStreamDuplexOffset( void );
+
  //! Returns actual sample rate in use by the stream.
  /*!
    On some systems, the sample rate used may be slightly different
@@ -494,6 +682,53 @@ class RtAudio
  */
   unsigned int getStreamSampleRate( void );
 
+  //! Returns a description of the sample conversions the stream performs.
+  /*!
+    Each direction of the stream is described by the code path chosen
+    when the stream was opened to convert between the user and device
+    buffers, for example "output: sse2 float64 to sint16, 2 channels,
+    interleaved frames; input: unused".  A direction whose buffers need
+    no conversion is described as "none".  If a stream is not open, an
+    RtError (type = INVALID_USE) will be thrown.
+  */
+  std::string getStreamConversion( void );
+
+  //! Returns true if the stream callback reads and writes device memory directly.
+  /*!
+    This is the case when the stream was opened with the
+    RTAUDIO_ZERO_COPY flag and every direction of it qualified for the
+    zero-copy path (see RtAudioStreamFlags).  If a stream is not open,
+    an RtError (type = INVALID_USE) will be thrown.
+  */
+  bool isStreamZeroCopy( void );
+
+  //! Returns the output clipping measured since the stream was opened.
+  /*!
+    Output is only measured for a stream opened with the
+    RTAUDIO_CLIP_METER flag whose floating-point samples are converted
+    to an integer device format; otherwise every field is zero.  If a
+    stream is not open, an RtError (type = INVALID_USE) will be thrown.
+  */
+  ClipInfo getStreamClipping( void );
+
+  //! Returns how the stream has shared its buffer conversions between threads since it was opened.
+  /*!
+    A stream only starts helper threads if one of its conversions
+    reaches the \c convertThreshold of its StreamOptions; otherwise
+    \c threads is 1 and every other field zero.  If a stream is not
+    open, an RtError (type = INVALID_USE) will be thrown.
+  */
+  ConvertTiming getStreamConvertTiming( void );
+
+  //! Returns how regularly the callback thread has woken up since the stream was opened.
+  /*!
+    The Linux ALSA API polls its devices until every direction of the
+    stream can transfer a whole buffer, and times each wake-up.  Other
+    APIs leave every field zero.  If a stream is not open, an RtError
+    (type = INVALID_USE) will be thrown.
+  */
+  WakeTiming getStreamWakeTiming( void );
+
   //! Specify whether warning messages should be printed to stderr.
   void showWarnings( bool value = true ) throw();
 
@@ -542,6 +777,73 @@ struct CallbackInfo {
     :object(0), callback(0), userData(0), apiInfo(0), isRunning(false) {}
 };
 
+struct RtConvertPlan;
+struct RtMixPlan;
+class RtResampler;
+class RtConvertPool;
+
+// A function that converts one buffer of frames as described by a
+// conversion plan, and a kernel that converts one contiguous run of
+// samples.  Both are picked in RtConvert.cpp when a stream is opened.
+typedef void (*RtConvertFunction)( const RtConvertPlan &plan, char *outBuffer,
+                                   const char *inBuffer, unsigned int frames );
+typedef void (*RtConvertKernel)( void *out, const void *in, unsigned int samples );
+typedef unsigned int (*RtMeterKernel)( const void *in, unsigned int samples, double *peak );
+
+// A function that mixes one buffer of frames as described by a mixing
+// plan, and a kernel that writes one output channel as the sum of
+// \c terms input channels, each scaled by its gain.
+typedef void (*RtMixFunction)( const RtMixPlan &plan, float *out, const float *in, unsigned int frames );
+typedef void (*RtMixKernel)( float *out, const float *in, int pitch, const int *source,
+                             const float *gain, int terms, unsigned int frames );
+
+// This global structure type describes how RtApi::convertBuffer
+// converts one direction of a stream.  Offsets, strides and jumps are
+// counted in samples: channel k of frame i is found at
+// base + k * stride + i * jump.
+struct RtConvertPlan {
+  RtConvertFunction function;  // Converts a whole buffer (NULL until planned).
+  RtConvertKernel kernel;      // Used by function for contiguous runs, if any.
+  int channels;
+  int inBytes, outBytes;       // Bytes per sample.
+  int inBase, inStride, inJump;
+  int outBase, outStride, outJump;
+  std::string name;            // Describes the chosen code path.
+  RtMeterKernel meter;         // Measures the input before conversion, or NULL.
+
+  // Byte swapping of the device samples, folded into the conversion.
+  RtConvertFunction convert;   // The conversion proper, when function also swaps.
+  RtConvertKernel swap;        // Swaps samples in place, or NULL if none need it.
+  bool swapInput;              // The device samples are the input.
+  int swapChannels;            // All channels of the device buffer ...
+  int swapStride, swapPitch;   // ... and where they are, as above.
+
+  // Default constructor.
+  RtConvertPlan()
+    :function(0), kernel(0), channels(0), inBytes(0), outBytes(0), inBase(0), inStride(0),
+     inJump(0), outBase(0), outStride(0), outJump(0), meter(0), convert(0), swap(0), swapInput(false),
+     swapChannels(0), swapStride(0), swapPitch(0) {}
+};
+
+// This global structure type describes the channel mixing matrix
+// RtApi::convertBuffer applies between two conversions.  Both sides
+// hold float samples, channel k starting at k * pitch.  Only the
+// non-zero gains are kept, as the terms of their output channel.
+struct RtMixPlan {
+  RtMixFunction function;      // Mixes a whole buffer (NULL without a mix).
+  RtMixKernel kernel;          // Used by function for channels with several terms or gains other than one.
+  int inChannels, outChannels;
+  int pitch;
+  std::vector<int> first;      // Terms of output channel k are first[k] to first[k + 1] - 1.
+  std::vector<int> source;     // Input channel of each term.
+  std::vector<float> gain;     // Gain of each term.
+  std::string name;            // Describes the chosen code path.
+
+  // Default constructor.
+  RtMixPlan()
+    :function(0), kernel(0), inChannels(0), outChannels(0), pitch(0) {}
+};
+
 // **************************************************************** //
 //
 // RtApi class declaration.
@@ -583,7 +885,13 @@ public:
   virtual void stopStream( void ) = 0;
   virtual void abortStream( void ) = 0;
   long getStreamLatency( void );
+  long getStreamDuplexOffset( void );
   unsigned int getStreamSampleRate( void );
+  std::string getStreamConversion( void );
+  bool isStreamZeroCopy( void );
+  RtAudio::ClipInfo getStreamClipping( void );
+  RtAudio::ConvertTiming getStreamConvertTiming( void );
+  RtAudio::WakeTiming getStreamWakeTiming( void );
   virtual double getStreamTime( void );
   bool isStreamOpen( void ) const { return stream_.state != STREAM_CLOSED; };
   bool isStreamRunning( void ) const { return stream_.state == STREAM_RUNNING; };
@@ -610,13 +918,53 @@ protected:
     UNINITIALIZED = -75
   };
 
-  // A protected structure used for buffer conversion.
+  // A protected structure used for buffer conversion.  With a mixing
+  // matrix, plan converts the input to planar float frames, mix mixes
+  // them into mixFrames, and mixed converts those to the output.
   struct ConvertInfo {
     int channels;
     int inJump, outJump;
     RtAudioFormat inFormat, outFormat;
     std::vector<int> inOffset;
     std::vector<int> outOffset;
+    RtConvertPlan plan;
+    RtMixPlan mix;
+    RtConvertPlan mixed;
+    std::vector<float> mixFrames;  // The planar frames before and after the mix.
+  };
+
+  // A protected structure used to convert a direction between the
+  // stream and device sample rates.  The user buffer is converted to
+  // or from float frames at the stream rate, and float frames at the
+  // device rate to or from the device buffer.
+  struct ResampleInfo {
+    RtResampler *resampler;    // NULL when the device runs at the stream rate.
+    unsigned int deviceRate;
+    unsigned int maxFrames;    // Most device frames a user buffer converts to or from.
+    std::vector<float> streamFrames;
+    std::vector<float> deviceFrames;
+    ConvertInfo convert;       // Between deviceFrames and the device buffer.
+
+    ResampleInfo()
+      :resampler(0), deviceRate(0), maxFrames(0) {}
+  };
+
+  // A conversion shared out by RtConvertPool.
+  struct ConvertJob {
+    ConvertInfo *info;
+    char *outBuffer;
+    char *inBuffer;
+    unsigned int frames;
+  };
+
+  // One side of a buffer conversion.  A non-interleaved buffer holds
+  // frames samples of each channel.
+  struct ConvertSide {
+    RtAudioFormat format;
+    unsigned int channels;
+    bool interleaved;
+    unsigned int frames;
+    bool byteSwap;
   };
 
   // A protected structure for audio streams.
@@ -631,18 +979,32 @@ protected:
     bool userInterleaved;
     bool deviceInterleaved[2]; // Playback and record, respectively.
     bool doByteSwap[2];        // Playback and record, respectively.
+    bool doMix[2];             // Mix through a matrix; playback and record, respectively.
+    bool zeroCopy[2];          // Callback uses device memory; playback and record, respectively.
+    bool mapped[2];            // Conversion uses device memory; playback and record, respectively.
+    bool channelPointers;      // Zero-copy callback buffers are arrays of per-channel pointers.
+    std::vector<void *> channelBuffer[2]; // Per-channel pointers handed to the callback.
+    bool clipMeter;            // Measure output clipping (RTAUDIO_CLIP_METER).
+    RtAudio::ClipInfo clipping;
+    RtConvertPool *convertPool;       // Helper threads for large conversions, or NULL.
+    unsigned int convertThreshold;    // Samples from which a conversion uses them.
+    RtAudio::ConvertTiming convertTiming;
+    RtAudio::WakeTiming wakeTiming;   // The means hold sums until read.
+    unsigned long wakeIntervals;      // Wake-ups that followed another.
     unsigned int sampleRate;
     unsigned int bufferSize;
     unsigned int nBuffers;
-    unsigned int nUserChannels[2];    // Playback and record, respectively.
+    unsigned int nUserChannels[2];    // Playback and record; the device side of a mix, if doMix.
     unsigned int nDeviceChannels[2];  // Playback and record channels, respectively.
     unsigned int channelOffset[2];    // Playback and record, respectively.
     unsigned long latency[2];         // Playback and record, respectively.
+    long duplexOffset;                // Frames output lags input by, if kept fixed.
     RtAudioFormat userFormat;
     RtAudioFormat deviceFormat[2];    // Playback and record, respectively.
     StreamMutex mutex;
     CallbackInfo callbackInfo;
     ConvertInfo convertInfo[2];
+    ResampleInfo resample[2];  // Playback and record, respectively.
     double streamTime;         // Number of elapsed seconds since the stream started.
 
 #if defined(HAVE_GETTIMEOFDAY)
@@ -650,7 +1012,7 @@ protected:
 #endif
 
     RtApiStream()
-      :apiHandle(0), deviceBuffer(0) { device[0] = 11111; device[1] = 11111; }
+      :apiHandle(0), deviceBuffer(0), convertPool(0) { device[0] = 11111; device[1] = 11111; }
   };
 
   typedef signed short Int16;
@@ -678,6 +1040,15 @@ protected:
   //! A protected function used to increment the stream time.
   void tickStreamTime( void );
 
+  //! Protected methods that read and set the stream state without the mutex.
+  /*!
+    A callback thread tests the state between device transfers, which
+    it makes without the mutex, so that the control methods never wait
+    for the device.
+  */
+  StreamState streamState( void );
+  void setStreamState( StreamState state );
+
   //! Protected common method to clear an RtApiStream structure.
   void clearStreamInfo();
 
@@ -696,6 +1067,33 @@ protected:
   */
   void convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info );
 
+  //! Protected common method that converts \c frames frames, where a buffer may hold fewer than bufferSize.
+  void convertFrames( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames );
+
+  //! Protected common method that describes the code paths of a conversion.
+  std::string conversionName( const ConvertInfo &info );
+
+  //! Protected common method that returns the channels a conversion works on, those of the wider side of a mix.
+  unsigned int conversionWidth( const ConvertInfo &info );
+
+  //! Protected common function that converts part \c part of \c parts of a ConvertJob, for RtConvertPool.
+  static void convertPart( void *ptr, unsigned int part, unsigned int parts );
+
+  //! Protected common function that converts frames \c first to \c first + \c frames - 1 of a buffer.
+  static void convertRange( ConvertInfo &info, char *outBuffer, char *inBuffer, unsigned int first,
+                            unsigned int frames );
+
+  /*!
+    Protected common method that starts helper threads for the
+    conversions of an open stream, if they are large enough and the
+    options ask for any.  The stream converts alone if none can be
+    started.
+  */
+  void startConvertPool( RtAudio::StreamOptions *options );
+
+  //! Protected common method that stops the helper threads of a stream, if it has any.
+  void stopConvertPool( void );
+
   //! Protected common method used to perform byte-swapping on buffers.
   void byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format );
 
@@ -704,6 +1102,47 @@ protected:
 
   //! Protected common method that sets up the parameters for buffer conversion.
   void setConvertInfo( StreamMode mode, unsigned int firstChannel );
+
+  //! Protected common method that sets up a conversion between the given user and device sides.
+  void setConvertInfo( ConvertInfo &info, StreamMode mode, const ConvertSide &user,
+                       const ConvertSide &device, unsigned int firstChannel );
+
+  /*!
+    Protected common method that sets up sample-rate conversion of a
+    direction between the stream rate and \c deviceRate, in place of
+    setConvertInfo().  The bufferSize, channel, format and interleaving
+    fields of the direction must be set.  Returns FAILURE, with
+    errorText_ set, if memory runs out.
+  */
+  bool setResampleInfo( StreamMode mode, unsigned int streamRate, unsigned int deviceRate,
+                        unsigned int firstChannel, RtAudioResampleQuality quality );
+
+  /*!
+    Protected common method that puts a mixing matrix between the
+    \c channels channels of the user buffer of a direction and the
+    nUserChannels channels its conversion was set up for, by
+    setConvertInfo() or setResampleInfo().  The user buffer is
+    reallocated for \c channels channels.  Returns FAILURE, with
+    errorText_ set, if memory runs out.
+  */
+  bool setMixInfo( StreamMode mode, unsigned int channels, const std::vector<float> &matrix );
+
+  //! Protected common method that resamples the output user buffer into the device buffer and returns the device frames written.
+  unsigned int resampleOutput( void );
+
+  //! Protected common method that returns the device frames resampleInput() needs for the next input user buffer.
+  unsigned int resampleInputFrames( void );
+
+  //! Protected common method that resamples \c frames device frames from the device buffer into the input user buffer.
+  void resampleInput( unsigned int frames );
+
+  /*!
+    Protected common method that returns the buffer argument handed to
+    the callback for a direction whose samples start at \c buffer:
+    either \c buffer itself or, for a zero-copy direction of a
+    non-interleaved stream, an array of pointers to its channels.
+  */
+  void *callbackBuffer( StreamMode mode, char *buffer );
 };
 
 // **************************************************************** //
@@ -724,7 +1163,13 @@ inline void RtAudio :: abortStream( void ) { return rtapi_->abortStream(); }
 inline bool RtAudio :: isStreamOpen( void ) const throw() { return rtapi_->isStreamOpen(); }
 inline bool RtAudio :: isStreamRunning( void ) const throw() { return rtapi_->isStreamRunning(); }
 inline long RtAudio :: getStreamLatency( void ) { return rtapi_->getStreamLatency(); }
+inline long RtAudio :: getStreamDuplexOffset( void ) { return rtapi_->getStreamDuplexOffset(); }
 inline unsigned int RtAudio :: getStreamSampleRate( void ) { return rtapi_->getStreamSampleRate(); };
+inline std::string RtAudio :: getStreamConversion( void ) { return rtapi_->getStreamConversion(); }
+inline bool RtAudio :: isStreamZeroCopy( void ) { return rtapi_->isStreamZeroCopy(); }
+inline RtAudio::ClipInfo RtAudio :: getStreamClipping( void ) { return rtapi_->getStreamClipping(); }
+inline RtAudio::ConvertTiming RtAudio :: getStreamConvertTiming( void ) { return rtapi_->getStreamConvertTiming(); }
+inline RtAudio::WakeTiming RtAudio :: getStreamWakeTiming( void ) { return rtapi_->getStreamWakeTiming(); }
 inline double RtAudio :: getStreamTime( void ) { return rtapi_->getStreamTime(); }
 inline void RtAudio :: showWarnings( bool value ) throw() { rtapi_->showWarnings( value ); }
 
@@ -901,12 +1346,31 @@ public:
 
   private:
 
+  // The devices found by the last scan, by card and device number, and
+  // the cached probe of each.
   std::vector<RtAudio::DeviceInfo> devices_;
+  std::vector<int> cards_;
+  std::vector<int> pcms_;
+  std::vector<bool> cached_;
+  int watch_;           // inotify descriptor watching /dev/snd, or -1
+  bool scanned_;
+  bool filled_;         // every device was probed since the last scan
   void saveDeviceInfo( void );
+  void scanDevices( bool force );
+  RtAudio::DeviceInfo probeDevice( unsigned int device, std::ostringstream &warnings );
+  void reportWarnings( std::ostringstream &warnings );
+  static void *probeThread( void *ptr );
   bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
                         RtAudio::StreamOptions *options );
+  bool waitForPeriod( double *wake, double *late );
+  int alignDuplex( void );
+  void waitForDrain( void );
+  int writeSilence( unsigned long frames );
+  char *mapPeriod( StreamMode mode, unsigned long *offset );
+  void commitPeriod( StreamMode mode, unsigned long offset );
+  void recoverDevice( StreamMode mode, int result, const char *action );
 };
 
 #endif
@@ -939,6 +1403,7 @@ public:
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
                         RtAudio::StreamOptions *options );
+  void haltDevices( bool flush );
 };
 
 #endif
@@ -0,0 +1,1504 @@
+/************************************************************************/
+/*! \file RtConvert.cpp
+    \brief Sample format conversion plans and kernels (see RtConvert.h).
+
+    Integer to floating-point conversions add 0.5 and scale by
+    1 / (max + 0.5); floating-point to integer conversions multiply by
+    (max + 0.5), subtract 0.5, clamp to the integer range and truncate,
+    in double precision.  Samples within plus/minus 1.0 never reach the
+    clamp, and NaNs saturate low.
+    Integer to integer conversions shift.  These are the formulas
+    RtApi::convertBuffer has always used.  24-bit integers occupy the
+    lower three bytes of a 32-bit integer; packed 24-bit integers take
+    three bytes in host order, and convert to floats from their sign
+    extended value.  Samples left over after the last full vector go
+    through the same formulas one at a time.
+*/
+/************************************************************************/
+
+#include "RtConvert.h"
+#include "cpu.h"
+#include <cstring>
+#include <sstream>
+
+// Sample formats.  half() is the scale between integers and floats,
+// lowest() and highest() bound an integer sample, and BITS is the
+// position of its sign bit plus one.
+struct RtS8 {
+  typedef signed char T;
+  static const int FLOAT = 0, BITS = 8;
+  static double half( void ) { return 127.5; }
+  static double lowest( void ) { return -128.0; }
+  static double highest( void ) { return 127.0; }
+  static int value( T v ) { return v; }
+};
+
+struct RtS16 {
+  typedef signed short T;
+  static const int FLOAT = 0, BITS = 16;
+  static double half( void ) { return 32767.5; }
+  static double lowest( void ) { return -32768.0; }
+  static double highest( void ) { return 32767.0; }
+  static int value( T v ) { return v; }
+};
+
+struct RtS24 {
+  typedef signed int T;
+  static const int FLOAT = 0, BITS = 24;
+  static double half( void ) { return 8388607.5; }
+  static double lowest( void ) { return -8388608.0; }
+  static double highest( void ) { return 8388607.0; }
+  static int value( T v ) { return v & 0x00ffffff; }
+};
+
+struct RtS32 {
+  typedef signed int T;
+  static const int FLOAT = 0, BITS = 32;
+  static double half( void ) { return 2147483647.5; }
+  static double lowest( void ) { return -2147483648.0; }
+  static double highest( void ) { return 2147483647.0; }
+  static int value( T v ) { return v; }
+};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define RT_BIG_ENDIAN
+#endif
+
+// A packed 24-bit sample.  It converts to and from int like the
+// integer types do, keeping the low three bytes of an int and sign
+// extending them back.
+struct RtInt24 {
+  unsigned char b[3];
+
+  RtInt24() {}
+  RtInt24( int v ) {
+#if defined(RT_BIG_ENDIAN)
+    b[0] = (unsigned char) ( v >> 16 ); b[1] = (unsigned char) ( v >> 8 ); b[2] = (unsigned char) v;
+#else
+    b[0] = (unsigned char) v; b[1] = (unsigned char) ( v >> 8 ); b[2] = (unsigned char) ( v >> 16 );
+#endif
+  }
+  operator int() const {
+#if defined(RT_BIG_ENDIAN)
+    return (int) ( ( (unsigned int) b[0] << 24 ) | ( b[1] << 16 ) | ( b[2] << 8 ) ) >> 8;
+#else
+    return (int) ( ( (unsigned int) b[2] << 24 ) | ( b[1] << 16 ) | ( b[0] << 8 ) ) >> 8;
+#endif
+  }
+};
+
+struct RtS24P {
+  typedef RtInt24 T;
+  static const int FLOAT = 0, BITS = 24;
+  static double half( void ) { return 8388607.5; }
+  static double lowest( void ) { return -8388608.0; }
+  static double highest( void ) { return 8388607.0; }
+  static int value( T v ) { return v; }
+};
+
+struct RtF32 {
+  typedef float T;
+  static const int FLOAT = 1;
+};
+
+struct RtF64 {
+  typedef double T;
+  static const int FLOAT = 1;
+};
+
+// One sample at a time, exactly as the original RtApi::convertBuffer
+// loops did it.  Integers are shifted between widths (24-bit samples
+// unmasked), and converted to floats from their masked value.
+template <class In, class Out, int IN_FLOAT = In::FLOAT, int OUT_FLOAT = Out::FLOAT>
+struct RtSample;
+
+template <class In, class Out> struct RtSample<In, Out, 0, 0> {
+  static const int LEFT = Out::BITS > In::BITS ? Out::BITS - In::BITS : 0;
+  static const int RIGHT = In::BITS > Out::BITS ? In::BITS - Out::BITS : 0;
+  static inline typename Out::T convert( typename In::T v ) {
+    return (typename Out::T) ( ( (int) v << LEFT ) >> RIGHT );
+  }
+};
+
+template <class In, class Out> struct RtSample<In, Out, 0, 1> {
+  static inline typename Out::T convert( typename In::T v ) {
+    typename Out::T scale = (typename Out::T) ( 1.0 / In::half() );
+    typename Out::T out = (typename Out::T) In::value( v );
+    out += 0.5;
+    out *= scale;
+    return out;
+  }
+};
+
+template <class In, class Out> struct RtSample<In, Out, 1, 0> {
+  static inline typename Out::T convert( typename In::T v ) {
+    double x = v * Out::half() - 0.5;
+    x = x > Out::lowest() ? x : Out::lowest();
+    x = x < Out::highest() ? x : Out::highest();
+    return (typename Out::T) x;
+  }
+};
+
+template <class In, class Out> struct RtSample<In, Out, 1, 1> {
+  static inline typename Out::T convert( typename In::T v ) { return (typename Out::T) v; }
+};
+
+// Same format on both sides: channel compensation only.
+template <int BYTES> static void rtCopy( void *out, const void *in, unsigned int samples )
+{
+  memcpy( out, in, (size_t) samples * BYTES );
+}
+
+// Sample bits of each size, for transposes and byte swapping.
+template <int BYTES> struct RtBits;
+template <> struct RtBits<1> { typedef unsigned char T; };
+template <> struct RtBits<2> { typedef unsigned short T; };
+template <> struct RtBits<3> { typedef RtInt24 T; };
+template <> struct RtBits<4> { typedef unsigned int T; };
+template <> struct RtBits<8> { typedef unsigned long long T; };
+
+static inline unsigned short rtSwap( unsigned short v )
+{
+  return (unsigned short) ( ( v >> 8 ) | ( v << 8 ) );
+}
+
+static inline RtInt24 rtSwap( RtInt24 v )
+{
+  unsigned char t = v.b[0];
+  v.b[0] = v.b[2];
+  v.b[2] = t;
+  return v;
+}
+
+static inline unsigned int rtSwap( unsigned int v )
+{
+  return ( v >> 24 ) | ( ( v >> 8 ) & 0x0000ff00 ) | ( ( v << 8 ) & 0x00ff0000 ) | ( v << 24 );
+}
+
+static inline unsigned long long rtSwap( unsigned long long v )
+{
+  return ( (unsigned long long) rtSwap( (unsigned int) v ) << 32 ) | rtSwap( (unsigned int) ( v >> 32 ) );
+}
+
+// Reverses the bytes of each sample, in place if out == in.
+template <int BYTES> static void rtSwapScalar( void *out, const void *in, unsigned int samples )
+{
+  typedef typename RtBits<BYTES>::T E;
+  const E *src = (const E *) in;
+  E *dst = (E *) out;
+  for ( unsigned int i=0; i<samples; i++ ) dst[i] = rtSwap( src[i] );
+}
+
+// Finishes measuring floating-point samples i .. samples - 1, given the
+// peak magnitude and clipped count of those before.  A sample clips when
+// its magnitude is above 1.0 (or it is a NaN); NaNs leave the peak alone.
+template <class F> static unsigned int rtMeterTail( const typename F::T *src, unsigned int i, unsigned int samples,
+                                                    typename F::T top, unsigned int clipped, double *peak )
+{
+  for ( ; i < samples; i++ ) {
+    typename F::T a = src[i] < 0 ? -src[i] : src[i];
+    if ( a > top ) top = a;
+    if ( !( a <= 1 ) ) clipped++;
+  }
+  *peak = top;
+  return clipped;
+}
+
+// Measures the peak and clipped samples of a floating-point run.
+template <class F> static unsigned int rtMeterScalar( const void *in, unsigned int samples, double *peak )
+{
+  return rtMeterTail<F>( (const typename F::T *) in, 0, samples, 0, 0, peak );
+}
+
+// ****************************************************************** //
+//
+// SSE2 (and the 4-sample integer loads and stores AVX2 shares)
+//
+// ****************************************************************** //
+
+#if defined(CPU_SSE2)
+
+// Loads four samples as 32-bit integers, and stores four back.
+template <class I> struct RtSse2;
+
+template <> struct RtSse2<RtS16> {
+  static inline __m128i load( const signed short *p ) {
+    __m128i v = _mm_loadl_epi64( (const __m128i *) p );
+    return _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 );
+  }
+  static inline void store( signed short *p, __m128i v ) {
+    _mm_storel_epi64( (__m128i *) p, _mm_packs_epi32( v, v ) );
+  }
+};
+
+template <> struct RtSse2<RtS24> {
+  static inline __m128i load( const signed int *p ) {
+    return _mm_and_si128( _mm_loadu_si128( (const __m128i *) p ), _mm_set1_epi32( 0x00ffffff ) );
+  }
+  static inline void store( signed int *p, __m128i v ) { _mm_storeu_si128( (__m128i *) p, v ); }
+};
+
+template <> struct RtSse2<RtS32> {
+  static inline __m128i load( const signed int *p ) { return _mm_loadu_si128( (const __m128i *) p ); }
+  static inline void store( signed int *p, __m128i v ) { _mm_storeu_si128( (__m128i *) p, v ); }
+};
+
+// Four packed samples are twelve bytes, moved as eight plus four so
+// that nothing past them is touched.  Sample k sits at byte 3k packed
+// and at byte 4k + 1 unpacked (so that the top byte carries its sign).
+template <> struct RtSse2<RtS24P> {
+  static inline __m128i load12( const RtInt24 *p ) {
+    int tail;
+    memcpy( &tail, (const char *) p + 8, 4 );
+    return _mm_unpacklo_epi64( _mm_loadl_epi64( (const __m128i *) p ), _mm_cvtsi32_si128( tail ) );
+  }
+  static inline void store12( RtInt24 *p, __m128i v ) {
+    int tail = _mm_cvtsi128_si32( _mm_srli_si128( v, 8 ) );
+    _mm_storel_epi64( (__m128i *) p, v );
+    memcpy( (char *) p + 8, &tail, 4 );
+  }
+  static inline __m128i load( const RtInt24 *p ) {
+    __m128i v = load12( p );
+    __m128i a = _mm_or_si128( _mm_and_si128( _mm_slli_si128( v, 1 ), _mm_set_epi32( 0, 0, 0, -1 ) ),
+                              _mm_and_si128( _mm_slli_si128( v, 2 ), _mm_set_epi32( 0, 0, -1, 0 ) ) );
+    __m128i b = _mm_or_si128( _mm_and_si128( _mm_slli_si128( v, 3 ), _mm_set_epi32( 0, -1, 0, 0 ) ),
+                              _mm_and_si128( _mm_slli_si128( v, 4 ), _mm_set_epi32( -1, 0, 0, 0 ) ) );
+    return _mm_srai_epi32( _mm_or_si128( a, b ), 8 );
+  }
+  static inline void store( RtInt24 *p, __m128i v ) {
+    __m128i a = _mm_or_si128( _mm_and_si128( v, _mm_set_epi32( 0, 0, 0, 0x00ffffff ) ),
+                              _mm_srli_si128( _mm_and_si128( v, _mm_set_epi32( 0, 0, 0x00ffffff, 0 ) ), 1 ) );
+    __m128i b = _mm_or_si128( _mm_srli_si128( _mm_and_si128( v, _mm_set_epi32( 0, 0x00ffffff, 0, 0 ) ), 2 ),
+                              _mm_srli_si128( _mm_and_si128( v, _mm_set_epi32( 0x00ffffff, 0, 0, 0 ) ), 3 ) );
+    store12( p, _mm_or_si128( a, b ) );
+  }
+};
+
+struct RtIsaSse2 {
+
+  template <class I> static void intToFloat32( void *out, const void *in, unsigned int samples )
+  {
+    const typename I::T *src = (const typename I::T *) in;
+    float *dst = (float *) out;
+    __m128 half = _mm_set1_ps( 0.5f );
+    __m128 scale = _mm_set1_ps( (float) ( 1.0 / I::half() ) );
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m128 v = _mm_cvtepi32_ps( RtSse2<I>::load( src + i ) );
+      _mm_storeu_ps( dst + i, _mm_mul_ps( _mm_add_ps( v, half ), scale ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<I, RtF32>::convert( src[i] );
+  }
+
+  template <class I> static void intToFloat64( void *out, const void *in, unsigned int samples )
+  {
+    const typename I::T *src = (const typename I::T *) in;
+    double *dst = (double *) out;
+    __m128d half = _mm_set1_pd( 0.5 );
+    __m128d scale = _mm_set1_pd( 1.0 / I::half() );
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m128i v = RtSse2<I>::load( src + i );
+      __m128d lo = _mm_cvtepi32_pd( v );
+      __m128d hi = _mm_cvtepi32_pd( _mm_unpackhi_epi64( v, v ) );
+      _mm_storeu_pd( dst + i, _mm_mul_pd( _mm_add_pd( lo, half ), scale ) );
+      _mm_storeu_pd( dst + i + 2, _mm_mul_pd( _mm_add_pd( hi, half ), scale ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<I, RtF64>::convert( src[i] );
+  }
+
+  template <class I> static inline __m128i fromDouble( __m128d lo, __m128d hi )
+  {
+    __m128d mul = _mm_set1_pd( I::half() );
+    __m128d half = _mm_set1_pd( 0.5 );
+    __m128d low = _mm_set1_pd( I::lowest() );
+    __m128d high = _mm_set1_pd( I::highest() );
+    lo = _mm_min_pd( _mm_max_pd( _mm_sub_pd( _mm_mul_pd( lo, mul ), half ), low ), high );
+    hi = _mm_min_pd( _mm_max_pd( _mm_sub_pd( _mm_mul_pd( hi, mul ), half ), low ), high );
+    return _mm_unpacklo_epi64( _mm_cvttpd_epi32( lo ), _mm_cvttpd_epi32( hi ) );
+  }
+
+  template <class I> static void float32ToInt( void *out, const void *in, unsigned int samples )
+  {
+    const float *src = (const float *) in;
+    typename I::T *dst = (typename I::T *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m128 v = _mm_loadu_ps( src + i );
+      RtSse2<I>::store( dst + i, fromDouble<I>( _mm_cvtps_pd( v ), _mm_cvtps_pd( _mm_movehl_ps( v, v ) ) ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF32, I>::convert( src[i] );
+  }
+
+  template <class I> static void float64ToInt( void *out, const void *in, unsigned int samples )
+  {
+    const double *src = (const double *) in;
+    typename I::T *dst = (typename I::T *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      RtSse2<I>::store( dst + i, fromDouble<I>( _mm_loadu_pd( src + i ), _mm_loadu_pd( src + i + 2 ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF64, I>::convert( src[i] );
+  }
+
+  static void float32ToFloat64( void *out, const void *in, unsigned int samples )
+  {
+    const float *src = (const float *) in;
+    double *dst = (double *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m128 v = _mm_loadu_ps( src + i );
+      _mm_storeu_pd( dst + i, _mm_cvtps_pd( v ) );
+      _mm_storeu_pd( dst + i + 2, _mm_cvtps_pd( _mm_movehl_ps( v, v ) ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF32, RtF64>::convert( src[i] );
+  }
+
+  static void float64ToFloat32( void *out, const void *in, unsigned int samples )
+  {
+    const double *src = (const double *) in;
+    float *dst = (float *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m128 lo = _mm_cvtpd_ps( _mm_loadu_pd( src + i ) );
+      __m128 hi = _mm_cvtpd_ps( _mm_loadu_pd( src + i + 2 ) );
+      _mm_storeu_ps( dst + i, _mm_movelh_ps( lo, hi ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF64, RtF32>::convert( src[i] );
+  }
+
+  // Magnitudes are taken by clearing the sign bit.  The maximum keeps
+  // its second operand when the first is a NaN.
+  static unsigned int meterFloat32( const void *in, unsigned int samples, double *peak )
+  {
+    const float *src = (const float *) in;
+    __m128 sign = _mm_set1_ps( -0.0f ), one = _mm_set1_ps( 1.0f ), top = _mm_setzero_ps();
+    __m128i count = _mm_setzero_si128();
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m128 a = _mm_andnot_ps( sign, _mm_loadu_ps( src + i ) );
+      top = _mm_max_ps( a, top );
+      count = _mm_sub_epi32( count, _mm_castps_si128( _mm_cmpnle_ps( a, one ) ) );
+    }
+
+    float t[4];
+    int c[4];
+    _mm_storeu_ps( t, top );
+    _mm_storeu_si128( (__m128i *) c, count );
+    float most = t[0] > t[1] ? t[0] : t[1];
+    most = most > t[2] ? most : t[2];
+    most = most > t[3] ? most : t[3];
+    return rtMeterTail<RtF32>( src, i, samples, most, c[0] + c[1] + c[2] + c[3], peak );
+  }
+
+  static unsigned int meterFloat64( const void *in, unsigned int samples, double *peak )
+  {
+    const double *src = (const double *) in;
+    __m128d sign = _mm_set1_pd( -0.0 ), one = _mm_set1_pd( 1.0 ), top = _mm_setzero_pd();
+    __m128i count = _mm_setzero_si128();
+
+    unsigned int i = 0;
+    for ( ; i + 2 <= samples; i += 2 ) {
+      __m128d a = _mm_andnot_pd( sign, _mm_loadu_pd( src + i ) );
+      top = _mm_max_pd( a, top );
+      count = _mm_sub_epi64( count, _mm_castpd_si128( _mm_cmpnle_pd( a, one ) ) );
+    }
+
+    double t[2];
+    long long c[2];
+    _mm_storeu_pd( t, top );
+    _mm_storeu_si128( (__m128i *) c, count );
+    return rtMeterTail<RtF64>( src, i, samples, t[0] > t[1] ? t[0] : t[1], (unsigned int) ( c[0] + c[1] ), peak );
+  }
+
+  // SSE2 has no byte shuffle: swap 32-bit halves and 16-bit words
+  // with word shuffles, then the bytes of each word with shifts.
+  template <int BYTES> static inline __m128i swapVector( __m128i v )
+  {
+    if ( BYTES == 8 ) v = _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    if ( BYTES >= 4 )
+      v = _mm_shufflehi_epi16( _mm_shufflelo_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ), _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    return _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+  }
+
+  template <int BYTES> static void swapBytes( void *out, const void *in, unsigned int samples )
+  {
+    const char *src = (const char *) in;
+    char *dst = (char *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 16 / BYTES <= samples; i += 16 / BYTES )
+      _mm_storeu_si128( (__m128i *) ( dst + i * BYTES ),
+                        swapVector<BYTES>( _mm_loadu_si128( (const __m128i *) ( src + i * BYTES ) ) ) );
+    rtSwapScalar<BYTES>( dst + i * BYTES, src + i * BYTES, samples - i );
+  }
+
+  // Packed 24-bit samples, five (fifteen bytes) to a vector: the first
+  // and last byte of each trade places.  The sixteenth byte is written
+  // back unchanged, and is swapped with the sample it belongs to.
+  static void swapPacked( void *out, const void *in, unsigned int samples )
+  {
+    const char *src = (const char *) in;
+    char *dst = (char *) out;
+    __m128i first = _mm_setr_epi8( -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0 );
+    __m128i middle = _mm_setr_epi8( 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, -1 );
+    __m128i last = _mm_setr_epi8( 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0 );
+
+    unsigned int i = 0;
+    for ( ; i + 6 <= samples; i += 5 ) {
+      __m128i v = _mm_loadu_si128( (const __m128i *) ( src + i * 3 ) );
+      __m128i r = _mm_or_si128( _mm_and_si128( v, middle ),
+                                _mm_or_si128( _mm_and_si128( _mm_srli_si128( v, 2 ), first ),
+                                              _mm_and_si128( _mm_slli_si128( v, 2 ), last ) ) );
+      _mm_storeu_si128( (__m128i *) ( dst + i * 3 ), r );
+    }
+    rtSwapScalar<3>( dst + i * 3, src + i * 3, samples - i );
+  }
+};
+
+#endif
+
+// ****************************************************************** //
+//
+// AVX2
+//
+// ****************************************************************** //
+
+#if defined(CPU_AVX2)
+
+// Loads eight samples as 32-bit integers.
+template <class I> struct RtAvx2;
+
+template <> struct RtAvx2<RtS16> {
+  CPU_AVX2_TARGET static inline __m256i load( const signed short *p ) {
+    return _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *) p ) );
+  }
+};
+
+template <> struct RtAvx2<RtS24> {
+  CPU_AVX2_TARGET static inline __m256i load( const signed int *p ) {
+    return _mm256_and_si256( _mm256_loadu_si256( (const __m256i *) p ), _mm256_set1_epi32( 0x00ffffff ) );
+  }
+};
+
+template <> struct RtAvx2<RtS32> {
+  CPU_AVX2_TARGET static inline __m256i load( const signed int *p ) {
+    return _mm256_loadu_si256( (const __m256i *) p );
+  }
+};
+
+// Eight packed samples, spread over the two lanes with a byte shuffle.
+template <> struct RtAvx2<RtS24P> {
+  CPU_AVX2_TARGET static inline __m256i load( const RtInt24 *p ) {
+    __m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256( RtSse2<RtS24P>::load12( p ) ),
+                                         RtSse2<RtS24P>::load12( p + 4 ), 1 );
+    __m256i order = _mm256_setr_epi8( -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 );
+    return _mm256_srai_epi32( _mm256_shuffle_epi8( v, order ), 8 );
+  }
+};
+
+struct RtIsaAvx2 {
+
+  template <class I> CPU_AVX2_TARGET static void intToFloat32( void *out, const void *in, unsigned int samples )
+  {
+    const typename I::T *src = (const typename I::T *) in;
+    float *dst = (float *) out;
+    __m256 half = _mm256_set1_ps( 0.5f );
+    __m256 scale = _mm256_set1_ps( (float) ( 1.0 / I::half() ) );
+
+    unsigned int i = 0;
+    for ( ; i + 8 <= samples; i += 8 ) {
+      __m256 v = _mm256_cvtepi32_ps( RtAvx2<I>::load( src + i ) );
+      _mm256_storeu_ps( dst + i, _mm256_mul_ps( _mm256_add_ps( v, half ), scale ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<I, RtF32>::convert( src[i] );
+  }
+
+  template <class I> CPU_AVX2_TARGET static void intToFloat64( void *out, const void *in, unsigned int samples )
+  {
+    const typename I::T *src = (const typename I::T *) in;
+    double *dst = (double *) out;
+    __m256d half = _mm256_set1_pd( 0.5 );
+    __m256d scale = _mm256_set1_pd( 1.0 / I::half() );
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m256d v = _mm256_cvtepi32_pd( RtSse2<I>::load( src + i ) );
+      _mm256_storeu_pd( dst + i, _mm256_mul_pd( _mm256_add_pd( v, half ), scale ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<I, RtF64>::convert( src[i] );
+  }
+
+  template <class I> CPU_AVX2_TARGET static inline __m128i fromDouble( __m256d v )
+  {
+    __m256d mul = _mm256_set1_pd( I::half() );
+    v = _mm256_sub_pd( _mm256_mul_pd( v, mul ), _mm256_set1_pd( 0.5 ) );
+    v = _mm256_min_pd( _mm256_max_pd( v, _mm256_set1_pd( I::lowest() ) ), _mm256_set1_pd( I::highest() ) );
+    return _mm256_cvttpd_epi32( v );
+  }
+
+  template <class I> CPU_AVX2_TARGET static void float32ToInt( void *out, const void *in, unsigned int samples )
+  {
+    const float *src = (const float *) in;
+    typename I::T *dst = (typename I::T *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      RtSse2<I>::store( dst + i, fromDouble<I>( _mm256_cvtps_pd( _mm_loadu_ps( src + i ) ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF32, I>::convert( src[i] );
+  }
+
+  template <class I> CPU_AVX2_TARGET static void float64ToInt( void *out, const void *in, unsigned int samples )
+  {
+    const double *src = (const double *) in;
+    typename I::T *dst = (typename I::T *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      RtSse2<I>::store( dst + i, fromDouble<I>( _mm256_loadu_pd( src + i ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF64, I>::convert( src[i] );
+  }
+
+  CPU_AVX2_TARGET static void float32ToFloat64( void *out, const void *in, unsigned int samples )
+  {
+    const float *src = (const float *) in;
+    double *dst = (double *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      _mm256_storeu_pd( dst + i, _mm256_cvtps_pd( _mm_loadu_ps( src + i ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF32, RtF64>::convert( src[i] );
+  }
+
+  CPU_AVX2_TARGET static void float64ToFloat32( void *out, const void *in, unsigned int samples )
+  {
+    const double *src = (const double *) in;
+    float *dst = (float *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      _mm_storeu_ps( dst + i, _mm256_cvtpd_ps( _mm256_loadu_pd( src + i ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF64, RtF32>::convert( src[i] );
+  }
+
+  CPU_AVX2_TARGET static unsigned int meterFloat32( const void *in, unsigned int samples, double *peak )
+  {
+    const float *src = (const float *) in;
+    __m256 sign = _mm256_set1_ps( -0.0f ), one = _mm256_set1_ps( 1.0f ), top = _mm256_setzero_ps();
+    __m256i count = _mm256_setzero_si256();
+
+    unsigned int i = 0;
+    for ( ; i + 8 <= samples; i += 8 ) {
+      __m256 a = _mm256_andnot_ps( sign, _mm256_loadu_ps( src + i ) );
+      top = _mm256_max_ps( a, top );
+      count = _mm256_sub_epi32( count, _mm256_castps_si256( _mm256_cmp_ps( a, one, _CMP_NLE_UQ ) ) );
+    }
+
+    float t[8];
+    int c[8];
+    _mm256_storeu_ps( t, top );
+    _mm256_storeu_si256( (__m256i *) c, count );
+    float most = 0;
+    unsigned int clipped = 0;
+    for ( int k=0; k<8; k++ ) {
+      most = t[k] > most ? t[k] : most;
+      clipped += c[k];
+    }
+    return rtMeterTail<RtF32>( src, i, samples, most, clipped, peak );
+  }
+
+  CPU_AVX2_TARGET static unsigned int meterFloat64( const void *in, unsigned int samples, double *peak )
+  {
+    const double *src = (const double *) in;
+    __m256d sign = _mm256_set1_pd( -0.0 ), one = _mm256_set1_pd( 1.0 ), top = _mm256_setzero_pd();
+    __m256i count = _mm256_setzero_si256();
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      __m256d a = _mm256_andnot_pd( sign, _mm256_loadu_pd( src + i ) );
+      top = _mm256_max_pd( a, top );
+      count = _mm256_sub_epi64( count, _mm256_castpd_si256( _mm256_cmp_pd( a, one, _CMP_NLE_UQ ) ) );
+    }
+
+    double t[4];
+    long long c[4];
+    _mm256_storeu_pd( t, top );
+    _mm256_storeu_si256( (__m256i *) c, count );
+    double most = 0;
+    long long clipped = 0;
+    for ( int k=0; k<4; k++ ) {
+      most = t[k] > most ? t[k] : most;
+      clipped += c[k];
+    }
+    return rtMeterTail<RtF64>( src, i, samples, most, (unsigned int) clipped, peak );
+  }
+
+  template <int BYTES> CPU_AVX2_TARGET static void swapBytes( void *out, const void *in, unsigned int samples )
+  {
+    const char *src = (const char *) in;
+    char *dst = (char *) out;
+
+    // Byte k of a lane comes from the mirror position within its sample.
+    char order[32];
+    for ( int k=0; k<32; k++ ) order[k] = (char) ( k - k % BYTES + BYTES - 1 - k % BYTES );
+    __m256i mask = _mm256_loadu_si256( (const __m256i *) order );
+
+    unsigned int i = 0;
+    for ( ; i + 32 / BYTES <= samples; i += 32 / BYTES )
+      _mm256_storeu_si256( (__m256i *) ( dst + i * BYTES ),
+                           _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i *) ( src + i * BYTES ) ), mask ) );
+    rtSwapScalar<BYTES>( dst + i * BYTES, src + i * BYTES, samples - i );
+  }
+
+  // Packed 24-bit samples never line up with a lane, so each lane
+  // swaps the five samples at its start, as RtIsaSse2::swapPacked does.
+  CPU_AVX2_TARGET static void swapPacked( void *out, const void *in, unsigned int samples )
+  {
+    const char *src = (const char *) in;
+    char *dst = (char *) out;
+    __m256i mask = _mm256_setr_epi8( 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15,
+                                     2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15 );
+
+    unsigned int i = 0;
+    for ( ; i + 11 <= samples; i += 10 ) {
+      __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i *) ( src + i * 3 ) ) ),
+        _mm_loadu_si128( (const __m128i *) ( src + i * 3 + 15 ) ), 1 );
+      v = _mm256_shuffle_epi8( v, mask );
+      _mm_storeu_si128( (__m128i *) ( dst + i * 3 ), _mm256_castsi256_si128( v ) );
+      _mm_storeu_si128( (__m128i *) ( dst + i * 3 + 15 ), _mm256_extracti128_si256( v, 1 ) );
+    }
+    rtSwapScalar<3>( dst + i * 3, src + i * 3, samples - i );
+  }
+};
+
+#endif
+
+// ****************************************************************** //
+//
+// Advanced SIMD (AArch64)
+//
+// ****************************************************************** //
+
+#if defined(CPU_NEON)
+
+// Loads four samples as 32-bit integers, and stores four back.
+template <class I> struct RtNeon;
+
+template <> struct RtNeon<RtS16> {
+  static inline int32x4_t load( const signed short *p ) { return vmovl_s16( vld1_s16( p ) ); }
+  static inline void store( signed short *p, int32x4_t v ) { vst1_s16( p, vqmovn_s32( v ) ); }
+};
+
+template <> struct RtNeon<RtS24> {
+  static inline int32x4_t load( const signed int *p ) {
+    return vandq_s32( vld1q_s32( p ), vdupq_n_s32( 0x00ffffff ) );
+  }
+  static inline void store( signed int *p, int32x4_t v ) { vst1q_s32( p, v ); }
+};
+
+template <> struct RtNeon<RtS32> {
+  static inline int32x4_t load( const signed int *p ) { return vld1q_s32( p ); }
+  static inline void store( signed int *p, int32x4_t v ) { vst1q_s32( p, v ); }
+};
+
+// Four packed samples (twelve bytes, moved as eight plus four),
+// spread to the top of each lane with a table lookup.
+template <> struct RtNeon<RtS24P> {
+  static inline int32x4_t load( const RtInt24 *p ) {
+    static const uint8_t order[16] = { 255, 0, 1, 2, 255, 3, 4, 5, 255, 6, 7, 8, 255, 9, 10, 11 };
+    uint32_t tail;
+    memcpy( &tail, (const char *) p + 8, 4 );
+    uint8x16_t v = vcombine_u8( vld1_u8( (const uint8_t *) p ), vreinterpret_u8_u32( vdup_n_u32( tail ) ) );
+    return vshrq_n_s32( vreinterpretq_s32_u8( vqtbl1q_u8( v, vld1q_u8( order ) ) ), 8 );
+  }
+  static inline void store( RtInt24 *p, int32x4_t v ) {
+    static const uint8_t order[16] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 255, 255, 255, 255 };
+    uint8x16_t r = vqtbl1q_u8( vreinterpretq_u8_s32( v ), vld1q_u8( order ) );
+    uint32_t tail = vgetq_lane_u32( vreinterpretq_u32_u8( r ), 2 );
+    vst1_u8( (uint8_t *) p, vget_low_u8( r ) );
+    memcpy( (char *) p + 8, &tail, 4 );
+  }
+};
+
+struct RtIsaNeon {
+
+  template <class I> static void intToFloat32( void *out, const void *in, unsigned int samples )
+  {
+    const typename I::T *src = (const typename I::T *) in;
+    float *dst = (float *) out;
+    float32x4_t half = vdupq_n_f32( 0.5f );
+    float32x4_t scale = vdupq_n_f32( (float) ( 1.0 / I::half() ) );
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      float32x4_t v = vcvtq_f32_s32( RtNeon<I>::load( src + i ) );
+      vst1q_f32( dst + i, vmulq_f32( vaddq_f32( v, half ), scale ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<I, RtF32>::convert( src[i] );
+  }
+
+  template <class I> static void intToFloat64( void *out, const void *in, unsigned int samples )
+  {
+    const typename I::T *src = (const typename I::T *) in;
+    double *dst = (double *) out;
+    float64x2_t half = vdupq_n_f64( 0.5 );
+    float64x2_t scale = vdupq_n_f64( 1.0 / I::half() );
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      int32x4_t v = RtNeon<I>::load( src + i );
+      float64x2_t lo = vcvtq_f64_s64( vmovl_s32( vget_low_s32( v ) ) );
+      float64x2_t hi = vcvtq_f64_s64( vmovl_high_s32( v ) );
+      vst1q_f64( dst + i, vmulq_f64( vaddq_f64( lo, half ), scale ) );
+      vst1q_f64( dst + i + 2, vmulq_f64( vaddq_f64( hi, half ), scale ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<I, RtF64>::convert( src[i] );
+  }
+
+  template <class I> static inline int32x4_t fromDouble( float64x2_t lo, float64x2_t hi )
+  {
+    float64x2_t mul = vdupq_n_f64( I::half() );
+    float64x2_t half = vdupq_n_f64( 0.5 );
+    float64x2_t low = vdupq_n_f64( I::lowest() );
+    float64x2_t high = vdupq_n_f64( I::highest() );
+
+    // The "number" forms of min and max drop a NaN, as the x86 forms do.
+    lo = vminnmq_f64( vmaxnmq_f64( vsubq_f64( vmulq_f64( lo, mul ), half ), low ), high );
+    hi = vminnmq_f64( vmaxnmq_f64( vsubq_f64( vmulq_f64( hi, mul ), half ), low ), high );
+    return vcombine_s32( vmovn_s64( vcvtq_s64_f64( lo ) ), vmovn_s64( vcvtq_s64_f64( hi ) ) );
+  }
+
+  template <class I> static void float32ToInt( void *out, const void *in, unsigned int samples )
+  {
+    const float *src = (const float *) in;
+    typename I::T *dst = (typename I::T *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      float32x4_t v = vld1q_f32( src + i );
+      RtNeon<I>::store( dst + i, fromDouble<I>( vcvt_f64_f32( vget_low_f32( v ) ), vcvt_high_f64_f32( v ) ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF32, I>::convert( src[i] );
+  }
+
+  template <class I> static void float64ToInt( void *out, const void *in, unsigned int samples )
+  {
+    const double *src = (const double *) in;
+    typename I::T *dst = (typename I::T *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      RtNeon<I>::store( dst + i, fromDouble<I>( vld1q_f64( src + i ), vld1q_f64( src + i + 2 ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF64, I>::convert( src[i] );
+  }
+
+  static void float32ToFloat64( void *out, const void *in, unsigned int samples )
+  {
+    const float *src = (const float *) in;
+    double *dst = (double *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      float32x4_t v = vld1q_f32( src + i );
+      vst1q_f64( dst + i, vcvt_f64_f32( vget_low_f32( v ) ) );
+      vst1q_f64( dst + i + 2, vcvt_high_f64_f32( v ) );
+    }
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF32, RtF64>::convert( src[i] );
+  }
+
+  static void float64ToFloat32( void *out, const void *in, unsigned int samples )
+  {
+    const double *src = (const double *) in;
+    float *dst = (float *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 )
+      vst1q_f32( dst + i, vcvt_high_f32_f64( vcvt_f32_f64( vld1q_f64( src + i ) ), vld1q_f64( src + i + 2 ) ) );
+    for ( ; i < samples; i++ ) dst[i] = RtSample<RtF64, RtF32>::convert( src[i] );
+  }
+
+  // The "number" form of max drops a NaN, as the x86 form does here.
+  static unsigned int meterFloat32( const void *in, unsigned int samples, double *peak )
+  {
+    const float *src = (const float *) in;
+    float32x4_t one = vdupq_n_f32( 1.0f ), top = vdupq_n_f32( 0.0f );
+    uint32x4_t count = vdupq_n_u32( 0 );
+
+    unsigned int i = 0;
+    for ( ; i + 4 <= samples; i += 4 ) {
+      float32x4_t a = vabsq_f32( vld1q_f32( src + i ) );
+      top = vmaxnmq_f32( a, top );
+      count = vsubq_u32( count, vmvnq_u32( vcleq_f32( a, one ) ) );
+    }
+    return rtMeterTail<RtF32>( src, i, samples, vmaxnmvq_f32( top ), vaddvq_u32( count ), peak );
+  }
+
+  static unsigned int meterFloat64( const void *in, unsigned int samples, double *peak )
+  {
+    const double *src = (const double *) in;
+    float64x2_t one = vdupq_n_f64( 1.0 ), top = vdupq_n_f64( 0.0 );
+    uint64x2_t count = vdupq_n_u64( 0 );
+
+    unsigned int i = 0;
+    for ( ; i + 2 <= samples; i += 2 ) {
+      float64x2_t a = vabsq_f64( vld1q_f64( src + i ) );
+      top = vmaxnmq_f64( a, top );
+      count = vsubq_u64( count, veorq_u64( vcleq_f64( a, one ), vdupq_n_u64( ~0ULL ) ) );
+    }
+    return rtMeterTail<RtF64>( src, i, samples, vmaxnmvq_f64( top ), (unsigned int) vaddvq_u64( count ), peak );
+  }
+
+  template <int BYTES> static void swapBytes( void *out, const void *in, unsigned int samples )
+  {
+    const uint8_t *src = (const uint8_t *) in;
+    uint8_t *dst = (uint8_t *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 16 / BYTES <= samples; i += 16 / BYTES ) {
+      uint8x16_t v = vld1q_u8( src + i * BYTES );
+      if ( BYTES == 2 ) v = vrev16q_u8( v );
+      else if ( BYTES == 4 ) v = vrev32q_u8( v );
+      else v = vrev64q_u8( v );
+      vst1q_u8( dst + i * BYTES, v );
+    }
+    rtSwapScalar<BYTES>( dst + i * BYTES, src + i * BYTES, samples - i );
+  }
+
+  // Packed 24-bit samples, sixteen at a time: a three-way
+  // deinterleaving load puts each byte position in its own register.
+  static void swapPacked( void *out, const void *in, unsigned int samples )
+  {
+    const uint8_t *src = (const uint8_t *) in;
+    uint8_t *dst = (uint8_t *) out;
+
+    unsigned int i = 0;
+    for ( ; i + 16 <= samples; i += 16 ) {
+      uint8x16x3_t v = vld3q_u8( src + i * 3 );
+      uint8x16_t t = v.val[0];
+      v.val[0] = v.val[2];
+      v.val[2] = t;
+      vst3q_u8( dst + i * 3, v );
+    }
+    rtSwapScalar<3>( dst + i * 3, src + i * 3, samples - i );
+  }
+};
+
+#endif
+
+// ****************************************************************** //
+//
+// Transposes between interleaved frames and per-channel blocks
+//
+// Samples are moved as raw bits, so one transpose serves every format
+// of the same size.  A frame holds its channels one sample apart and
+// frames are "pitch" samples apart; a block holds one channel's
+// samples one sample apart and blocks are "stride" samples apart.
+//
+// ****************************************************************** //
+
+// Samples per transposed tile, so that a tile stays in the L1 cache.
+static const int RT_TILE_SAMPLES = 2048;
+
+// Transposes a 4 x 4 block: dst[c * dstPitch + r] = src[r * srcPitch + c].
+template <class E> struct RtBlock {
+  static inline void transpose( E *dst, int dstPitch, const E *src, int srcPitch ) {
+    for ( int r=0; r<4; r++ )
+      for ( int c=0; c<4; c++ ) dst[c * dstPitch + r] = src[r * srcPitch + c];
+  }
+};
+
+#if defined(CPU_SSE2)
+
+template <> struct RtBlock<unsigned short> {
+  static inline void transpose( unsigned short *dst, int dstPitch, const unsigned short *src, int srcPitch ) {
+    __m128i ab = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *) src ),
+                                     _mm_loadl_epi64( (const __m128i *) ( src + srcPitch ) ) );
+    __m128i cd = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *) ( src + 2 * srcPitch ) ),
+                                     _mm_loadl_epi64( (const __m128i *) ( src + 3 * srcPitch ) ) );
+    __m128i lo = _mm_unpacklo_epi32( ab, cd );
+    __m128i hi = _mm_unpackhi_epi32( ab, cd );
+    _mm_storel_epi64( (__m128i *) dst, lo );
+    _mm_storel_epi64( (__m128i *) ( dst + dstPitch ), _mm_unpackhi_epi64( lo, lo ) );
+    _mm_storel_epi64( (__m128i *) ( dst + 2 * dstPitch ), hi );
+    _mm_storel_epi64( (__m128i *) ( dst + 3 * dstPitch ), _mm_unpackhi_epi64( hi, hi ) );
+  }
+};
+
+template <> struct RtBlock<unsigned int> {
+  static inline void transpose( unsigned int *dst, int dstPitch, const unsigned int *src, int srcPitch ) {
+    __m128 r0 = _mm_loadu_ps( (const float *) src );
+    __m128 r1 = _mm_loadu_ps( (const float *) ( src + srcPitch ) );
+    __m128 r2 = _mm_loadu_ps( (const float *) ( src + 2 * srcPitch ) );
+    __m128 r3 = _mm_loadu_ps( (const float *) ( src + 3 * srcPitch ) );
+    _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+    _mm_storeu_ps( (float *) dst, r0 );
+    _mm_storeu_ps( (float *) ( dst + dstPitch ), r1 );
+    _mm_storeu_ps( (float *) ( dst + 2 * dstPitch ), r2 );
+    _mm_storeu_ps( (float *) ( dst + 3 * dstPitch ), r3 );
+  }
+};
+
+template <> struct RtBlock<unsigned long long> {
+  static inline void transpose2( unsigned long long *dst, int dstPitch, const unsigned long long *src, int srcPitch ) {
+    __m128d a = _mm_loadu_pd( (const double *) src );
+    __m128d b = _mm_loadu_pd( (const double *) ( src + srcPitch ) );
+    _mm_storeu_pd( (double *) dst, _mm_unpacklo_pd( a, b ) );
+    _mm_storeu_pd( (double *) ( dst + dstPitch ), _mm_unpackhi_pd( a, b ) );
+  }
+  static inline void transpose( unsigned long long *dst, int dstPitch, const unsigned long long *src, int srcPitch ) {
+    transpose2( dst, dstPitch, src, srcPitch );
+    transpose2( dst + 2 * dstPitch, dstPitch, src + 2, srcPitch );
+    transpose2( dst + 2, dstPitch, src + 2 * srcPitch, srcPitch );
+    transpose2( dst + 2 * dstPitch + 2, dstPitch, src + 2 * srcPitch + 2, srcPitch );
+  }
+};
+
+#endif
+
+// Interleaved frames to blocks, and back, four frames by four
+// channels at a time.  CHANNELS is 0 for channel counts known only at
+// run time.  Two channels are split and merged with shuffles when
+// their frames are packed.
+template <class E, int CHANNELS> struct RtInterleave {
+  static inline void split( E *blocks, int stride, const E *frames, int pitch, int channels, unsigned int count ) {
+    const int cols = CHANNELS ? CHANNELS : channels;
+    const int cols4 = cols & ~3;
+    unsigned int r = 0;
+    for ( ; r + 4 <= count; r += 4 ) {
+      for ( int c=0; c<cols4; c+=4 )
+        RtBlock<E>::transpose( blocks + c * stride + r, stride, frames + r * pitch + c, pitch );
+    }
+    for ( int c=cols4; c<cols; c++ )
+      for ( unsigned int i=0; i<r; i++ ) blocks[c * stride + i] = frames[i * pitch + c];
+    for ( ; r<count; r++ )
+      for ( int c=0; c<cols; c++ ) blocks[c * stride + r] = frames[r * pitch + c];
+  }
+  static inline void merge( E *frames, int pitch, const E *blocks, int stride, int channels, unsigned int count ) {
+    const int cols = CHANNELS ? CHANNELS : channels;
+    const int cols4 = cols & ~3;
+    unsigned int r = 0;
+    for ( ; r + 4 <= count; r += 4 ) {
+      for ( int c=0; c<cols4; c+=4 )
+        RtBlock<E>::transpose( frames + r * pitch + c, pitch, blocks + c * stride + r, stride );
+    }
+    for ( int c=cols4; c<cols; c++ )
+      for ( unsigned int i=0; i<r; i++ ) frames[i * pitch + c] = blocks[c * stride + i];
+    for ( ; r<count; r++ )
+      for ( int c=0; c<cols; c++ ) frames[r * pitch + c] = blocks[c * stride + r];
+  }
+};
+
+template <class E> struct RtInterleave<E, 2> {
+  static inline void split( E *blocks, int stride, const E *frames, int pitch, int, unsigned int count ) {
+    E *left = blocks, *right = blocks + stride;
+    for ( unsigned int i=0; i<count; i++ ) {
+      left[i] = frames[i * pitch];
+      right[i] = frames[i * pitch + 1];
+    }
+  }
+  static inline void merge( E *frames, int pitch, const E *blocks, int stride, int, unsigned int count ) {
+    const E *left = blocks, *right = blocks + stride;
+    for ( unsigned int i=0; i<count; i++ ) {
+      frames[i * pitch] = left[i];
+      frames[i * pitch + 1] = right[i];
+    }
+  }
+};
+
+#if defined(CPU_SSE2)
+
+template <> struct RtInterleave<unsigned short, 2> {
+  typedef unsigned short E;
+  static inline void split( E *blocks, int stride, const E *frames, int pitch, int, unsigned int count ) {
+    E *left = blocks, *right = blocks + stride;
+    unsigned int i = 0;
+    if ( pitch == 2 ) {
+      for ( ; i + 8 <= count; i += 8 ) {
+        __m128i a = _mm_loadu_si128( (const __m128i *) ( frames + 2 * i ) );
+        __m128i b = _mm_loadu_si128( (const __m128i *) ( frames + 2 * i + 8 ) );
+        __m128i l = _mm_packs_epi32( _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 ),
+                                     _mm_srai_epi32( _mm_slli_epi32( b, 16 ), 16 ) );
+        __m128i r = _mm_packs_epi32( _mm_srai_epi32( a, 16 ), _mm_srai_epi32( b, 16 ) );
+        _mm_storeu_si128( (__m128i *) ( left + i ), l );
+        _mm_storeu_si128( (__m128i *) ( right + i ), r );
+      }
+    }
+    for ( ; i<count; i++ ) {
+      left[i] = frames[i * pitch];
+      right[i] = frames[i * pitch + 1];
+    }
+  }
+  static inline void merge( E *frames, int pitch, const E *blocks, int stride, int, unsigned int count ) {
+    const E *left = blocks, *right = blocks + stride;
+    unsigned int i = 0;
+    if ( pitch == 2 ) {
+      for ( ; i + 8 <= count; i += 8 ) {
+        __m128i l = _mm_loadu_si128( (const __m128i *) ( left + i ) );
+        __m128i r = _mm_loadu_si128( (const __m128i *) ( right + i ) );
+        _mm_storeu_si128( (__m128i *) ( frames + 2 * i ), _mm_unpacklo_epi16( l, r ) );
+        _mm_storeu_si128( (__m128i *) ( frames + 2 * i + 8 ), _mm_unpackhi_epi16( l, r ) );
+      }
+    }
+    for ( ; i<count; i++ ) {
+      frames[i * pitch] = left[i];
+      frames[i * pitch + 1] = right[i];
+    }
+  }
+};
+
+template <> struct RtInterleave<unsigned int, 2> {
+  typedef unsigned int E;
+  static inline void split( E *blocks, int stride, const E *frames, int pitch, int, unsigned int count ) {
+    E *left = blocks, *right = blocks + stride;
+    unsigned int i = 0;
+    if ( pitch == 2 ) {
+      for ( ; i + 4 <= count; i += 4 ) {
+        __m128 a = _mm_loadu_ps( (const float *) ( frames + 2 * i ) );
+        __m128 b = _mm_loadu_ps( (const float *) ( frames + 2 * i + 4 ) );
+        _mm_storeu_ps( (float *) ( left + i ), _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+        _mm_storeu_ps( (float *) ( right + i ), _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+      }
+    }
+    for ( ; i<count; i++ ) {
+      left[i] = frames[i * pitch];
+      right[i] = frames[i * pitch + 1];
+    }
+  }
+  static inline void merge( E *frames, int pitch, const E *blocks, int stride, int, unsigned int count ) {
+    const E *left = blocks, *right = blocks + stride;
+    unsigned int i = 0;
+    if ( pitch == 2 ) {
+      for ( ; i + 4 <= count; i += 4 ) {
+        __m128 l = _mm_loadu_ps( (const float *) ( left + i ) );
+        __m128 r = _mm_loadu_ps( (const float *) ( right + i ) );
+        _mm_storeu_ps( (float *) ( frames + 2 * i ), _mm_unpacklo_ps( l, r ) );
+        _mm_storeu_ps( (float *) ( frames + 2 * i + 4 ), _mm_unpackhi_ps( l, r ) );
+      }
+    }
+    for ( ; i<count; i++ ) {
+      frames[i * pitch] = left[i];
+      frames[i * pitch + 1] = right[i];
+    }
+  }
+};
+
+template <> struct RtInterleave<unsigned long long, 2> {
+  typedef unsigned long long E;
+  static inline void split( E *blocks, int stride, const E *frames, int pitch, int, unsigned int count ) {
+    unsigned int i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+      RtBlock<E>::transpose2( blocks + i, stride, frames + i * pitch, pitch );
+    for ( ; i<count; i++ ) {
+      blocks[i] = frames[i * pitch];
+      blocks[stride + i] = frames[i * pitch + 1];
+    }
+  }
+  static inline void merge( E *frames, int pitch, const E *blocks, int stride, int, unsigned int count ) {
+    unsigned int i = 0;
+    for ( ; i + 2 <= count; i += 2 )
+      RtBlock<E>::transpose2( frames + i * pitch, pitch, blocks + i, stride );
+    for ( ; i<count; i++ ) {
+      frames[i * pitch] = blocks[i];
+      frames[i * pitch + 1] = blocks[stride + i];
+    }
+  }
+};
+
+#endif
+
+// ****************************************************************** //
+//
+// Kernel selection
+//
+// ****************************************************************** //
+
+// Contiguous runs of a format pair without a vector kernel.
+template <class In, class Out> static void rtScalar( void *out, const void *in, unsigned int samples )
+{
+  const typename In::T *src = (const typename In::T *) in;
+  typename Out::T *dst = (typename Out::T *) out;
+  for ( unsigned int i=0; i<samples; i++ ) dst[i] = RtSample<In, Out>::convert( src[i] );
+}
+
+template <class Isa> static RtConvertKernel rtPickKernel( RtAudioFormat inFormat, RtAudioFormat outFormat )
+{
+#if !defined(RT_BIG_ENDIAN)
+  // The packed 24-bit loads and stores expect little-endian lanes.
+  if ( outFormat == RTAUDIO_FLOAT32 && inFormat == RTAUDIO_SINT24_PACKED ) return &Isa::template intToFloat32<RtS24P>;
+  if ( outFormat == RTAUDIO_FLOAT64 && inFormat == RTAUDIO_SINT24_PACKED ) return &Isa::template intToFloat64<RtS24P>;
+  if ( inFormat == RTAUDIO_FLOAT32 && outFormat == RTAUDIO_SINT24_PACKED ) return &Isa::template float32ToInt<RtS24P>;
+  if ( inFormat == RTAUDIO_FLOAT64 && outFormat == RTAUDIO_SINT24_PACKED ) return &Isa::template float64ToInt<RtS24P>;
+#endif
+
+  if ( outFormat == RTAUDIO_FLOAT32 ) {
+    if ( inFormat == RTAUDIO_SINT16 ) return &Isa::template intToFloat32<RtS16>;
+    if ( inFormat == RTAUDIO_SINT24 ) return &Isa::template intToFloat32<RtS24>;
+    if ( inFormat == RTAUDIO_SINT32 ) return &Isa::template intToFloat32<RtS32>;
+    if ( inFormat == RTAUDIO_FLOAT64 ) return &Isa::float64ToFloat32;
+  }
+  else if ( outFormat == RTAUDIO_FLOAT64 ) {
+    if ( inFormat == RTAUDIO_SINT16 ) return &Isa::template intToFloat64<RtS16>;
+    if ( inFormat == RTAUDIO_SINT24 ) return &Isa::template intToFloat64<RtS24>;
+    if ( inFormat == RTAUDIO_SINT32 ) return &Isa::template intToFloat64<RtS32>;
+    if ( inFormat == RTAUDIO_FLOAT32 ) return &Isa::float32ToFloat64;
+  }
+  else if ( inFormat == RTAUDIO_FLOAT32 ) {
+    if ( outFormat == RTAUDIO_SINT16 ) return &Isa::template float32ToInt<RtS16>;
+    if ( outFormat == RTAUDIO_SINT24 ) return &Isa::template float32ToInt<RtS24>;
+    if ( outFormat == RTAUDIO_SINT32 ) return &Isa::template float32ToInt<RtS32>;
+  }
+  else if ( inFormat == RTAUDIO_FLOAT64 ) {
+    if ( outFormat == RTAUDIO_SINT16 ) return &Isa::template float64ToInt<RtS16>;
+    if ( outFormat == RTAUDIO_SINT24 ) return &Isa::template float64ToInt<RtS24>;
+    if ( outFormat == RTAUDIO_SINT32 ) return &Isa::template float64ToInt<RtS32>;
+  }
+  return NULL;
+}
+
+RtConvertKernel rtConvertKernel( RtAudioFormat inFormat, RtAudioFormat outFormat )
+{
+  if ( inFormat == outFormat ) {
+    if ( inFormat == RTAUDIO_SINT8 ) return &rtCopy<1>;
+    if ( inFormat == RTAUDIO_SINT16 ) return &rtCopy<2>;
+    if ( inFormat == RTAUDIO_SINT24_PACKED ) return &rtCopy<3>;
+    if ( inFormat == RTAUDIO_FLOAT64 ) return &rtCopy<8>;
+    return &rtCopy<4>;
+  }
+
+#if defined(CPU_AVX2)
+  if ( cpu_has_avx2() ) return rtPickKernel<RtIsaAvx2>( inFormat, outFormat );
+#endif
+#if defined(CPU_SSE2)
+  return rtPickKernel<RtIsaSse2>( inFormat, outFormat );
+#elif defined(CPU_NEON)
+  return rtPickKernel<RtIsaNeon>( inFormat, outFormat );
+#else
+  return NULL;
+#endif
+}
+
+const char *rtConvertIsa( void )
+{
+#if defined(CPU_AVX2)
+  if ( cpu_has_avx2() ) return "avx2";
+#endif
+#if defined(CPU_SSE2)
+  return "sse2";
+#elif defined(CPU_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+template <class Isa> static RtConvertKernel rtPickSwap( unsigned int bytes )
+{
+  if ( bytes == 2 ) return &Isa::template swapBytes<2>;
+  if ( bytes == 3 ) return &Isa::swapPacked;
+  if ( bytes == 4 ) return &Isa::template swapBytes<4>;
+  return &Isa::template swapBytes<8>;
+}
+
+RtConvertKernel rtSwapKernel( RtAudioFormat format )
+{
+  unsigned int bytes = 0;
+  if ( format == RTAUDIO_SINT16 ) bytes = 2;
+  else if ( format == RTAUDIO_SINT24_PACKED ) bytes = 3;
+  else if ( format == RTAUDIO_SINT24 || format == RTAUDIO_SINT32 || format == RTAUDIO_FLOAT32 ) bytes = 4;
+  else if ( format == RTAUDIO_FLOAT64 ) bytes = 8;
+  else return NULL;
+
+#if defined(CPU_AVX2)
+  if ( cpu_has_avx2() ) return rtPickSwap<RtIsaAvx2>( bytes );
+#endif
+#if defined(CPU_SSE2)
+  return rtPickSwap<RtIsaSse2>( bytes );
+#elif defined(CPU_NEON)
+  return rtPickSwap<RtIsaNeon>( bytes );
+#else
+  if ( bytes == 2 ) return &rtSwapScalar<2>;
+  if ( bytes == 3 ) return &rtSwapScalar<3>;
+  if ( bytes == 4 ) return &rtSwapScalar<4>;
+  return &rtSwapScalar<8>;
+#endif
+}
+
+template <class Isa> static RtMeterKernel rtPickMeter( RtAudioFormat format )
+{
+  if ( format == RTAUDIO_FLOAT32 ) return &Isa::meterFloat32;
+  return &Isa::meterFloat64;
+}
+
+RtMeterKernel rtMeterKernel( RtAudioFormat format )
+{
+  if ( format != RTAUDIO_FLOAT32 && format != RTAUDIO_FLOAT64 ) return NULL;
+
+#if defined(CPU_AVX2)
+  if ( cpu_has_avx2() ) return rtPickMeter<RtIsaAvx2>( format );
+#endif
+#if defined(CPU_SSE2)
+  return rtPickMeter<RtIsaSse2>( format );
+#elif defined(CPU_NEON)
+  return rtPickMeter<RtIsaNeon>( format );
+#else
+  if ( format == RTAUDIO_FLOAT32 ) return &rtMeterScalar<RtF32>;
+  return &rtMeterScalar<RtF64>;
+#endif
+}
+
+// ****************************************************************** //
+//
+// Conversion plans
+//
+// ****************************************************************** //
+
+static const char *rtFormatName( RtAudioFormat format )
+{
+  if ( format == RTAUDIO_SINT8 ) return "sint8";
+  if ( format == RTAUDIO_SINT16 ) return "sint16";
+  if ( format == RTAUDIO_SINT24 ) return "sint24";
+  if ( format == RTAUDIO_SINT24_PACKED ) return "sint24 packed";
+  if ( format == RTAUDIO_SINT32 ) return "sint32";
+  if ( format == RTAUDIO_FLOAT32 ) return "float32";
+  return "float64";
+}
+
+// Nothing to convert.
+static void rtRunNone( const RtConvertPlan &, char *, const char *, unsigned int )
+{
+}
+
+// Every channel in its own contiguous block on both sides.
+static void rtRunBlocks( const RtConvertPlan &plan, char *outBuffer, const char *inBuffer, unsigned int frames )
+{
+  const char *in = inBuffer + plan.inBase * plan.inBytes;
+  char *out = outBuffer + plan.outBase * plan.outBytes;
+  int inStride = plan.inStride * plan.inBytes;
+  int outStride = plan.outStride * plan.outBytes;
+
+  for ( int j=0; j<plan.channels; j++ )
+    plan.kernel( out + j * outStride, in + j * inStride, frames );
+}
+
+// Interleaved frames holding the same channels on both sides: one run.
+static void rtRunFrames( const RtConvertPlan &plan, char *outBuffer, const char *inBuffer, unsigned int frames )
+{
+  plan.kernel( outBuffer + plan.outBase * plan.outBytes, inBuffer + plan.inBase * plan.inBytes,
+               frames * plan.channels );
+}
+
+// Anything else, one frame at a time.  CHANNELS is 0 for channel
+// counts read from the plan.
+template <class In, class Out, int CHANNELS>
+static void rtRunStrided( const RtConvertPlan &plan, char *outBuffer, const char *inBuffer, unsigned int frames )
+{
+  const typename In::T *in = (const typename In::T *) inBuffer + plan.inBase;
+  typename Out::T *out = (typename Out::T *) outBuffer + plan.outBase;
+  const int channels = CHANNELS ? CHANNELS : plan.channels;
+  const int inStride = plan.inStride, inJump = plan.inJump;
+  const int outStride = plan.outStride, outJump = plan.outJump;
+
+  for ( unsigned int i=0; i<frames; i++ ) {
+    for ( int j=0; j<channels; j++ )
+      out[j * outStride] = RtSample<In, Out>::convert( in[j * inStride] );
+    in += inJump;
+    out += outJump;
+  }
+}
+
+// Interleaved frames to per-channel blocks.  When the formats differ,
+// a tile of frames is split into a local buffer and each channel of
+// it converted by the plan's kernel.  E holds an input sample.
+template <class E, int CHANNELS, bool CONVERT>
+static void rtRunSplit( const RtConvertPlan &plan, char *outBuffer, const char *inBuffer, unsigned int frames )
+{
+  const int channels = CHANNELS ? CHANNELS : plan.channels;
+  const E *in = (const E *) inBuffer + plan.inBase;
+  if ( !CONVERT ) {
+    RtInterleave<E, CHANNELS>::split( (E *) outBuffer + plan.outBase, plan.outStride, in, plan.inJump,
+                                      channels, frames );
+    return;
+  }
+
+  E tile[RT_TILE_SAMPLES];
+  char *out = outBuffer + plan.outBase * plan.outBytes;
+  const unsigned int step = ( RT_TILE_SAMPLES / channels ) & ~3;
+  for ( unsigned int f=0; f<frames; f+=step ) {
+    unsigned int n = ( frames - f < step ) ? frames - f : step;
+    RtInterleave<E, CHANNELS>::split( tile, n, in + f * plan.inJump, plan.inJump, channels, n );
+    for ( int j=0; j<channels; j++ )
+      plan.kernel( out + ( j * plan.outStride + f ) * plan.outBytes, tile + j * n, n );
+  }
+}
+
+// Per-channel blocks to interleaved frames, converting each channel
+// of a tile into a local buffer first.  E holds an output sample.
+template <class E, int CHANNELS, bool CONVERT>
+static void rtRunMerge( const RtConvertPlan &plan, char *outBuffer, const char *inBuffer, unsigned int frames )
+{
+  const int channels = CHANNELS ? CHANNELS : plan.channels;
+  E *out = (E *) outBuffer + plan.outBase;
+  if ( !CONVERT ) {
+    RtInterleave<E, CHANNELS>::merge( out, plan.outJump, (const E *) inBuffer + plan.inBase, plan.inStride,
+                                      channels, frames );
+    return;
+  }
+
+  E tile[RT_TILE_SAMPLES];
+  const char *in = inBuffer + plan.inBase * plan.inBytes;
+  const unsigned int step = ( RT_TILE_SAMPLES / channels ) & ~3;
+  for ( unsigned int f=0; f<frames; f+=step ) {
+    unsigned int n = ( frames - f < step ) ? frames - f : step;
+    for ( int j=0; j<channels; j++ )
+      plan.kernel( tile + j * n, in + ( j * plan.inStride + f ) * plan.inBytes, n );
+    RtInterleave<E, CHANNELS>::merge( out + f * plan.outJump, plan.outJump, tile, n, channels, n );
+  }
+}
+
+template <class E, bool CONVERT> static RtConvertFunction rtPickSplit( int channels )
+{
+  if ( channels == 2 ) return &rtRunSplit<E, 2, CONVERT>;
+  if ( channels == 4 ) return &rtRunSplit<E, 4, CONVERT>;
+  if ( channels == 8 ) return &rtRunSplit<E, 8, CONVERT>;
+  if ( channels == 16 ) return &rtRunSplit<E, 16, CONVERT>;
+  if ( channels == 32 ) return &rtRunSplit<E, 32, CONVERT>;
+  return &rtRunSplit<E, 0, CONVERT>;
+}
+
+template <class E, bool CONVERT> static RtConvertFunction rtPickMerge( int channels )
+{
+  if ( channels == 2 ) return &rtRunMerge<E, 2, CONVERT>;
+  if ( channels == 4 ) return &rtRunMerge<E, 4, CONVERT>;
+  if ( channels == 8 ) return &rtRunMerge<E, 8, CONVERT>;
+  if ( channels == 16 ) return &rtRunMerge<E, 16, CONVERT>;
+  if ( channels == 32 ) return &rtRunMerge<E, 32, CONVERT>;
+  return &rtRunMerge<E, 0, CONVERT>;
+}
+
+// Swaps the device samples of frames first .. first + frames - 1.
+static void rtSwapFrames( const RtConvertPlan &plan, char *buffer, unsigned int first, unsigned int frames )
+{
+  int bytes = plan.swapInput ? plan.inBytes : plan.outBytes;
+  if ( plan.swapPitch == 1 ) {
+    for ( int j=0; j<plan.swapChannels; j++ ) {
+      char *block = buffer + ( j * plan.swapStride + first ) * bytes;
+      plan.swap( block, block, frames );
+    }
+  }
+  else {
+    char *run = buffer + first * plan.swapPitch * bytes;
+    plan.swap( run, run, frames * plan.swapPitch );
+  }
+}
+
+// Byte swaps the device samples a chunk of frames at a time, while the
+// chunk the conversion reads or writes is still in the cache.  Input
+// samples are swapped in place, as RtApi::byteSwapBuffer did.
+static void rtRunSwapped( const RtConvertPlan &plan, char *outBuffer, const char *inBuffer, unsigned int frames )
+{
+  const unsigned int step = ( RT_TILE_SAMPLES / plan.swapChannels + 3 ) & ~3;
+  for ( unsigned int f=0; f<frames; f+=step ) {
+    unsigned int n = ( frames - f < step ) ? frames - f : step;
+    if ( plan.swapInput ) rtSwapFrames( plan, (char *) inBuffer, f, n );
+    plan.convert( plan, outBuffer + f * plan.outJump * plan.outBytes,
+                  inBuffer + f * plan.inJump * plan.inBytes, n );
+    if ( !plan.swapInput ) rtSwapFrames( plan, outBuffer, f, n );
+  }
+}
+
+template <class In, class Out> static void rtPrepare( RtConvertPlan &plan, RtAudioFormat inFormat,
+                                                      RtAudioFormat outFormat )
+{
+  typedef typename RtBits<sizeof( typename In::T )>::T InBits;
+  typedef typename RtBits<sizeof( typename Out::T )>::T OutBits;
+  plan.inBytes = sizeof( typename In::T );
+  plan.outBytes = sizeof( typename Out::T );
+  plan.kernel = NULL;
+
+  // Tiled transposes take up to RT_TILE_SAMPLES / 4 channels.
+  bool same = ( inFormat == outFormat );
+  bool tiled = ( plan.channels > 1 && plan.channels <= RT_TILE_SAMPLES / 4 );
+  bool runs = true;
+  std::string path;
+  if ( plan.inJump == 1 && plan.outJump == 1 ) {
+    plan.function = &rtRunBlocks;
+    path = "contiguous blocks";
+  }
+  else if ( plan.inJump == plan.channels && plan.outJump == plan.channels &&
+            plan.inStride == 1 && plan.outStride == 1 ) {
+    plan.function = &rtRunFrames;
+    path = "interleaved frames";
+  }
+  else if ( tiled && plan.inStride == 1 && plan.outJump == 1 ) {
+    plan.function = same ? rtPickSplit<InBits, false>( plan.channels ) : rtPickSplit<InBits, true>( plan.channels );
+    path = "frames to blocks";
+  }
+  else if ( tiled && plan.inJump == 1 && plan.outStride == 1 ) {
+    plan.function = same ? rtPickMerge<OutBits, false>( plan.channels ) : rtPickMerge<OutBits, true>( plan.channels );
+    path = "blocks to frames";
+  }
+  else {
+    if ( plan.channels == 1 ) plan.function = &rtRunStrided<In, Out, 1>;
+    else if ( plan.channels == 2 ) plan.function = &rtRunStrided<In, Out, 2>;
+    else if ( plan.channels == 4 ) plan.function = &rtRunStrided<In, Out, 4>;
+    else if ( plan.channels == 8 ) plan.function = &rtRunStrided<In, Out, 8>;
+    else plan.function = &rtRunStrided<In, Out, 0>;
+    path = "strided";
+    runs = false;
+  }
+
+  std::string isa = "scalar";
+  if ( runs ) {
+    plan.kernel = rtConvertKernel( inFormat, outFormat );
+    if ( same ) isa = "copy";
+    else if ( plan.kernel ) isa = rtConvertIsa();
+    else plan.kernel = &rtScalar<In, Out>;
+  }
+
+  if ( plan.swap ) {
+    plan.convert = plan.function;
+    plan.function = &rtRunSwapped;
+    path += ", byte swapped";
+  }
+
+  std::ostringstream name;
+  name << isa << " " << rtFormatName( inFormat ) << " to " << rtFormatName( outFormat )
+       << ", " << plan.channels << ( plan.channels == 1 ? " channel, " : " channels, " ) << path;
+  plan.name = name.str();
+}
+
+template <class In> static void rtPrepareOut( RtConvertPlan &plan, RtAudioFormat inFormat,
+                                              RtAudioFormat outFormat )
+{
+  if ( outFormat == RTAUDIO_SINT8 ) rtPrepare<In, RtS8>( plan, inFormat, outFormat );
+  else if ( outFormat == RTAUDIO_SINT16 ) rtPrepare<In, RtS16>( plan, inFormat, outFormat );
+  else if ( outFormat == RTAUDIO_SINT24 ) rtPrepare<In, RtS24>( plan, inFormat, outFormat );
+  else if ( outFormat == RTAUDIO_SINT24_PACKED ) rtPrepare<In, RtS24P>( plan, inFormat, outFormat );
+  else if ( outFormat == RTAUDIO_SINT32 ) rtPrepare<In, RtS32>( plan, inFormat, outFormat );
+  else if ( outFormat == RTAUDIO_FLOAT32 ) rtPrepare<In, RtF32>( plan, inFormat, outFormat );
+  else rtPrepare<In, RtF64>( plan, inFormat, outFormat );
+}
+
+void rtConvertPrepare( RtConvertPlan &plan, RtAudioFormat inFormat, RtAudioFormat outFormat )
+{
+  if ( inFormat == RTAUDIO_SINT8 ) rtPrepareOut<RtS8>( plan, inFormat, outFormat );
+  else if ( inFormat == RTAUDIO_SINT16 ) rtPrepareOut<RtS16>( plan, inFormat, outFormat );
+  else if ( inFormat == RTAUDIO_SINT24 ) rtPrepareOut<RtS24>( plan, inFormat, outFormat );
+  else if ( inFormat == RTAUDIO_SINT24_PACKED ) rtPrepareOut<RtS24P>( plan, inFormat, outFormat );
+  else if ( inFormat == RTAUDIO_SINT32 ) rtPrepareOut<RtS32>( plan, inFormat, outFormat );
+  else if ( inFormat == RTAUDIO_FLOAT32 ) rtPrepareOut<RtF32>( plan, inFormat, outFormat );
+  else rtPrepareOut<RtF64>( plan, inFormat, outFormat );
+
+  if ( plan.channels < 1 ) {
+    plan.function = &rtRunNone;
+    plan.kernel = NULL;
+  }
+}
@@ -0,0 +1,53 @@
+/************************************************************************/
+/*! \file RtConvert.h
+    \brief Sample format conversion plans and kernels for RtApi::convertBuffer.
+
+    A conversion plan is prepared once per stream direction by
+    RtApi::setConvertInfo.  It points at a loop instantiated for the
+    format pair (and, for strided layouts, the channel count), so
+    RtApi::convertBuffer makes a single indirect call per buffer.
+    Contiguous runs of samples go through a vector kernel for the
+    widest instruction set the running CPU supports (AVX2 or SSE2 on
+    x86, Advanced SIMD on AArch64), picked once at run time.  Buffers
+    that are interleaved on one side only are transposed in cache-sized
+    tiles, with kernels for 2, 4, 8, 16 and 32 channels.  Device
+    samples in the other byte order are swapped a cache-sized chunk
+    at a time, right before or after the chunk is converted.  Every
+    path uses the same arithmetic, so all of them produce the same bits.
+*/
+/************************************************************************/
+
+#ifndef RTCONVERT_H
+#define RTCONVERT_H
+
+#include "RtAudio.h"
+
+//! Returns the vector kernel for a format pair, or NULL if the pair has none.
+RtConvertKernel rtConvertKernel( RtAudioFormat inFormat, RtAudioFormat outFormat );
+
+//! Returns the name of the instruction set the kernels use ("avx2", "sse2", "neon" or "scalar").
+const char *rtConvertIsa( void );
+
+//! Returns a kernel that reverses the bytes of each sample of a format, or NULL for 8-bit samples.
+/*!
+  The kernel may be called with \c out equal to \c in.
+*/
+RtConvertKernel rtSwapKernel( RtAudioFormat format );
+
+//! Returns a kernel that measures the peak magnitude and clipped samples of floating-point samples, or NULL for integers.
+/*!
+  The kernel stores the largest magnitude in \c peak and returns the
+  number of samples beyond plus/minus 1.0, which a conversion to an
+  integer format clips.
+*/
+RtMeterKernel rtMeterKernel( RtAudioFormat format );
+
+//! Picks the conversion function of a plan for a format pair.
+/*!
+  The channel count, bases, strides and jumps of the plan must be set,
+  and so must the swap fields if the device samples are byte swapped.
+  The sample sizes, function, kernel and name are filled in.
+*/
+void rtConvertPrepare( RtConvertPlan &plan, RtAudioFormat inFormat, RtAudioFormat outFormat );
+
+#endif
@@ -0,0 +1,356 @@
+/************************************************************************/
+/*! \file RtConvertPool.cpp
+    \brief Helper threads that share large buffer conversions (see RtConvertPool.h).
+
+    The cursor holds the generation of the current job in its top 32
+    bits, the number of parts in the next 16 and the next unclaimed
+    part in the low 16.  A helper that wakes up late still holds the
+    old generation, so its compare-and-swap fails instead of claiming a
+    part of a job it knows nothing about.  A job only ends once every
+    part is done, so the job read after a successful claim is always
+    the right one.
+
+    The callback thread predicts when the next conversion comes: the
+    conversions of a buffer keep roughly the same offsets from its
+    first one, and the first one of the next buffer comes a period
+    later.  Helpers sleep until a margin before that time and spin
+    until a margin after it.
+*/
+/************************************************************************/
+
+#include "RtConvertPool.h"
+#include "cpu.h"
+
+#if defined(__LINUX_ALSA__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
+  #define RT_POOL_THREADS
+  #include <sched.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+// Atomic access to the fields the threads share.  Without threads no
+// helper is ever started and the callback thread runs every part of a
+// job alone, so plain accesses do.
+#if defined(RT_POOL_THREADS)
+  #define RT_POOL_LOAD(A, ORDER)      __atomic_load_n( A, __ATOMIC_##ORDER )
+  #define RT_POOL_STORE(A, B, ORDER)  __atomic_store_n( A, B, __ATOMIC_##ORDER )
+  #define RT_POOL_ADD(A, B, ORDER)    __atomic_fetch_add( A, B, __ATOMIC_##ORDER )
+  #define RT_POOL_SUB(A, B, ORDER)    __atomic_fetch_sub( A, B, __ATOMIC_##ORDER )
+  #define RT_POOL_CAS(A, B, C)        __atomic_compare_exchange_n( A, B, C, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+#else
+  #define RT_POOL_LOAD(A, ORDER)      ( *(A) )
+  #define RT_POOL_STORE(A, B, ORDER)  ( *(A) = (B) )
+  #define RT_POOL_ADD(A, B, ORDER)    ( *(A) += (B) )
+  #define RT_POOL_SUB(A, B, ORDER)    ( *(A) -= (B) )
+  #define RT_POOL_CAS(A, B, C)        rtPoolSwap( A, B, C )
+
+static inline bool rtPoolSwap( unsigned long long *value, unsigned long long *expected, unsigned long long desired )
+{
+  if ( *value != *expected ) {
+    *expected = *value;
+    return false;
+  }
+  *value = desired;
+  return true;
+}
+#endif
+
+// Helpers started when the stream asks for one per core.
+static const unsigned int RT_POOL_AUTO_HELPERS = 3;
+
+// Nanoseconds a helper spins after a job, in case another follows.
+static const long long RT_POOL_SPIN = 50000;
+
+// Least nanoseconds a helper spins on either side of a predicted job.
+static const long long RT_POOL_MARGIN = 100000;
+
+// Nanoseconds of each nap once a predicted job is late.
+static const long long RT_POOL_NAP = 20000;
+
+// Nanoseconds without a job before a helper blocks.
+static const long long RT_POOL_IDLE = 100000000;
+
+// Spins between looks at the clock, and before the callback thread
+// waiting for the last parts starts to yield its core.
+static const unsigned int RT_POOL_SPINS = 64;
+
+static inline long long rtPoolNow( void )
+{
+#if defined(RT_POOL_THREADS)
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+static inline void rtPoolPause( void )
+{
+#if defined(CPU_SSE2)
+  _mm_pause();
+#endif
+}
+
+RtConvertPool :: RtConvertPool()
+  : helpers_( 0 ), period_( 0 ), margin_( RT_POOL_MARGIN ), wall_( 0.0 ), work_( 0.0 ), job_( 0 ), data_( 0 ), parts_( 0 ),
+    cursor_( 0 ), done_( 0 ), due_( 0 ), sleeping_( 0 ), quit_( 0 ), start_( 0 ), index_( 0 ), jobs_( 0 )
+{
+#if defined(RT_POOL_THREADS)
+  pthread_mutex_init( &lock_, NULL );
+  pthread_cond_init( &wake_, NULL );
+#endif
+}
+
+RtConvertPool :: ~RtConvertPool()
+{
+  stop();
+#if defined(RT_POOL_THREADS)
+  pthread_mutex_destroy( &lock_ );
+  pthread_cond_destroy( &wake_ );
+#endif
+}
+
+bool RtConvertPool :: start( int helpers, double period, bool realtime, int priority )
+{
+  stop();
+
+#if defined(RT_POOL_THREADS)
+  int core[RT_POOL_MAX_HELPERS + 1];
+  long cores = allowedCores( core, RT_POOL_MAX_HELPERS + 1 );
+  if ( helpers < 0 ) {
+    helpers = ( cores > 1 ) ? cores - 1 : 0;
+    if ( helpers > (int) RT_POOL_AUTO_HELPERS ) helpers = RT_POOL_AUTO_HELPERS;
+  }
+  if ( helpers > (int) RT_POOL_MAX_HELPERS ) helpers = RT_POOL_MAX_HELPERS;
+  if ( helpers < 1 ) return false;
+
+  period_ = (long long) ( period * 1e9 );
+  margin_ = period_ / 16;
+  if ( margin_ < RT_POOL_MARGIN ) margin_ = RT_POOL_MARGIN;
+  start_ = -2 * period_ - margin_;
+  index_ = jobs_ = 0;
+  quit_ = 0;
+
+  for ( int k=0; k<helpers; k++ ) {
+    Helper &h = helper_[k];
+    h.pool = this;
+
+    // The helpers stand in for the callback thread, so they get its
+    // scheduling.  Without the privilege for it they run as usual.
+    pthread_attr_t attr;
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_JOINABLE );
+#ifdef SCHED_RR
+    if ( realtime ) {
+      struct sched_param param;
+      int min = sched_get_priority_min( SCHED_RR );
+      int max = sched_get_priority_max( SCHED_RR );
+      if ( priority < min ) priority = min;
+      else if ( priority > max ) priority = max;
+      param.sched_priority = priority;
+      pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED );
+      pthread_attr_setschedpolicy( &attr, SCHED_RR );
+      pthread_attr_setschedparam( &attr, &param );
+    }
+#endif
+    int result = pthread_create( &h.thread, &attr, helperThread, &h );
+    pthread_attr_destroy( &attr );
+    if ( result && realtime ) result = pthread_create( &h.thread, NULL, helperThread, &h );
+    if ( result ) break;
+    helpers_++;
+
+    // One core per helper, from the cores the process may run on,
+    // leaving the first of them to the callback thread.  Helpers
+    // beyond the cores there are stay unpinned.
+    if ( k + 1 < cores ) pin( h.thread, core[k + 1] );
+  }
+
+  return helpers_ > 0;
+#else
+  return false;
+#endif
+}
+
+void RtConvertPool :: stop( void )
+{
+#if defined(RT_POOL_THREADS)
+  if ( helpers_ == 0 ) return;
+
+  pthread_mutex_lock( &lock_ );
+  RT_POOL_STORE( &quit_, 1, SEQ_CST );
+  pthread_cond_broadcast( &wake_ );
+  pthread_mutex_unlock( &lock_ );
+  for ( unsigned int k=0; k<helpers_; k++ ) pthread_join( helper_[k].thread, NULL );
+  helpers_ = 0;
+#endif
+}
+
+bool RtConvertPool :: claim( unsigned int generation, unsigned int &part )
+{
+  unsigned long long c = RT_POOL_LOAD( &cursor_, ACQUIRE );
+  while ( (unsigned int) ( c >> 32 ) == generation && ( c & 0xffff ) < ( ( c >> 16 ) & 0xffff ) ) {
+    if ( RT_POOL_CAS( &cursor_, &c, c + 1 ) ) {
+      part = (unsigned int) ( c & 0xffff );
+      return true;
+    }
+  }
+  return false;
+}
+
+void RtConvertPool :: participate( unsigned int generation )
+{
+  unsigned int part;
+  while ( claim( generation, part ) ) {
+    long long t = rtPoolNow();
+    job_( data_, part, parts_ );
+    partTime_[part] = rtPoolNow() - t;
+    RT_POOL_ADD( &done_, 1, RELEASE );
+  }
+}
+
+unsigned int RtConvertPool :: waitForJob( unsigned int seen )
+{
+#if defined(RT_POOL_THREADS)
+  long long now = rtPoolNow();
+  long long idle = now, spinUntil = now + RT_POOL_SPIN;
+  for ( unsigned int spins=1; ; spins++ ) {
+    unsigned int generation = (unsigned int) ( RT_POOL_LOAD( &cursor_, ACQUIRE ) >> 32 );
+    if ( generation != seen || RT_POOL_LOAD( &quit_, RELAXED ) ) return generation;
+    rtPoolPause();
+    if ( spins % RT_POOL_SPINS ) continue;
+
+    now = rtPoolNow();
+    if ( now < spinUntil ) continue;
+
+    long long due = RT_POOL_LOAD( &due_, RELAXED );
+    long long nap = RT_POOL_NAP;
+    if ( now < due + margin_ ) {
+      // Sleep through most of the wait for the predicted job, then spin.
+      spinUntil = due + margin_;
+      if ( now >= due - margin_ ) continue;
+      nap = due - margin_ - now;
+    }
+    else if ( now - idle > RT_POOL_IDLE ) {
+      // No job for a while: the stream is stopped, or slower than we
+      // can predict.  Block until run() wakes us.  Whichever of our
+      // sleeping_ and its cursor_ is written first, the other side
+      // sees it.
+      pthread_mutex_lock( &lock_ );
+      RT_POOL_ADD( &sleeping_, 1, SEQ_CST );
+      while ( (unsigned int) ( RT_POOL_LOAD( &cursor_, SEQ_CST ) >> 32 ) == seen &&
+              !RT_POOL_LOAD( &quit_, SEQ_CST ) )
+        pthread_cond_wait( &wake_, &lock_ );
+      RT_POOL_SUB( &sleeping_, 1, SEQ_CST );
+      pthread_mutex_unlock( &lock_ );
+      idle = spinUntil = rtPoolNow();
+      continue;
+    }
+
+    struct timespec ts = { (time_t) ( nap / 1000000000 ), (long) ( nap % 1000000000 ) };
+    nanosleep( &ts, NULL );
+  }
+#else
+  return seen;
+#endif
+}
+
+#if defined(RT_POOL_THREADS)
+long RtConvertPool :: allowedCores( int *core, int max )
+{
+  // The first max cores of the affinity mask the calling thread was
+  // given (by taskset or a cpuset, say), and how many there are.
+  long count = sysconf( _SC_NPROCESSORS_ONLN );
+  for ( int k=0; k<max && k<count; k++ ) core[k] = k;
+#if defined(__linux__)
+  cpu_set_t set;
+  if ( sched_getaffinity( 0, sizeof( set ), &set ) == 0 ) {
+    count = 0;
+    for ( int c=0; c<CPU_SETSIZE; c++ ) {
+      if ( !CPU_ISSET( c, &set ) ) continue;
+      if ( count < max ) core[count] = c;
+      count++;
+    }
+  }
+#endif
+  return count;
+}
+
+void RtConvertPool :: pin( pthread_t thread, int core )
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO( &set );
+  CPU_SET( core, &set );
+  pthread_setaffinity_np( thread, sizeof( set ), &set );
+#endif
+}
+#endif
+
+void *RtConvertPool :: helperThread( void *ptr )
+{
+  RtConvertPool &pool = *( (Helper *) ptr )->pool;
+  unsigned int seen = (unsigned int) ( RT_POOL_LOAD( &pool.cursor_, ACQUIRE ) >> 32 );
+  for (;;) {
+    seen = pool.waitForJob( seen );
+    if ( RT_POOL_LOAD( &pool.quit_, RELAXED ) ) return NULL;
+    pool.participate( seen );
+  }
+}
+
+void RtConvertPool :: run( Job job, void *data )
+{
+  long long t = rtPoolNow();
+  if ( helpers_ == 0 ) {
+    job( data, 0, 1 );
+    wall_ = work_ = ( rtPoolNow() - t ) * 1e-9;
+    return;
+  }
+
+  // Predict the next job for the helpers: either the next conversion
+  // of this buffer, at the offset it had in the last buffer, or the
+  // first conversion of the next buffer.
+  if ( t >= start_ + period_ - margin_ ) {
+    jobs_ = index_ + 1;
+    start_ = t;
+    index_ = 0;
+  }
+  else
+    index_++;
+  if ( index_ < RT_POOL_SLOTS ) offset_[index_] = t - start_;
+  long long due = start_ + period_;
+  if ( index_ + 1 < jobs_ && index_ + 1 < RT_POOL_SLOTS ) due = start_ + offset_[index_ + 1];
+  RT_POOL_STORE( &due_, due, RELAXED );
+
+  // No helper touches these until the new generation is published.
+  unsigned int parts = threads() * RT_POOL_PARTS;
+  unsigned int generation = (unsigned int) ( RT_POOL_LOAD( &cursor_, RELAXED ) >> 32 ) + 1;
+  job_ = job;
+  data_ = data;
+  parts_ = parts;
+  RT_POOL_STORE( &done_, 0, RELAXED );
+  RT_POOL_STORE( &cursor_, ( (unsigned long long) generation << 32 ) | ( parts << 16 ), SEQ_CST );
+#if defined(RT_POOL_THREADS)
+  if ( RT_POOL_LOAD( &sleeping_, SEQ_CST ) ) {
+    pthread_mutex_lock( &lock_ );
+    pthread_cond_broadcast( &wake_ );
+    pthread_mutex_unlock( &lock_ );
+  }
+#endif
+
+  participate( generation );
+
+  // The parts still in flight belong to helpers and cannot be taken
+  // back, so wait, yielding the core in case a helper needs it.
+  for ( unsigned int spins=0; RT_POOL_LOAD( &done_, ACQUIRE ) != parts; spins++ ) {
+    if ( spins < RT_POOL_SPINS ) rtPoolPause();
+#if defined(RT_POOL_THREADS)
+    else sched_yield();
+#endif
+  }
+
+  long long work = 0;
+  for ( unsigned int k=0; k<parts; k++ ) work += partTime_[k];
+  wall_ = ( rtPoolNow() - t ) * 1e-9;
+  work_ = work * 1e-9;
+}
@@ -0,0 +1,122 @@
+/************************************************************************/
+/*! \file RtConvertPool.h
+    \brief Helper threads that share large buffer conversions.
+
+    A stream with many channels can spend a large part of each period
+    in RtApi::convertBuffer.  Such a stream starts a few helper
+    threads, pinned to their own cores where the system allows.  The
+    cores are taken from those the process may run on, leaving the
+    first of them to the callback thread, whose own affinity is left
+    alone: it belongs to the backend (JACK and CoreAudio own it).
+    Every large conversion is cut into parts of consecutive frames,
+    which the callback thread and the helpers claim one at a time.  The
+    callback thread only returns to the device once every claimed part
+    is done.  It takes the parts no helper reached, so a helper that
+    sleeps through a buffer costs that buffer its speed-up but never
+    holds it up for longer than the conversion alone takes.
+
+    Between buffers a helper spins for a moment, in case another
+    conversion follows straight away, then sleeps until shortly before
+    the next buffer is due and spins again.  A helper that has had no
+    work for a while blocks until the next conversion wakes it.
+*/
+/************************************************************************/
+
+#ifndef RTCONVERTPOOL_H
+#define RTCONVERTPOOL_H
+
+#include "RtAudio.h"
+
+// The most helper threads a pool starts.
+static const unsigned int RT_POOL_MAX_HELPERS = 15;
+
+// Parts each participant is given, on average.
+static const unsigned int RT_POOL_PARTS = 2;
+
+// Conversions of a buffer whose times are predicted.
+static const unsigned int RT_POOL_SLOTS = 4;
+
+class RtConvertPool
+{
+ public:
+
+  //! A job converts part \c part of \c parts of a buffer.
+  typedef void (*Job)( void *data, unsigned int part, unsigned int parts );
+
+  RtConvertPool();
+  ~RtConvertPool();
+
+  //! Starts up to \c helpers helper threads for a stream whose buffers are \c period seconds apart.
+  /*!
+    A negative \c helpers starts one per core besides the first, up to
+    three.  With \c realtime set the helpers run with round-robin
+    scheduling at \c priority, like the callback thread they work for.
+    Returns false, and starts nothing, if no thread could be started or
+    the system has no threads to offer.
+  */
+  bool start( int helpers, double period, bool realtime, int priority );
+
+  //! Stops and joins the helper threads.
+  void stop( void );
+
+  //! Returns the threads that take part in a job, the caller of run() included.
+  unsigned int threads( void ) const { return helpers_ + 1; };
+
+  //! Runs every part of a job, on the calling thread and the helpers, and returns when all of them are done.
+  void run( Job job, void *data );
+
+  //! Returns the seconds the last run() took.
+  double wall( void ) const { return wall_; };
+
+  //! Returns the seconds of work the parts of the last run() took, added up.
+  double work( void ) const { return work_; };
+
+ protected:
+
+  struct Helper {
+    RtConvertPool *pool;
+    ThreadHandle thread;
+  };
+
+  static void *helperThread( void *ptr );
+#if defined(__LINUX_ALSA__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
+  static long allowedCores( int *core, int max );
+  static void pin( pthread_t thread, int core );
+#endif
+  bool claim( unsigned int generation, unsigned int &part );
+  void participate( unsigned int generation );
+  unsigned int waitForJob( unsigned int seen );
+
+  Helper helper_[RT_POOL_MAX_HELPERS];
+  unsigned int helpers_;
+  long long period_;               // Nanoseconds between buffers.
+  long long margin_;               // Nanoseconds helpers spin on either side of a predicted job.
+  double wall_, work_;
+
+  // The job of the current generation.  They are written before the
+  // cursor publishes the generation, and read after it is seen.
+  Job job_;
+  void *data_;
+  unsigned int parts_;
+  long long partTime_[RT_POOL_PARTS * ( RT_POOL_MAX_HELPERS + 1 )];
+
+  // Shared between the threads, through atomic operations.
+  unsigned long long cursor_;      // Generation, parts and next part (see RtConvertPool.cpp).
+  unsigned int done_;              // Parts of the current generation finished.
+  long long due_;                  // When the next conversion is expected.
+  unsigned int sleeping_;          // Helpers blocked on wake_.
+  int quit_;
+
+  // Kept by the callback thread to predict the next job.
+  long long start_;                // When the first conversion of this buffer started.
+  unsigned int index_;             // The conversion of this buffer now running.
+  unsigned int jobs_;              // Conversions of the last buffer.
+  long long offset_[RT_POOL_SLOTS]; // When each conversion of the last buffers started, after the first.
+
+#if defined(__LINUX_ALSA__) || defined(__UNIX_JACK__) || defined(__LINUX_OSS__) || defined(__MACOSX_CORE__)
+  pthread_mutex_t lock_;
+  pthread_cond_t wake_;
+#endif
+};
+
+#endif
@@ -0,0 +1,180 @@
+/************************************************************************/
+/*! \file RtMix.cpp
+    \brief Channel mixing matrices (see RtMix.h).
+
+    An output sample is the product of the first term's gain and input
+    sample, plus the product of each further term in turn, in single
+    precision.  The vector kernels compute whole vectors of frames the
+    same way and hand the frames left over to the scalar loop.  The
+    frames of a buffer are mixed in blocks small enough for every
+    input channel of a block to stay in the cache.
+*/
+/************************************************************************/
+
+#include "RtMix.h"
+#include "RtConvert.h"
+#include "cpu.h"
+#include <cstring>
+#include <sstream>
+
+// Input samples of all channels that one block of frames may span.
+static const unsigned int RT_MIX_BLOCK_SAMPLES = 8192;
+
+static inline void rtMixTail( float *out, const float *in, int pitch, const int *source,
+                              const float *gain, int terms, unsigned int f, unsigned int frames )
+{
+  for ( ; f<frames; f++ ) {
+    float sum = gain[0] * in[source[0] * pitch + f];
+    for ( int t=1; t<terms; t++ ) sum += gain[t] * in[source[t] * pitch + f];
+    out[f] = sum;
+  }
+}
+
+static void rtMixScalar( float *out, const float *in, int pitch, const int *source,
+                         const float *gain, int terms, unsigned int frames )
+{
+  rtMixTail( out, in, pitch, source, gain, terms, 0, frames );
+}
+
+#if defined(CPU_SSE2)
+static void rtMixSse2( float *out, const float *in, int pitch, const int *source,
+                       const float *gain, int terms, unsigned int frames )
+{
+  unsigned int f = 0;
+  for ( ; f + 8 <= frames; f += 8 ) {
+    const float *x = in + source[0] * pitch + f;
+    __m128 g = _mm_set1_ps( gain[0] );
+    __m128 lo = _mm_mul_ps( g, _mm_loadu_ps( x ) ), hi = _mm_mul_ps( g, _mm_loadu_ps( x + 4 ) );
+    for ( int t=1; t<terms; t++ ) {
+      x = in + source[t] * pitch + f;
+      g = _mm_set1_ps( gain[t] );
+      lo = _mm_add_ps( lo, _mm_mul_ps( g, _mm_loadu_ps( x ) ) );
+      hi = _mm_add_ps( hi, _mm_mul_ps( g, _mm_loadu_ps( x + 4 ) ) );
+    }
+    _mm_storeu_ps( out + f, lo );
+    _mm_storeu_ps( out + f + 4, hi );
+  }
+  rtMixTail( out, in, pitch, source, gain, terms, f, frames );
+}
+#endif
+
+#if defined(CPU_AVX2)
+CPU_AVX2_TARGET static void rtMixAvx2( float *out, const float *in, int pitch, const int *source,
+                                       const float *gain, int terms, unsigned int frames )
+{
+  unsigned int f = 0;
+  for ( ; f + 16 <= frames; f += 16 ) {
+    const float *x = in + source[0] * pitch + f;
+    __m256 g = _mm256_set1_ps( gain[0] );
+    __m256 lo = _mm256_mul_ps( g, _mm256_loadu_ps( x ) ), hi = _mm256_mul_ps( g, _mm256_loadu_ps( x + 8 ) );
+    for ( int t=1; t<terms; t++ ) {
+      x = in + source[t] * pitch + f;
+      g = _mm256_set1_ps( gain[t] );
+      lo = _mm256_add_ps( lo, _mm256_mul_ps( g, _mm256_loadu_ps( x ) ) );
+      hi = _mm256_add_ps( hi, _mm256_mul_ps( g, _mm256_loadu_ps( x + 8 ) ) );
+    }
+    _mm256_storeu_ps( out + f, lo );
+    _mm256_storeu_ps( out + f + 8, hi );
+  }
+  rtMixTail( out, in, pitch, source, gain, terms, f, frames );
+}
+#endif
+
+#if defined(CPU_NEON)
+static void rtMixNeon( float *out, const float *in, int pitch, const int *source,
+                       const float *gain, int terms, unsigned int frames )
+{
+  unsigned int f = 0;
+  for ( ; f + 8 <= frames; f += 8 ) {
+    const float *x = in + source[0] * pitch + f;
+    float32x4_t g = vdupq_n_f32( gain[0] );
+    float32x4_t lo = vmulq_f32( g, vld1q_f32( x ) ), hi = vmulq_f32( g, vld1q_f32( x + 4 ) );
+    for ( int t=1; t<terms; t++ ) {
+      x = in + source[t] * pitch + f;
+      g = vdupq_n_f32( gain[t] );
+      lo = vaddq_f32( lo, vmulq_f32( g, vld1q_f32( x ) ) );
+      hi = vaddq_f32( hi, vmulq_f32( g, vld1q_f32( x + 4 ) ) );
+    }
+    vst1q_f32( out + f, lo );
+    vst1q_f32( out + f + 4, hi );
+  }
+  rtMixTail( out, in, pitch, source, gain, terms, f, frames );
+}
+#endif
+
+static void rtMixRun( const RtMixPlan &plan, float *out, const float *in, unsigned int frames )
+{
+  unsigned int step = ( RT_MIX_BLOCK_SAMPLES / plan.inChannels ) & ~15u;
+  if ( step < 16 ) step = 16;
+
+  for ( unsigned int f=0; f<frames; f+=step ) {
+    unsigned int n = ( frames - f < step ) ? frames - f : step;
+    for ( int k=0; k<plan.outChannels; k++ ) {
+      float *o = out + k * plan.pitch + f;
+      int first = plan.first[k], terms = plan.first[k + 1] - first;
+      if ( terms == 0 )
+        memset( o, 0, n * sizeof( float ) );
+      else if ( terms == 1 && plan.gain[first] == 1.0f )
+        memcpy( o, in + plan.source[first] * plan.pitch + f, n * sizeof( float ) );
+      else
+        plan.kernel( o, in + f, plan.pitch, &plan.source[first], &plan.gain[first], terms, n );
+    }
+  }
+}
+
+bool rtMixIdentity( const std::vector<float> &matrix, int inChannels, int outChannels )
+{
+  if ( inChannels != outChannels ) return false;
+  for ( int k=0; k<outChannels; k++ )
+    for ( int j=0; j<inChannels; j++ )
+      if ( matrix[k * inChannels + j] != ( ( j == k ) ? 1.0f : 0.0f ) ) return false;
+  return true;
+}
+
+void rtMixPrepare( RtMixPlan &plan, const std::vector<float> &matrix, int inChannels, int outChannels,
+                   int pitch )
+{
+  plan.inChannels = inChannels;
+  plan.outChannels = outChannels;
+  plan.pitch = pitch;
+  plan.first.clear();
+  plan.source.clear();
+  plan.gain.clear();
+
+  // Keep the non-zero gains of each row, and note whether every row
+  // merely copies (or clears) a channel.
+  bool routing = true;
+  for ( int k=0; k<outChannels; k++ ) {
+    plan.first.push_back( (int) plan.source.size() );
+    for ( int j=0; j<inChannels; j++ ) {
+      float g = matrix[k * inChannels + j];
+      if ( g == 0.0f ) continue;
+      plan.source.push_back( j );
+      plan.gain.push_back( g );
+    }
+    int terms = (int) plan.source.size() - plan.first[k];
+    if ( terms > 1 || ( terms == 1 && plan.gain.back() != 1.0f ) ) routing = false;
+  }
+  plan.first.push_back( (int) plan.source.size() );
+
+  plan.function = &rtMixRun;
+  plan.kernel = &rtMixScalar;
+#if defined(CPU_SSE2)
+  plan.kernel = &rtMixSse2;
+#elif defined(CPU_NEON)
+  plan.kernel = &rtMixNeon;
+#endif
+#if defined(CPU_AVX2)
+  if ( cpu_has_avx2() ) plan.kernel = &rtMixAvx2;
+#endif
+
+  std::ostringstream name;
+  int gains = inChannels * outChannels;
+  if ( routing )
+    name << "copy, routing";
+  else if ( (int) plan.source.size() < gains )
+    name << rtConvertIsa() << ", sparse, " << plan.source.size() << " of " << gains << " gains";
+  else
+    name << rtConvertIsa() << ", dense";
+  plan.name = name.str();
+}
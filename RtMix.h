@@ -0,0 +1,32 @@
+/************************************************************************/
+/*! \file RtMix.h
+    \brief Channel mixing matrices for RtApi::convertBuffer.
+
+    A mixing plan is prepared once per stream direction by
+    RtApi::setMixInfo, from the gains of a matrix with one row per
+    output channel.  Zero gains are dropped, so a sparse matrix costs
+    only its non-zero terms.  An output channel with no terms is
+    cleared and one that is a single input at unity gain is copied;
+    any other is summed by a vector kernel for the widest instruction
+    set the running CPU supports.  Every path adds the terms in the
+    same order, so all of them produce the same bits.
+*/
+/************************************************************************/
+
+#ifndef RTMIX_H
+#define RTMIX_H
+
+#include "RtAudio.h"
+
+//! Returns true if a matrix with \c inChannels columns and \c outChannels rows passes every channel through unchanged.
+bool rtMixIdentity( const std::vector<float> &matrix, int inChannels, int outChannels );
+
+//! Fills in a mixing plan for a matrix with \c inChannels columns and \c outChannels rows.
+/*!
+  Channels are \c pitch samples apart on both sides.  The terms,
+  function, kernel and name of the plan are filled in.
+*/
+void rtMixPrepare( RtMixPlan &plan, const std::vector<float> &matrix, int inChannels, int outChannels,
+                   int pitch );
+
+#endif
@@ -0,0 +1,279 @@
+/************************************************************************/
+/*! \file RtResample.cpp
+    \brief Polyphase sample-rate conversion (see RtResample.h).
+
+    The filters are windowed with a Kaiser window and designed so that
+    the transition band ends at the lower of the two Nyquist rates.
+    Each phase is normalized to unity gain at DC.  A dot product keeps
+    eight partial sums (tap i goes to sum i mod 8) and adds them up in
+    a fixed order, so the scalar and vector paths give the same bits.
+*/
+/************************************************************************/
+
+#include "RtResample.h"
+#include "cpu.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+// Filter design of each quality preset.  The cutoff is in cycles per
+// input sample, in the middle of the transition band; the taps are
+// for a ratio of 1 and widen as the band narrows for decimation.
+struct RtResamplePreset {
+  const char *name;
+  unsigned int taps;
+  double cutoff;
+  double beta;
+};
+
+static const RtResamplePreset rtResamplePresets[] = {
+  { "fast", 16, 0.425, 3.6 },    // passes 70% of the band
+  { "medium", 48, 0.45, 7.5 },   // passes 80% of the band
+  { "best", 96, 0.465, 10.5 }    // passes 86% of the band
+};
+
+#define RT_PI 3.14159265358979323846
+
+// Phase tables larger than this interpolate between a smaller table.
+static const unsigned int RT_MAX_PHASES = 512;
+static const unsigned int RT_INTERPOLATED_PHASES = 256;
+
+// The most taps a decimating filter may widen to.
+static const unsigned int RT_MAX_TAPS = 256;
+
+static unsigned int rtGcd( unsigned int a, unsigned int b )
+{
+  while ( b ) {
+    unsigned int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// The zeroth-order modified Bessel function of the first kind.
+static double rtBesselI0( double x )
+{
+  double sum = 1.0, term = 1.0;
+  for ( int k=1; k<50 && term > sum * 1e-17; k++ ) {
+    term *= ( x * x ) / ( 4.0 * k * k );
+    sum += term;
+  }
+  return sum;
+}
+
+static inline float rtDotSum( const float *a )
+{
+  float s0 = a[0] + a[4], s1 = a[1] + a[5], s2 = a[2] + a[6], s3 = a[3] + a[7];
+  return ( s0 + s2 ) + ( s1 + s3 );
+}
+
+static float rtDotScalar( const float *h, const float *x, unsigned int taps )
+{
+  float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  for ( unsigned int i=0; i<taps; i+=8 )
+    for ( int j=0; j<8; j++ ) acc[j] += h[i + j] * x[i + j];
+  return rtDotSum( acc );
+}
+
+#if defined(CPU_SSE2)
+static float rtDotSse2( const float *h, const float *x, unsigned int taps )
+{
+  __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+  for ( unsigned int i=0; i<taps; i+=8 ) {
+    lo = _mm_add_ps( lo, _mm_mul_ps( _mm_loadu_ps( h + i ), _mm_loadu_ps( x + i ) ) );
+    hi = _mm_add_ps( hi, _mm_mul_ps( _mm_loadu_ps( h + i + 4 ), _mm_loadu_ps( x + i + 4 ) ) );
+  }
+  __m128 s = _mm_add_ps( lo, hi );
+  s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+  return _mm_cvtss_f32( _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) ) );
+}
+#endif
+
+#if defined(CPU_AVX2)
+CPU_AVX2_TARGET static float rtDotAvx2( const float *h, const float *x, unsigned int taps )
+{
+  __m256 acc = _mm256_setzero_ps();
+  for ( unsigned int i=0; i<taps; i+=8 )
+    acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_loadu_ps( h + i ), _mm256_loadu_ps( x + i ) ) );
+  __m128 s = _mm_add_ps( _mm256_castps256_ps128( acc ), _mm256_extractf128_ps( acc, 1 ) );
+  s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+  return _mm_cvtss_f32( _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) ) );
+}
+#endif
+
+#if defined(CPU_NEON)
+static float rtDotNeon( const float *h, const float *x, unsigned int taps )
+{
+  float32x4_t lo = vdupq_n_f32( 0.0f ), hi = vdupq_n_f32( 0.0f );
+  for ( unsigned int i=0; i<taps; i+=8 ) {
+    lo = vaddq_f32( lo, vmulq_f32( vld1q_f32( h + i ), vld1q_f32( x + i ) ) );
+    hi = vaddq_f32( hi, vmulq_f32( vld1q_f32( h + i + 4 ), vld1q_f32( x + i + 4 ) ) );
+  }
+  float32x4_t s = vaddq_f32( lo, hi );
+  float32x2_t t = vadd_f32( vget_low_f32( s ), vget_high_f32( s ) );
+  return vget_lane_f32( t, 0 ) + vget_lane_f32( t, 1 );
+}
+#endif
+
+RtResampler :: RtResampler( unsigned int inRate, unsigned int outRate, unsigned int channels,
+                            RtAudioResampleQuality quality )
+  : channels_( channels ), quality_( quality ), capacity_( 0 ), frames_( 0 ), position_( 0 ), phase_( 0 )
+{
+  unsigned int g = rtGcd( inRate, outRate );
+  up_ = outRate / g;
+  down_ = inRate / g;
+
+  if ( quality_ < RTAUDIO_RESAMPLE_FAST ) quality_ = RTAUDIO_RESAMPLE_FAST;
+  if ( quality_ > RTAUDIO_RESAMPLE_BEST ) quality_ = RTAUDIO_RESAMPLE_BEST;
+  const RtResamplePreset &preset = rtResamplePresets[quality_ - RTAUDIO_RESAMPLE_FAST];
+
+  // Decimation narrows the band to the output Nyquist rate.
+  double scale = ( up_ < down_ ) ? (double) up_ / down_ : 1.0;
+  taps_ = (unsigned int) ceil( preset.taps / scale );
+  if ( taps_ > RT_MAX_TAPS ) taps_ = RT_MAX_TAPS;
+  taps_ = ( taps_ + 7 ) & ~7u;
+
+  interpolate_ = ( up_ > RT_MAX_PHASES );
+  phases_ = interpolate_ ? RT_INTERPOLATED_PHASES : up_;
+
+  // Phase p of P puts its output p / P of the way from input frame
+  // taps / 2 - 1 to the next one.  An interpolated table has one more
+  // phase, at a whole frame, to interpolate towards.
+  unsigned int tables = interpolate_ ? phases_ + 1 : phases_;
+  filters_.resize( tables * taps_ );
+  scratch_.resize( taps_ );
+  double fc = preset.cutoff * scale;
+  double half = taps_ / 2.0;
+  double norm = rtBesselI0( preset.beta );
+  for ( unsigned int p=0; p<tables; p++ ) {
+    float *h = &filters_[p * taps_];
+    double sum = 0.0;
+    for ( unsigned int k=0; k<taps_; k++ ) {
+      double d = k - ( half - 1.0 ) - (double) p / phases_;
+      double x = d / half;
+      double w = ( x > -1.0 && x < 1.0 ) ? rtBesselI0( preset.beta * sqrt( 1.0 - x * x ) ) / norm : 0.0;
+      double s = ( d == 0.0 ) ? 2.0 * fc : sin( 2.0 * RT_PI * fc * d ) / ( RT_PI * d );
+      h[k] = (float) ( s * w );
+      sum += s * w;
+    }
+    for ( unsigned int k=0; k<taps_; k++ ) h[k] = (float) ( h[k] / sum );
+  }
+
+  dot_ = &rtDotScalar;
+  isa_ = "scalar";
+#if defined(CPU_SSE2)
+  dot_ = &rtDotSse2;
+  isa_ = "sse2";
+#elif defined(CPU_NEON)
+  dot_ = &rtDotNeon;
+  isa_ = "neon";
+#endif
+#if defined(CPU_AVX2)
+  if ( cpu_has_avx2() ) {
+    dot_ = &rtDotAvx2;
+    isa_ = "avx2";
+  }
+#endif
+
+  reserve( 0 );
+  reset();
+}
+
+unsigned int RtResampler :: maxOutput( unsigned int inFrames ) const
+{
+  return (unsigned int) ( (unsigned long long) inFrames * up_ / down_ ) + 2;
+}
+
+unsigned int RtResampler :: maxInput( unsigned int outFrames ) const
+{
+  return (unsigned int) ( ( (unsigned long long) outFrames * down_ + up_ - 1 ) / up_ ) + 2;
+}
+
+unsigned int RtResampler :: inputFrames( unsigned int outFrames ) const
+{
+  if ( outFrames == 0 ) return 0;
+  unsigned long long last = position_ + ( phase_ + (unsigned long long) ( outFrames - 1 ) * down_ ) / up_;
+  unsigned long long need = last + taps_;
+  return ( need > frames_ ) ? (unsigned int) ( need - frames_ ) : 0;
+}
+
+void RtResampler :: reserve( unsigned int inFrames )
+{
+  // The history holds at most taps_ frames besides the new ones.
+  unsigned int capacity = 2 * taps_ + inFrames;
+  if ( capacity <= capacity_ ) return;
+
+  std::vector<float> history( channels_ * capacity, 0.0f );
+  for ( unsigned int c=0; c<channels_ && frames_ > 0; c++ )
+    memcpy( &history[c * capacity], &history_[c * capacity_], frames_ * sizeof( float ) );
+  history_.swap( history );
+  capacity_ = capacity;
+}
+
+void RtResampler :: reset( void )
+{
+  // Start with a filter's worth of silence, so that the first input
+  // frame already produces output (delayed by latency()).
+  std::fill( history_.begin(), history_.end(), 0.0f );
+  frames_ = taps_ - 1;
+  position_ = 0;
+  phase_ = 0;
+}
+
+unsigned int RtResampler :: process( float *out, unsigned int maxOut, const float *in, unsigned int inFrames )
+{
+  if ( frames_ + inFrames > capacity_ ) reserve( frames_ + inFrames );
+
+  for ( unsigned int c=0; c<channels_; c++ ) {
+    float *x = &history_[c * capacity_ + frames_];
+    for ( unsigned int i=0; i<inFrames; i++ ) x[i] = in[i * channels_ + c];
+  }
+  frames_ += inFrames;
+
+  unsigned int n = 0;
+  for ( ; n < maxOut && position_ + taps_ <= frames_; n++ ) {
+    const float *h;
+    if ( interpolate_ ) {
+      unsigned long long q = (unsigned long long) phase_ * phases_;
+      const float *h0 = &filters_[( q / up_ ) * taps_];
+      const float *h1 = h0 + taps_;
+      float f = (float) ( q % up_ ) / up_;
+      for ( unsigned int k=0; k<taps_; k++ ) scratch_[k] = h0[k] + f * ( h1[k] - h0[k] );
+      h = &scratch_[0];
+    }
+    else
+      h = &filters_[phase_ * taps_];
+
+    float *frame = out + n * channels_;
+    for ( unsigned int c=0; c<channels_; c++ )
+      frame[c] = dot_( h, &history_[c * capacity_ + position_], taps_ );
+
+    phase_ += down_;
+    position_ += phase_ / up_;
+    phase_ %= up_;
+  }
+
+  // Drop the frames no later output needs.  A decimating resampler can
+  // step past the end of the history, into input it has not seen yet.
+  unsigned int drop = ( position_ < frames_ ) ? position_ : frames_;
+  if ( drop > 0 ) {
+    for ( unsigned int c=0; c<channels_; c++ ) {
+      float *x = &history_[c * capacity_];
+      memmove( x, x + drop, ( frames_ - drop ) * sizeof( float ) );
+    }
+    frames_ -= drop;
+    position_ -= drop;
+  }
+
+  return n;
+}
+
+std::string RtResampler :: name( void ) const
+{
+  std::ostringstream name;
+  name << rtResamplePresets[quality_ - RTAUDIO_RESAMPLE_FAST].name << ", " << taps_ << " taps, "
+       << phases_ << ( interpolate_ ? " interpolated phases, " : " phases, " ) << isa_;
+  return name.str();
+}
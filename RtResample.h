@@ -0,0 +1,83 @@
+/************************************************************************/
+/*! \file RtResample.h
+    \brief Polyphase sample-rate conversion for RtApi streams.
+
+    When a device cannot run at the rate a stream was opened with, the
+    stream can stay at that rate and RtApi converts each buffer to and
+    from the device rate.  The rates are reduced to a ratio L / M, and
+    each output frame is a dot product of one of L precomputed phase
+    filters (Kaiser-windowed sinc) with the input frames around it.
+    Ratios whose L is too large for a table of its own interpolate
+    between 256 phases.  The dot products use the widest instruction
+    set the running CPU supports, and every path adds the products in
+    the same order.
+*/
+/************************************************************************/
+
+#ifndef RTRESAMPLE_H
+#define RTRESAMPLE_H
+
+#include "RtAudio.h"
+#include <string>
+#include <vector>
+
+class RtResampler
+{
+ public:
+
+  //! Builds the filter bank for a rate pair, a channel count and a quality preset.
+  RtResampler( unsigned int inRate, unsigned int outRate, unsigned int channels,
+               RtAudioResampleQuality quality );
+
+  //! Returns the most output frames a call with \c inFrames input frames can produce.
+  unsigned int maxOutput( unsigned int inFrames ) const;
+
+  //! Returns the most input frames inputFrames() can ask for to produce \c outFrames frames.
+  unsigned int maxInput( unsigned int outFrames ) const;
+
+  //! Returns the input frames needed before the next \c outFrames output frames can be produced.
+  unsigned int inputFrames( unsigned int outFrames ) const;
+
+  //! Converts interleaved float frames.
+  /*!
+    All \c inFrames frames of \c in are taken, and up to \c maxOut
+    frames are written to \c out.  Input the output frames do not
+    reach yet is kept for the next call.  Returns the number of frames
+    written.
+  */
+  unsigned int process( float *out, unsigned int maxOut, const float *in, unsigned int inFrames );
+
+  //! Makes room for calls with up to \c inFrames input frames, so that process() need not allocate.
+  void reserve( unsigned int inFrames );
+
+  //! Forgets the input seen so far, as if the resampler were new.
+  void reset( void );
+
+  //! Returns the delay of the filters, in input frames.
+  unsigned int latency( void ) const { return taps_ / 2; };
+
+  //! Returns a description of the filters, for example "medium, 48 taps, 160 phases, sse2".
+  std::string name( void ) const;
+
+ protected:
+
+  typedef float (*DotFunction)( const float *h, const float *x, unsigned int taps );
+
+  unsigned int up_, down_;         // The rate ratio, L / M, in lowest terms.
+  unsigned int channels_;
+  unsigned int taps_;              // Taps of each phase filter, a multiple of 8.
+  unsigned int phases_;            // Phase filters in the table.
+  bool interpolate_;               // Interpolate between phases (when L is large).
+  RtAudioResampleQuality quality_;
+  std::vector<float> filters_;     // phases_ (+ 1 if interpolating) filters of taps_ coefficients.
+  std::vector<float> scratch_;     // An interpolated filter.
+  std::vector<float> history_;     // Per-channel input frames, each channel capacity_ long.
+  unsigned int capacity_;
+  unsigned int frames_;            // Frames of input in the history.
+  unsigned int position_;          // First input frame of the next output frame's filter.
+  unsigned int phase_;             // Its position between input frames, in 1 / L.
+  DotFunction dot_;
+  const char *isa_;
+};
+
+#endif
@@ -0,0 +1,270 @@
+//-----------------------------------------------------------------------------
+// name: bank.cpp
+// desc: polyphonic oscillator bank in structure-of-arrays layout (see bank.h).
+//
+//       Lanes may hold different shapes, so every lane computes the sine, saw
+//       and pulse of its phase and keeps the one its shape mask selects. The
+//       saw and pulse pick their side of the width with a mask as well. That
+//       keeps the inner loop free of branches. Unused lanes have zero
+//       amplitude and add nothing.
+//-----------------------------------------------------------------------------
+#include "bank.h"
+#include "oscillator.h"
+#include "sine_simd.h"
+#include <stdlib.h>
+#include <string.h>
+
+// scales a phase, offset by half a period and read as signed, into [-0.5, 0.5)
+#define BANK_PHASE_SCALE (1.0f / 4294967296.0f)
+
+// flips the top bit so signed compares order phases like unsigned ones
+#define BANK_HALF 0x80000000u
+
+/* -------------------------voices------------------- */
+
+bool bank_init(OscBank &bank, unsigned int capacity) {
+    capacity = (capacity + BANK_LANES - 1) / BANK_LANES * BANK_LANES;
+
+    // seven voice arrays and the mix, each rounded up to whole cache lines
+    size_t voiceBytes = (capacity * 4 + 63) & ~(size_t) 63;
+    size_t mixBytes = BANK_CHUNK * BANK_LANES * sizeof(float);
+
+    bank.block = malloc(7 * voiceBytes + mixBytes + 63);
+    if (bank.block == NULL) return false;
+
+    char *p = (char *) (((uintptr_t) bank.block + 63) & ~(uintptr_t) 63);
+    memset(p, 0, 7 * voiceBytes);
+    bank.phase = (uint32_t *) p;
+    bank.inc = (uint32_t *) (p + voiceBytes);
+    bank.amp = (float *) (p + 2 * voiceBytes);
+    bank.shape = (int32_t *) (p + 3 * voiceBytes);
+    bank.width = (uint32_t *) (p + 4 * voiceBytes);
+    bank.rise = (float *) (p + 5 * voiceBytes);
+    bank.fall = (float *) (p + 6 * voiceBytes);
+    bank.mix = (float *) (p + 7 * voiceBytes);
+
+    bank.count = 0;
+    bank.capacity = capacity;
+    return true;
+}
+
+void bank_free(OscBank &bank) {
+    free(bank.block);
+    bank.block = NULL;
+    bank.count = 0;
+    bank.capacity = 0;
+}
+
+bool bank_copy(OscBank &dst, const OscBank &src) {
+    if (!bank_init(dst, src.capacity)) return false;
+
+    size_t bytes = src.capacity * 4;
+    memcpy(dst.phase, src.phase, bytes);
+    memcpy(dst.inc, src.inc, bytes);
+    memcpy(dst.amp, src.amp, bytes);
+    memcpy(dst.shape, src.shape, bytes);
+    memcpy(dst.width, src.width, bytes);
+    memcpy(dst.rise, src.rise, bytes);
+    memcpy(dst.fall, src.fall, bytes);
+    dst.count = src.count;
+    return true;
+}
+
+int bank_add(OscBank &bank, uint32_t inc, float amp, int shape, double width) {
+    if (bank.count == bank.capacity) return -1;
+
+    // the same duty cycle and slopes as osc_set_width
+    unsigned int v = bank.count++;
+    bank.phase[v] = 0;
+    bank.inc[v] = inc;
+    bank.amp[v] = amp;
+    bank.shape[v] = shape;
+    bank.width[v] = osc_phase(width);
+    bank.rise[v] = (float) (2.0 / width);
+    bank.fall[v] = (float) (2.0 / (1.0 - width));
+    return v;
+}
+
+void bank_remove(OscBank &bank, unsigned int voice) {
+    if (voice >= bank.count) return;
+
+    unsigned int last = --bank.count;
+    bank.phase[voice] = bank.phase[last];
+    bank.inc[voice] = bank.inc[last];
+    bank.amp[voice] = bank.amp[last];
+    bank.shape[voice] = bank.shape[last];
+    bank.width[voice] = bank.width[last];
+    bank.rise[voice] = bank.rise[last];
+    bank.fall[voice] = bank.fall[last];
+
+    // the freed slot may still be read as part of a lane group
+    bank.amp[last] = 0;
+    bank.inc[last] = 0;
+}
+
+/* -------------------------scalar------------------- */
+
+#if !defined(CPU_SSE2)
+
+static void bank_group_scalar(OscBank &bank, unsigned int v, float *mix, unsigned int numFrames) {
+    for (int k = 0; k < BANK_LANES; k++) {
+        uint32_t phase = bank.phase[v + k];
+        uint32_t inc = bank.inc[v + k];
+        float amp = bank.amp[v + k];
+        int shape = bank.shape[v + k];
+        uint32_t width = bank.width[v + k];
+        float rise = bank.rise[v + k];
+        float fall = bank.fall[v + k];
+
+        for (unsigned int i = 0; i < numFrames; i++, phase += inc) {
+            float pos = (int32_t) (phase ^ BANK_HALF) * BANK_PHASE_SCALE + 0.5f;
+            float s;
+            if (shape == BANK_SINE) s = sine_polyf(sine_fold(phase) * (float) SINE_RAD);
+            else if (shape == BANK_SAW) s = phase < width ? rise * pos : fall * (1.0f - pos);
+            else s = phase < width ? 1.0f : -1.0f;
+            mix[i * BANK_LANES + k] += amp * s;
+        }
+        bank.phase[v + k] = phase;
+    }
+}
+
+#endif
+
+/* --------------------------SSE2-------------------- */
+
+#if defined(CPU_SSE2)
+
+// renders lanes v to v + 3 into the half of the mix that starts at column h
+static void bank_group_sse2(OscBank &bank, unsigned int v, int h, float *mix, unsigned int numFrames) {
+    __m128i phase = _mm_load_si128((const __m128i *) (bank.phase + v));
+    __m128i inc = _mm_load_si128((const __m128i *) (bank.inc + v));
+    __m128 amp = _mm_load_ps(bank.amp + v);
+    __m128i shape = _mm_load_si128((const __m128i *) (bank.shape + v));
+    __m128 rise = _mm_load_ps(bank.rise + v);
+    __m128 fall = _mm_load_ps(bank.fall + v);
+
+    __m128 isSine = _mm_castsi128_ps(_mm_cmpeq_epi32(shape, _mm_set1_epi32(BANK_SINE)));
+    __m128 isSaw = _mm_castsi128_ps(_mm_cmpeq_epi32(shape, _mm_set1_epi32(BANK_SAW)));
+    __m128 isPulse = _mm_castsi128_ps(_mm_cmpeq_epi32(shape, _mm_set1_epi32(BANK_PULSE)));
+
+    __m128 rad = _mm_set1_ps((float) SINE_RAD);
+    __m128 phaseScale = _mm_set1_ps(BANK_PHASE_SCALE);
+    __m128i half = _mm_set1_epi32((int) BANK_HALF);
+    __m128i width = _mm_xor_si128(_mm_load_si128((const __m128i *) (bank.width + v)), half);
+    __m128 oneHalf = _mm_set1_ps(0.5f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+
+    mix += h;
+    for (unsigned int i = 0; i < numFrames; i++, mix += BANK_LANES) {
+        __m128 sine = sine_polyf_sse2(_mm_mul_ps(_mm_cvtepi32_ps(sine_fold_sse2(phase)), rad));
+
+        // all ones while the phase is below the width
+        __m128i biased = _mm_xor_si128(phase, half);
+        __m128 left = _mm_castsi128_ps(_mm_cmplt_epi32(biased, width));
+
+        __m128 pos = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(biased), phaseScale), oneHalf);
+        __m128 saw = _mm_or_ps(_mm_and_ps(left, _mm_mul_ps(rise, pos)),
+                               _mm_andnot_ps(left, _mm_mul_ps(fall, _mm_sub_ps(one, pos))));
+        __m128 pulse = _mm_sub_ps(_mm_and_ps(left, two), one);
+
+        __m128 s = _mm_or_ps(_mm_and_ps(isSine, sine),
+                   _mm_or_ps(_mm_and_ps(isSaw, saw), _mm_and_ps(isPulse, pulse)));
+        _mm_store_ps(mix, _mm_add_ps(_mm_load_ps(mix), _mm_mul_ps(amp, s)));
+
+        phase = _mm_add_epi32(phase, inc);
+    }
+
+    _mm_store_si128((__m128i *) (bank.phase + v), phase);
+}
+
+#endif
+
+/* --------------------------AVX2-------------------- */
+
+#if defined(CPU_AVX2)
+
+CPU_AVX2_TARGET
+static void bank_group_avx2(OscBank &bank, unsigned int v, float *mix, unsigned int numFrames) {
+    __m256i phase = _mm256_load_si256((const __m256i *) (bank.phase + v));
+    __m256i inc = _mm256_load_si256((const __m256i *) (bank.inc + v));
+    __m256 amp = _mm256_load_ps(bank.amp + v);
+    __m256i shape = _mm256_load_si256((const __m256i *) (bank.shape + v));
+    __m256 rise = _mm256_load_ps(bank.rise + v);
+    __m256 fall = _mm256_load_ps(bank.fall + v);
+
+    __m256 isSine = _mm256_castsi256_ps(_mm256_cmpeq_epi32(shape, _mm256_set1_epi32(BANK_SINE)));
+    __m256 isSaw = _mm256_castsi256_ps(_mm256_cmpeq_epi32(shape, _mm256_set1_epi32(BANK_SAW)));
+    __m256 isPulse = _mm256_castsi256_ps(_mm256_cmpeq_epi32(shape, _mm256_set1_epi32(BANK_PULSE)));
+
+    __m256 rad = _mm256_set1_ps((float) SINE_RAD);
+    __m256 phaseScale = _mm256_set1_ps(BANK_PHASE_SCALE);
+    __m256i half = _mm256_set1_epi32((int) BANK_HALF);
+    __m256i width = _mm256_xor_si256(_mm256_load_si256((const __m256i *) (bank.width + v)), half);
+    __m256 oneHalf = _mm256_set1_ps(0.5f);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 two = _mm256_set1_ps(2.0f);
+
+    for (unsigned int i = 0; i < numFrames; i++, mix += BANK_LANES) {
+        __m256 sine = sine_polyf_avx2(_mm256_mul_ps(_mm256_cvtepi32_ps(sine_fold_avx2(phase)), rad));
+
+        __m256i biased = _mm256_xor_si256(phase, half);
+        __m256 left = _mm256_castsi256_ps(_mm256_cmpgt_epi32(width, biased));
+
+        __m256 pos = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(biased), phaseScale), oneHalf);
+        __m256 saw = _mm256_blendv_ps(_mm256_mul_ps(fall, _mm256_sub_ps(one, pos)),
+                                      _mm256_mul_ps(rise, pos), left);
+        __m256 pulse = _mm256_sub_ps(_mm256_and_ps(left, two), one);
+
+        __m256 s = _mm256_or_ps(_mm256_and_ps(isSine, sine),
+                   _mm256_or_ps(_mm256_and_ps(isSaw, saw), _mm256_and_ps(isPulse, pulse)));
+        _mm256_store_ps(mix, _mm256_add_ps(_mm256_load_ps(mix), _mm256_mul_ps(amp, s)));
+
+        phase = _mm256_add_epi32(phase, inc);
+    }
+
+    _mm256_store_si256((__m256i *) (bank.phase + v), phase);
+}
+
+#endif
+
+/* --------------------------render------------------ */
+
+void bank_accumulate(OscBank &bank, unsigned int first, unsigned int last, float *mix,
+                     double *out, unsigned int numFrames) {
+#if defined(CPU_AVX2)
+    bool avx2 = cpu_has_avx2();
+#endif
+    if (last > bank.count) last = bank.count;
+
+    while (numFrames > 0) {
+        unsigned int n = numFrames < BANK_CHUNK ? numFrames : BANK_CHUNK;
+        memset(mix, 0, n * BANK_LANES * sizeof(float));
+
+        for (unsigned int v = first; v < last; v += BANK_LANES) {
+#if defined(CPU_AVX2)
+            if (avx2) { bank_group_avx2(bank, v, mix, n); continue; }
+#endif
+#if defined(CPU_SSE2)
+            bank_group_sse2(bank, v, 0, mix, n);
+            bank_group_sse2(bank, v + 4, 4, mix, n);
+#else
+            bank_group_scalar(bank, v, mix, n);
+#endif
+        }
+
+        // sum the lanes of every frame
+        for (unsigned int i = 0; i < n; i++) {
+            const float *m = mix + i * BANK_LANES;
+            out[i] += ((m[0] + m[1]) + (m[2] + m[3])) + ((m[4] + m[5]) + (m[6] + m[7]));
+        }
+
+        out += n;
+        numFrames -= n;
+    }
+}
+
+void bank_render(OscBank &bank, double *out, unsigned int numFrames) {
+    memset(out, 0, numFrames * sizeof(double));
+    bank_accumulate(bank, 0, bank.count, bank.mix, out, numFrames);
+}
@@ -0,0 +1,116 @@
+//-----------------------------------------------------------------------------
+// name: bank.h
+// desc: polyphonic oscillator bank in structure-of-arrays layout.
+//
+//       Phase, increment, amplitude, shape and duty cycle of every voice live
+//       in their own aligned arrays, so eight voices load into one AVX2 register (two
+//       SSE2 registers) and are rendered side by side. Each lane accumulates
+//       into a small per-frame mix that is summed across lanes once per block.
+//       All memory is taken by bank_init. Adding and removing voices only
+//       writes array slots, so both are safe to call without allocating.
+//-----------------------------------------------------------------------------
+#ifndef __BANK_H
+#define __BANK_H
+
+#include <stdint.h>
+
+// voices rendered side by side; the arrays are padded to a multiple of this
+#define BANK_LANES 8
+
+// frames rendered per pass through the voices
+#define BANK_CHUNK 256
+
+// shapes a bank voice can take
+enum BankShape {
+    BANK_SINE,    // sine
+    BANK_SAW,     // rises from 0 to 2 until the width, then falls back (like osc_saw)
+    BANK_PULSE    // +1 until the width, -1 for the rest of the period (like osc_pulse)
+};
+
+struct OscBank {
+
+    // per-voice state, one array each, 64-byte aligned
+    uint32_t *phase;
+    uint32_t *inc;
+    float *amp;
+    int32_t *shape;
+
+    // duty cycle scaled like the phase, and the saw's slopes on either side of it
+    uint32_t *width;
+    float *rise;
+    float *fall;
+
+    // voices in use (always the first count slots) and slots available
+    unsigned int count;
+    unsigned int capacity;
+
+    // BANK_CHUNK frames of BANK_LANES partial sums
+    float *mix;
+
+    // block returned by malloc, freed by bank_free
+    void *block;
+};
+
+/*
+ * @function bank_init Allocates a bank (the only allocation it ever makes).
+ * @param bank Bank to set up, empty afterwards.
+ * @param capacity Most voices the bank will hold.
+ * @return False if the memory could not be allocated.
+ */
+bool bank_init(OscBank &bank, unsigned int capacity);
+
+/*
+ * @function bank_free Releases the memory of a bank.
+ * @param bank Bank to release.
+ */
+void bank_free(OscBank &bank);
+
+/*
+ * @function bank_copy Allocates a bank holding the same voices, in the same state, as another.
+ * @param dst Bank to set up.
+ * @param src Bank to copy.
+ * @return False if the memory could not be allocated.
+ */
+bool bank_copy(OscBank &dst, const OscBank &src);
+
+/*
+ * @function bank_add Starts a new voice at the beginning of its period.
+ * @param bank Bank to add to.
+ * @param inc Accumulator increment per frame (see osc_phase).
+ * @param amp Linear amplitude.
+ * @param shape One of the BankShape values.
+ * @param width Duty cycle of the saw and pulse shapes, in the range (0, 1).
+ * @return Index of the voice, or -1 if the bank is full.
+ */
+int bank_add(OscBank &bank, uint32_t inc, float amp, int shape, double width);
+
+/*
+ * @function bank_remove Stops a voice. The last voice moves into its slot, so indexes
+            above the removed one are not stable.
+ * @param bank Bank to remove from.
+ * @param voice Index of the voice to stop.
+ */
+void bank_remove(OscBank &bank, unsigned int voice);
+
+/*
+ * @function bank_accumulate Adds the mix of a range of voices to a buffer. Ranges that
+            do not overlap may be rendered by different threads at the same time.
+ * @param bank Bank to render. Voices in the range advance by numFrames.
+ * @param first First voice of the range (a multiple of BANK_LANES).
+ * @param last One past the last voice of the range.
+ * @param mix Scratch space of BANK_CHUNK * BANK_LANES floats, 64-byte aligned.
+ * @param out Mono buffer of numFrames samples the mix is added to.
+ * @param numFrames Number of frames to render.
+ */
+void bank_accumulate(OscBank &bank, unsigned int first, unsigned int last, float *mix,
+                     double *out, unsigned int numFrames);
+
+/*
+ * @function bank_render Renders the mix of all voices.
+ * @param bank Bank to render. Every voice advances by numFrames.
+ * @param out Mono output buffer of numFrames samples (overwritten).
+ * @param numFrames Number of frames to render.
+ */
+void bank_render(OscBank &bank, double *out, unsigned int numFrames);
+
+#endif
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+// name: alsa_mmap.cpp
+// desc: cost per period of the two ways RtApiAlsa hands a playback period to
+//       alsa-lib: converting into a buffer of its own and copying it with
+//       snd_pcm_writei, or converting straight into the ring buffer between
+//       snd_pcm_mmap_begin and snd_pcm_mmap_commit (RTAUDIO_ALSA_MMAP).
+//       The "null" PCM discards everything as soon as it is committed, and
+//       the "file" PCM writes it to /dev/null as well, so no sound card or
+//       real-time pacing is involved. Needs alsa-lib (-lasound).
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../RtConvert.h"
+#include <alsa/asoundlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SRATE 48000
+#define FRAMES 256
+#define MAX_CHANNELS 64
+
+static const char *pcms[] = { "null", "file:FILE=/dev/null,FORMAT=raw" };
+static const unsigned int counts[] = { 2, 8, 64 };
+static const RtAudioFormat formats[] = { RTAUDIO_SINT16, RTAUDIO_SINT32 };
+static const snd_pcm_format_t alsaFormats[] = { SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S32 };
+static const char *names[] = { "s16", "s32" };
+
+// one period of float32 user samples, as the callback fills it
+static float user[FRAMES * MAX_CHANNELS];
+
+struct Transfer {
+    snd_pcm_t *pcm;
+    RtConvertPlan plan;
+    bool mmap;
+    char *buffer;
+    int errors;
+
+    void operator()() {
+        if (!mmap) {
+            plan.function(plan, buffer, (const char *) user, FRAMES);
+            if (snd_pcm_writei(pcm, buffer, FRAMES) != FRAMES) recover();
+            return;
+        }
+
+        // the same steps as RtApiAlsa::mapPeriod and commitPeriod
+        if (snd_pcm_avail_update(pcm) < FRAMES) {
+            recover();
+            return;
+        }
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t first, frames = FRAMES;
+        if (snd_pcm_mmap_begin(pcm, &areas, &first, &frames) < 0) {
+            recover();
+            return;
+        }
+        if (frames < FRAMES) {
+            // the period wraps around the ring: RtApiAlsa copies it with a write instead
+            snd_pcm_mmap_commit(pcm, first, 0);
+            plan.function(plan, buffer, (const char *) user, FRAMES);
+            if (snd_pcm_mmap_writei(pcm, buffer, FRAMES) != FRAMES) recover();
+            return;
+        }
+        char *ring = (char *) areas[0].addr + (areas[0].first + first * areas[0].step) / 8;
+        plan.function(plan, ring, (const char *) user, FRAMES);
+        if (snd_pcm_mmap_commit(pcm, first, FRAMES) != FRAMES) recover();
+        else if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED) snd_pcm_start(pcm);
+    }
+
+    void recover() {
+        errors++;
+        snd_pcm_prepare(pcm);
+    }
+};
+
+/*
+ * @function open_pcm Opens a playback PCM for interleaved periods of FRAMES frames.
+ * @return The PCM, or NULL (with a message) if it could not be set up.
+ */
+static snd_pcm_t *open_pcm(const char *name, snd_pcm_format_t format, unsigned int channels, bool mmap) {
+    snd_pcm_t *pcm;
+    int result = snd_pcm_open(&pcm, name, SND_PCM_STREAM_PLAYBACK, 0);
+    if (result < 0) {
+        fprintf(stderr, "alsa_mmap: cannot open %s: %s\n", name, snd_strerror(result));
+        return 0;
+    }
+    result = snd_pcm_set_params(pcm, format, mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_RW_INTERLEAVED,
+                                channels, SRATE, 0, 4 * FRAMES * 1000000 / SRATE);
+    if (result < 0) {
+        fprintf(stderr, "alsa_mmap: cannot set up %s: %s\n", name, snd_strerror(result));
+        snd_pcm_close(pcm);
+        return 0;
+    }
+    return pcm;
+}
+
+int main() {
+    static Transfer transfer;
+    int count = 2000;
+
+    for (int i = 0; i < FRAMES * MAX_CHANNELS; i++) user[i] = (float) ((i * 37) % 200) * 0.005f - 0.5f;
+    transfer.buffer = (char *) malloc(FRAMES * MAX_CHANNELS * 4);
+
+    printf("ALSA playback transfers, us per period of %d float32 frames (%s)\n", FRAMES, rtConvertIsa());
+    printf("%-6s %-8s %9s %10s %10s %8s\n", "pcm", "device", "channels", "read/write", "mmap", "saved");
+    for (int p = 0; p < 2; p++) {
+        for (int f = 0; f < 2; f++) {
+            for (int c = 0; c < 3; c++) {
+                double best[2];
+                bool ok = true;
+                for (int mmap = 0; mmap < 2 && ok; mmap++) {
+                    snd_pcm_t *pcm = open_pcm(pcms[p], alsaFormats[f], counts[c], mmap);
+                    if (!pcm) {
+                        ok = false;
+                        break;
+                    }
+
+                    RtConvertPlan &plan = transfer.plan;
+                    plan = RtConvertPlan();
+                    plan.channels = counts[c];
+                    plan.inStride = plan.outStride = 1;
+                    plan.inJump = plan.outJump = counts[c];
+                    rtConvertPrepare(plan, RTAUDIO_FLOAT32, formats[f]);
+
+                    transfer.pcm = pcm;
+                    transfer.mmap = mmap;
+                    transfer.errors = 0;
+                    best[mmap] = bench_best(transfer, count);
+                    if (transfer.errors)
+                        fprintf(stderr, "alsa_mmap: %d transfer(s) to %s failed\n", transfer.errors, pcms[p]);
+
+                    snd_pcm_drop(pcm);
+                    snd_pcm_close(pcm);
+                }
+                if (!ok) continue;
+                printf("%-6s %-8s %9u %10.2f %10.2f %7.0f%%\n", p ? "file" : "null", names[f], counts[c],
+                       best[0] * 1e6, best[1] * 1e6, 100 * (1 - best[1] / best[0]));
+            }
+        }
+    }
+
+    free(transfer.buffer);
+    return 0;
+}
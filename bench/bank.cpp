@@ -0,0 +1,94 @@
+//-----------------------------------------------------------------------------
+// name: bank.cpp
+// desc: how many voices fit in one 512 frame callback at 48kHz on one core,
+//       for the oscillator bank and for the same voices summed one
+//       Oscillator at a time. A voice fits if the whole bank renders within
+//       the callback's duration; the count is found from the time per voice
+//       of a bank of VOICES, so it is the ceiling with no other work to do.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../bank.h"
+#include "../oscillator.h"
+#include <stdio.h>
+
+#define SRATE 48000
+#define FRAMES 512
+#define VOICES 1024
+#define WIDTH 0.3
+
+static const char *names[] = { "sine", "saw", "pulse", "mixed" };
+
+// shape of voice v for test t (mixed cycles through the three)
+static int shape_of(int t, int v) {
+    return t < 3 ? t : v % 3;
+}
+
+// frequency of voice v: spread over a few octaves, like a chord cluster
+static double freq_of(int v) {
+    return 55.0 * pow(2.0, (v % 64) / 12.0);
+}
+
+struct Bank {
+    OscBank bank;
+    double out[FRAMES];
+
+    void operator()() {
+        bank_render(bank, out, FRAMES);
+        bench_sink = out[FRAMES - 1];
+    }
+};
+
+// one Oscillator per voice, rendered and summed one after another
+struct Single {
+    int test;
+    Oscillator osc[VOICES];
+    double out[FRAMES];
+
+    void operator()() {
+        for (int i = 0; i < FRAMES; i++) out[i] = 0;
+        for (int v = 0; v < VOICES; v++) {
+            Oscillator o = osc[v];
+            int shape = shape_of(test, v);
+            for (int i = 0; i < FRAMES; i++) {
+                double s = shape == BANK_SINE ? osc_sine(o) : shape == BANK_SAW ? osc_saw(o) : osc_pulse(o);
+                out[i] += 0.001 * s;
+                osc_tick(o);
+            }
+            osc[v].phase = o.phase;
+        }
+        bench_sink = out[FRAMES - 1];
+    }
+};
+
+int main() {
+    static Bank bank;
+    static Single single;
+    double callback = (double) FRAMES / SRATE;
+    int count = 20;
+
+    if (!bank_init(bank.bank, VOICES)) {
+        fprintf(stderr, "bank: out of memory\n");
+        return 1;
+    }
+
+    printf("voices per %d frame callback at %d Hz on one core (%.2f ms)\n", FRAMES, SRATE, callback * 1e3);
+    printf("%-8s %12s %12s %12s %12s\n", "shape", "single ns", "bank ns", "single", "bank");
+    for (int t = 0; t < 4; t++) {
+        while (bank.bank.count) bank_remove(bank.bank, bank.bank.count - 1);
+        single.test = t;
+        for (int v = 0; v < VOICES; v++) {
+            osc_init(single.osc[v], freq_of(v), WIDTH, SRATE);
+            bank_add(bank.bank, single.osc[v].inc, 0.001f, shape_of(t, v), WIDTH);
+        }
+
+        // seconds per voice for one callback
+        double a = bench_best(single, count) / VOICES;
+        double b = bench_best(bank, count) / VOICES;
+        printf("%-8s %12.2f %12.2f %12.0f %12.0f\n", names[t], a / FRAMES * 1e9, b / FRAMES * 1e9,
+               callback / a, callback / b);
+    }
+    printf("(ns per voice per frame, then voices that fit)\n");
+
+    bank_free(bank.bank);
+    return 0;
+}
@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// name: bench.h
+// desc: timing helpers shared by the benchmarks in bench/.
+//
+//       Every measurement runs its operation in rounds of a fixed count and
+//       keeps the fastest round, so a round that was interrupted by the
+//       scheduler or another process does not skew the result.
+//-----------------------------------------------------------------------------
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <time.h>
+
+// rounds every measurement is repeated for
+#define BENCH_ROUNDS 7
+
+// keeps a result alive so the compiler cannot drop the work that made it
+static volatile double bench_sink;
+
+/*
+ * @function bench_now Reads the monotonic clock.
+ * @return Seconds since an arbitrary point.
+ */
+inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * @function bench_best Times an operation.
+ * @param op Functor called as op() count times per round.
+ * @param count Calls per round.
+ * @return Seconds per call in the fastest of BENCH_ROUNDS rounds.
+ */
+template <class Op>
+double bench_best(Op &op, int count) {
+    double best = 1e30;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        double start = bench_now();
+        for (int k = 0; k < count; k++) op();
+        double elapsed = bench_now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best / count;
+}
+
+#endif
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// name: blep.cpp
+// desc: ns per frame of the band-limited saw and pulse from blep.h against
+//       the naive shapes they correct. The corrections only touch the
+//       samples next to an edge, so their cost grows with the frequency.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../blep.h"
+#include <stdio.h>
+
+#define SRATE 48000
+#define FRAMES 512
+#define WIDTH 0.5
+
+struct Naive {
+    bool pulse;
+    Oscillator osc;
+    double mono[FRAMES];
+
+    void operator()() {
+        Oscillator o = osc;
+        if (pulse) {
+            for (int i = 0; i < FRAMES; i++) { mono[i] = osc_pulse(o); osc_tick(o); }
+        } else {
+            for (int i = 0; i < FRAMES; i++) { mono[i] = osc_saw(o); osc_tick(o); }
+        }
+        osc.phase = o.phase;
+        bench_sink = mono[FRAMES - 1];
+    }
+};
+
+struct Limited {
+    bool pulse;
+    Oscillator osc;
+    double mono[FRAMES];
+
+    void operator()() {
+        if (pulse) blep_pulse(osc, mono, FRAMES);
+        else blep_saw(osc, mono, FRAMES);
+        bench_sink = mono[FRAMES - 1];
+    }
+};
+
+int main() {
+    static Naive naive;
+    static Limited limited;
+    static const double freqs[] = { 100.0, 1000.0, 10000.0 };
+    int count = 2000;
+
+    printf("band-limited shapes, ns per frame (%d frame blocks at %d Hz)\n", FRAMES, SRATE);
+    printf("%-6s %9s %10s %10s\n", "shape", "freq", "naive", "blep");
+    for (int pulse = 0; pulse < 2; pulse++) {
+        for (int f = 0; f < 3; f++) {
+            naive.pulse = limited.pulse = pulse;
+            osc_init(naive.osc, freqs[f], WIDTH, SRATE);
+            osc_init(limited.osc, freqs[f], WIDTH, SRATE);
+            double a = bench_best(naive, count) / FRAMES * 1e9;
+            double b = bench_best(limited, count) / FRAMES * 1e9;
+            printf("%-6s %9.0f %10.2f %10.2f\n", pulse ? "pulse" : "saw", freqs[f], a, b);
+        }
+    }
+    return 0;
+}
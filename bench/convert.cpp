@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------------
+// name: convert.cpp
+// desc: throughput of the sample format conversions RtApi::convertBuffer
+//       makes, for every pair of formats, on interleaved stereo buffers of
+//       512 frames (the contiguous kernels). GB/s counts the bytes read and
+//       written together. The kernels' instruction set is printed first.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../RtConvert.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAMES 512
+#define CHANNELS 2
+
+static const RtAudioFormat formats[] = { RTAUDIO_SINT8, RTAUDIO_SINT16, RTAUDIO_SINT24_PACKED,
+                                         RTAUDIO_SINT24, RTAUDIO_SINT32, RTAUDIO_FLOAT32,
+                                         RTAUDIO_FLOAT64 };
+static const char *names[] = { "s8", "s16", "s24p", "s24", "s32", "f32", "f64" };
+
+struct Convert {
+    RtConvertPlan plan;
+    char *in;
+    char *out;
+
+    void operator()() {
+        plan.function( plan, out, in, FRAMES );
+        bench_sink = out[0];
+    }
+};
+
+int main() {
+    static Convert convert;
+    int count = 20000;
+
+    // largest sample is 8 bytes; fill the input with small values every format reads as in range
+    convert.in = (char *) calloc( FRAMES * CHANNELS, 8 );
+    convert.out = (char *) calloc( FRAMES * CHANNELS, 8 );
+    for ( int i = 0; i < FRAMES * CHANNELS * 8; i++ ) convert.in[i] = (char) ( i * 7 % 64 );
+
+    printf( "format conversion, GB/s, %d frames of %d interleaved channels (%s)\n",
+            FRAMES, CHANNELS, rtConvertIsa() );
+    printf( "%-6s", "in\\out" );
+    for ( int o = 0; o < 7; o++ ) printf( " %7s", names[o] );
+    printf( "\n" );
+
+    for ( int i = 0; i < 7; i++ ) {
+      printf( "%-6s", names[i] );
+      for ( int o = 0; o < 7; o++ ) {
+        RtConvertPlan &plan = convert.plan;
+        plan = RtConvertPlan();
+        plan.channels = CHANNELS;
+        plan.inStride = plan.outStride = 1;
+        plan.inJump = plan.outJump = CHANNELS;
+        rtConvertPrepare( plan, formats[i], formats[o] );
+
+        double s = bench_best( convert, count );
+        double bytes = (double) FRAMES * CHANNELS * ( plan.inBytes + plan.outBytes );
+        printf( " %7.2f", bytes / s * 1e-9 );
+      }
+      printf( "\n" );
+    }
+
+    free( convert.in );
+    free( convert.out );
+    return 0;
+}
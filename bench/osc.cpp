@@ -0,0 +1,98 @@
+//-----------------------------------------------------------------------------
+// name: osc.cpp
+// desc: ns per frame of the phase-accumulator oscillator against the loop it
+//       replaced, which rebuilt every sample from the sample count g_t with
+//       fmod. Both are timed right after start-up and after ten days of
+//       streaming, where the old loop's fmod and sin() see a huge argument.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../oscillator.h"
+#include "../noise.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SRATE 44100
+#define FRAMES 512
+#define FREQ 440.0
+#define WIDTH 0.5
+#define PIE 3.14159265358979
+
+static const char *names[] = { "sine", "saw", "pulse", "noise", "impulse" };
+
+// the per-sample body of the old audio_callback, for signal sig
+struct OldLoop {
+    int sig;
+    double t;
+    double mono[FRAMES];
+
+    void operator()() {
+        double period = 1 / FREQ;
+        double rmdr = period - (WIDTH * period);
+        double left_sample_step = 2.0 / (WIDTH * period);
+        double right_sample_step = 2.0 / rmdr;
+
+        for (int i = 0; i < FRAMES; i++) {
+            double sample_pos = fmod(t / SRATE, period);
+            double s;
+            switch(sig) {
+                case 1: s = sin(2 * PIE * FREQ * t / SRATE); break;
+                case 2: s = sample_pos <= WIDTH * period ? left_sample_step * sample_pos
+                                                         : right_sample_step * (period - sample_pos); break;
+                case 3: s = sample_pos <= WIDTH * period ? 1.0 : -1.0; break;
+                case 4: s = (rand() % 100) / 10; break;
+                default: s = fmod(t, round(period * SRATE)) == 0 ? 1.0 : 0.0; break;
+            }
+            mono[i] = s;
+            t += 1.0;
+        }
+        bench_sink = mono[FRAMES - 1];
+    }
+};
+
+// the same block from the phase accumulator
+struct NewLoop {
+    int sig;
+    Oscillator osc;
+    NoiseState noise;
+    double mono[FRAMES];
+
+    void operator()() {
+        Oscillator o = osc;
+        switch(sig) {
+            case 1: for (int i = 0; i < FRAMES; i++) { mono[i] = osc_sine(o); osc_tick(o); } break;
+            case 2: for (int i = 0; i < FRAMES; i++) { mono[i] = osc_saw(o); osc_tick(o); } break;
+            case 3: for (int i = 0; i < FRAMES; i++) { mono[i] = osc_pulse(o); osc_tick(o); } break;
+            case 4: noise_white(noise, mono, FRAMES); break;
+            default: for (int i = 0; i < FRAMES; i++) { mono[i] = osc_impulse(o); osc_tick(o); } break;
+        }
+        osc.phase = o.phase;
+        bench_sink = mono[FRAMES - 1];
+    }
+};
+
+int main() {
+    // sample counts right after start-up and ten days in
+    double starts[2] = { 0.0, 10.0 * 86400 * SRATE };
+
+    printf("oscillator core, ns per frame (%d-frame blocks at %d Hz)\n", FRAMES, SRATE);
+    printf("%-8s %12s %12s %12s %12s\n", "signal", "old 0s", "old 10d", "new 0s", "new 10d");
+
+    for (int sig = 1; sig <= 5; sig++) {
+        double ns[4];
+        for (int k = 0; k < 2; k++) {
+            OldLoop old;
+            old.sig = sig;
+            old.t = starts[k];
+            ns[k] = bench_best(old, 200) / FRAMES * 1e9;
+
+            NewLoop cur;
+            cur.sig = sig;
+            osc_init(cur.osc, FREQ, WIDTH, SRATE);
+            cur.osc.phase = osc_phase(FREQ * starts[k] / SRATE);
+            noise_seed(cur.noise, 1, 0);
+            ns[2 + k] = bench_best(cur, 200) / FRAMES * 1e9;
+        }
+        printf("%-8s %12.2f %12.2f %12.2f %12.2f\n", names[sig - 1], ns[0], ns[1], ns[2], ns[3]);
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------
+// name: pool.cpp
+// desc: scaling of the voice pool from one thread to one per core, rendering
+//       the same bank in 512 frame periods. The pool is started with a
+//       sample rate of 1Hz so no period counts as late: the deadline would
+//       otherwise take participants away in the middle of the measurement.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../pool.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+
+#define SRATE 48000
+#define FRAMES 512
+#define VOICES 8192
+
+struct Render {
+    VoicePool pool;
+    double out[FRAMES];
+
+    void operator()() {
+        pool_render(pool, out, FRAMES);
+        bench_sink = out[FRAMES - 1];
+    }
+};
+
+int main() {
+    static OscBank bank;
+    static Render render;
+    int cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > POOL_MAX_THREADS) cores = POOL_MAX_THREADS;
+    if (cores < 1) cores = 1;
+
+    if (!bank_init(bank, VOICES)) {
+        fprintf(stderr, "pool: out of memory\n");
+        return 1;
+    }
+    for (int v = 0; v < VOICES; v++)
+        bank_add(bank, (uint32_t) (55.0 * pow(2.0, (v % 64) / 12.0) / SRATE * 4294967296.0),
+                 0.0001f, v % 3, 0.3);
+
+    printf("voice pool, %d voices in %d frame periods, %d core(s) online\n", VOICES, FRAMES, cores);
+    printf("%-8s %12s %10s %10s %10s\n", "threads", "ms/period", "speedup", "per core", "misses");
+    double one = 0;
+    for (int t = 1; t <= cores; t++) {
+        if (!pool_start(render.pool, bank, t, 1.0)) {
+            fprintf(stderr, "pool: could not start %d threads\n", t);
+            bank_free(bank);
+            return 1;
+        }
+        double s = bench_best(render, 50);
+        if (t == 1) one = s;
+        printf("%-8d %12.3f %10.2f %10.2f %10lu\n", t, s * 1e3, one / s, one / s / t,
+               render.pool.stats.misses);
+        pool_stop(render.pool);
+    }
+
+    bank_free(bank);
+    return 0;
+}
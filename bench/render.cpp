@@ -0,0 +1,132 @@
+//-----------------------------------------------------------------------------
+// name: render.cpp
+// desc: the old audio_callback, which switched on the waveform, tested the
+//       --input flag and copied the channels for every frame, against the
+//       specialized render kernels, for 64, 256 and 512 frame buffers of two
+//       channels. The sine kernel uses the libm tier, like the old loop did.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../render.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SRATE 44100
+#define CHANNELS 2
+#define MAX_FRAMES 512
+#define FREQ 440.0
+#define WIDTH 0.5
+#define PIE 3.14159265358979
+
+static const char *names[] = { "sine", "saw", "pulse", "impulse" };
+static const int sigs[] = { 1, 2, 3, 5 };
+
+// the old audio_callback, without its progress print
+struct OldCallback {
+    int sig;
+    bool ring;
+    unsigned int frames;
+    double t;
+    double out[MAX_FRAMES * CHANNELS];
+    double in[MAX_FRAMES * CHANNELS];
+
+    void operator()() {
+        double period = 1 / FREQ;
+        double rmdr = period - (WIDTH * period);
+        double left_sample_step = 2.0 / (WIDTH * period);
+        double right_sample_step = 2.0 / rmdr;
+
+        for (unsigned int i = 0; i < frames; i++) {
+            double sample_pos = fmod(t / SRATE, period);
+            switch(sig) {
+                case 1:
+                    out[i * CHANNELS] = sin(2 * PIE * FREQ * t / SRATE);
+                    break;
+                case 2:
+                    if (sample_pos <= WIDTH * period) out[i * CHANNELS] = left_sample_step * sample_pos;
+                    else out[i * CHANNELS] = right_sample_step * (period - sample_pos);
+                    break;
+                case 3:
+                    if (sample_pos <= WIDTH * period) out[i * CHANNELS] = 1.0;
+                    else if (sample_pos >= WIDTH * period) out[i * CHANNELS] = -1.0;
+                    break;
+                case 5:
+                    out[i * CHANNELS] = fmod(t, round(period * SRATE)) == 0 ? 1.0 : 0.0;
+                    break;
+                default:
+                    return;
+            }
+            if (ring) out[i * CHANNELS] *= in[i * CHANNELS];
+            for (int j = 1; j < CHANNELS; j++)
+                out[i * CHANNELS + j] = out[i * CHANNELS];
+            t += 1.0;
+        }
+        bench_sink = out[0];
+    }
+};
+
+// the kernel sig_gen installs for the same arguments
+struct NewCallback {
+    RenderFunc render;
+    unsigned int frames;
+    Generator gen;
+    double out[MAX_FRAMES * CHANNELS];
+    double in[MAX_FRAMES * CHANNELS];
+
+    void operator()() {
+        render(gen, out, in, frames);
+        bench_sink = out[0];
+    }
+};
+
+template <class Wave>
+RenderFunc pick(bool ring) {
+    if (ring) return &render_block<Wave, true, CHANNELS>;
+    return &render_block<Wave, false, CHANNELS>;
+}
+
+static RenderFunc pick_wave(int sig, bool ring) {
+    switch(sig) {
+        case 1: return pick<SineWave<SINE_EXACT> >(ring);
+        case 2: return pick<SawWave>(ring);
+        case 3: return pick<PulseWave>(ring);
+        default: return pick<ImpulseWave>(ring);
+    }
+}
+
+int main() {
+    static OldCallback old;
+    static NewCallback cur;
+    unsigned int sizes[3] = { 64, 256, 512 };
+
+    for (int i = 0; i < MAX_FRAMES * CHANNELS; i++) old.in[i] = cur.in[i] = 0.5;
+    memset(&cur.gen, 0, sizeof(cur.gen));
+    osc_init(cur.gen.osc, FREQ, WIDTH, SRATE);
+    control_ramp_init(cur.gen.ramp, WIDTH, SRATE);
+
+    printf("audio callback, ns per frame (%d channels at %d Hz)\n", CHANNELS, SRATE);
+    printf("%-8s %-5s %10s %10s %10s %10s %10s %10s\n", "signal", "input",
+           "old 64", "new 64", "old 256", "new 256", "old 512", "new 512");
+
+    for (int w = 0; w < 4; w++) {
+        for (int ring = 0; ring < 2; ring++) {
+            printf("%-8s %-5s", names[w], ring ? "on" : "off");
+            for (int k = 0; k < 3; k++) {
+                int count = 100000 / sizes[k];
+
+                old.sig = sigs[w];
+                old.ring = ring;
+                old.frames = sizes[k];
+                old.t = 0;
+                double a = bench_best(old, count) / sizes[k] * 1e9;
+
+                cur.render = pick_wave(sigs[w], ring);
+                cur.frames = sizes[k];
+                double b = bench_best(cur, count) / sizes[k] * 1e9;
+
+                printf(" %10.2f %10.2f", a, b);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
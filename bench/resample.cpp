@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// name: resample.cpp
+// desc: cost of RtResampler per output frame for every quality preset and a
+//       few common rate pairs, on stereo blocks of 512 input frames. Times
+//       are converted to cycles with the time stamp counter's rate, measured
+//       against the monotonic clock at start-up (x86 only; other CPUs get
+//       ns per frame alone). The TSC ticks at the nominal clock, so turbo
+//       or power saving makes the cycles approximate.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../RtResample.h"
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TSC
+#endif
+
+#define FRAMES 512
+#define CHANNELS 2
+
+static const RtAudioResampleQuality presets[] = { RTAUDIO_RESAMPLE_FAST, RTAUDIO_RESAMPLE_MEDIUM,
+                                                  RTAUDIO_RESAMPLE_BEST };
+static const unsigned int rates[][2] = { { 44100, 48000 }, { 48000, 44100 }, { 48000, 96000 },
+                                         { 96000, 48000 }, { 44100, 96000 } };
+
+struct Process {
+    RtResampler *resampler;
+    float in[FRAMES * CHANNELS];
+    float *out;
+    unsigned int maxOut;
+    double frames, calls;
+
+    void operator()() {
+        frames += resampler->process(out, maxOut, in, FRAMES);
+        calls += 1;
+        bench_sink = out[0];
+    }
+};
+
+// time stamp counter ticks per second, or 0 without one
+static double tsc_rate() {
+#ifdef BENCH_TSC
+    double start = bench_now();
+    unsigned long long t0 = __rdtsc();
+    while (bench_now() - start < 0.2) ;
+    unsigned long long t1 = __rdtsc();
+    return (t1 - t0) / (bench_now() - start);
+#else
+    return 0;
+#endif
+}
+
+int main() {
+    static Process process;
+    double hz = tsc_rate();
+    int count = 500;
+
+    for (int i = 0; i < FRAMES * CHANNELS; i++) process.in[i] = (float) ((i * 37) % 200) * 0.005f - 0.5f;
+
+    printf("resampler, %d channels, %d input frames per call", CHANNELS, FRAMES);
+    if (hz > 0) printf(", TSC at %.2f GHz", hz * 1e-9);
+    printf("\n%-14s %-40s %12s %12s\n", "rates", "filters", "ns/frame", "cycles/frame");
+    for (int r = 0; r < 5; r++) {
+        for (int p = 0; p < 3; p++) {
+            RtResampler resampler(rates[r][0], rates[r][1], CHANNELS, presets[p]);
+            resampler.reserve(FRAMES);
+            process.resampler = &resampler;
+            process.maxOut = resampler.maxOutput(FRAMES);
+            process.out = new float[process.maxOut * CHANNELS];
+            process.frames = process.calls = 0;
+
+            double s = bench_best(process, count);
+            double perFrame = s / (process.frames / process.calls);
+            char pair[32];
+            snprintf(pair, sizeof(pair), "%u>%u", rates[r][0], rates[r][1]);
+            printf("%-14s %-40s %12.2f", pair, resampler.name().c_str(), perFrame * 1e9);
+            if (hz > 0) printf(" %12.1f\n", perFrame * hz);
+            else printf(" %12s\n", "-");
+            delete[] process.out;
+        }
+    }
+    return 0;
+}
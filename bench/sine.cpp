@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// name: sine.cpp
+// desc: throughput of every sine_block tier against a plain sin() loop over
+//       the same phases, and the worst error of each tier against sin(),
+//       found by sweeping 2^24 phases spread across the whole cycle.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../sine.h"
+#include <math.h>
+#include <stdio.h>
+
+#define FRAMES 512
+#define SWEEP (1 << 24)
+#define PIE 3.14159265358979
+
+// 440 Hz at 44.1 kHz
+static const uint32_t INC = (uint32_t) (440.0 / 44100.0 * 4294967296.0);
+
+// reference: one libm sin() per frame
+struct SinLoop {
+    uint32_t phase;
+    double out[FRAMES];
+
+    void operator()() {
+        for (int i = 0; i < FRAMES; i++) {
+            out[i] = sin(2 * PIE * (phase / 4294967296.0));
+            phase += INC;
+        }
+        bench_sink = out[FRAMES - 1];
+    }
+};
+
+struct Tier {
+    SineQuality quality;
+    uint32_t phase;
+    double out[FRAMES];
+
+    void operator()() {
+        sine_block(quality, phase, INC, out, FRAMES);
+        phase += INC * FRAMES;
+        bench_sink = out[FRAMES - 1];
+    }
+};
+
+// worst absolute error against sin() over SWEEP phases, FRAMES at a time
+static double worst_error(SineQuality quality) {
+    static double out[FRAMES];
+    // an odd step that visits SWEEP distinct phases spread over the cycle
+    uint32_t step = (uint32_t) (4294967296.0 / SWEEP) + 1;
+    uint32_t phase = 0;
+    double worst = 0;
+    for (int n = 0; n < SWEEP; n += FRAMES) {
+        sine_block(quality, phase, step, out, FRAMES);
+        for (int i = 0; i < FRAMES; i++) {
+            double e = fabs(out[i] - sin(2 * M_PI * ((uint32_t) (phase + i * step) / 4294967296.0)));
+            if (e > worst) worst = e;
+        }
+        phase += step * FRAMES;
+    }
+    return worst;
+}
+
+int main() {
+    static SinLoop ref;
+    static Tier tier;
+    int count = 2000;
+
+    ref.phase = 0;
+    double base = bench_best(ref, count) / FRAMES * 1e9;
+
+    printf("sine tiers, %d frame blocks\n", FRAMES);
+    printf("%-10s %10s %10s %10s %12s\n", "tier", "ns/frame", "Mframes/s", "speedup", "max error");
+    printf("%-10s %10.2f %10.1f %10.2f %12s\n", "sin()", base, 1e3 / base, 1.0, "-");
+    for (int q = SINE_EXACT; q <= SINE_ROTATION; q++) {
+        tier.quality = (SineQuality) q;
+        tier.phase = 0;
+        double ns = bench_best(tier, count) / FRAMES * 1e9;
+        printf("%-10s %10.2f %10.1f %10.2f %12.3g\n", sine_quality_name((SineQuality) q),
+               ns, 1e3 / ns, base / ns, worst_error((SineQuality) q));
+    }
+    return 0;
+}
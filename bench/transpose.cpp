@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// name: transpose.cpp
+// desc: interleaving and deinterleaving in RtApi::convertBuffer, through the
+//       tiled transposes of RtConvert.cpp, against the loop convertBuffer
+//       used before (a pass over the channel offsets for every frame), in ns
+//       per frame of 512 frame buffers. float32 to float32 is a transpose
+//       alone, int16 to float32 a transpose with a conversion. Channel
+//       counts without a kernel of their own (3, 5, 6, 12, 24) are included.
+//-----------------------------------------------------------------------------
+#include "bench.h"
+#include "../RtConvert.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAMES 512
+#define MAX_CHANNELS 32
+
+// the old loop, with its offset vectors and the conversion of one sample
+template <class In, class Out>
+struct OldLoop {
+    int channels;
+    int inJump, outJump;
+    int inOffset[MAX_CHANNELS], outOffset[MAX_CHANNELS];
+    In *in;
+    Out *out;
+
+    void operator()() {
+        In *i0 = in;
+        Out *o0 = out;
+        for (unsigned int i = 0; i < FRAMES; i++) {
+            for (int j = 0; j < channels; j++)
+                convert(o0[outOffset[j]], i0[inOffset[j]]);
+            i0 += inJump;
+            o0 += outJump;
+        }
+        bench_sink = out[0];
+    }
+
+    static void convert(float &o, float i) { o = i; }
+    static void convert(float &o, short i) {
+        o = (float) i;
+        o += 0.5;
+        o *= (float) (1.0 / 32767.5);
+    }
+};
+
+struct Plan {
+    RtConvertPlan plan;
+    char *in;
+    char *out;
+
+    void operator()() {
+        plan.function(plan, out, in, FRAMES);
+        bench_sink = out[0];
+    }
+};
+
+/*
+ * @function layout Sets the offsets, strides and jumps of one side of a conversion.
+ * @param interleaved True for frames of adjacent channels, false for one run per channel.
+ */
+static void layout(bool interleaved, int channels, int *offset, int &stride, int &jump) {
+    stride = interleaved ? 1 : FRAMES;
+    jump = interleaved ? channels : 1;
+    for (int k = 0; k < channels; k++) offset[k] = k * stride;
+}
+
+template <class In>
+static void run(const char *name, RtAudioFormat inFormat, In *in, float *out) {
+    static const int counts[] = { 2, 3, 4, 5, 6, 8, 12, 16, 24, 32 };
+    static OldLoop<In, float> old;
+    static Plan cur;
+    int count = 2000;
+
+    printf("%s, ns per frame\n", name);
+    printf("%-9s %10s %10s %10s %10s\n", "channels", "old int.", "new int.", "old deint.", "new deint.");
+    for (int c = 0; c < 10; c++) {
+        int channels = counts[c];
+        printf("%-9d", channels);
+        // interleave (per-channel user buffer to an interleaved device buffer), then the reverse
+        for (int deinterleave = 0; deinterleave < 2; deinterleave++) {
+            old.channels = channels;
+            old.in = in;
+            old.out = out;
+            int stride;
+            layout(deinterleave, channels, old.inOffset, stride, old.inJump);
+            layout(!deinterleave, channels, old.outOffset, stride, old.outJump);
+
+            RtConvertPlan &plan = cur.plan;
+            plan = RtConvertPlan();
+            plan.channels = channels;
+            int offset[MAX_CHANNELS];
+            layout(deinterleave, channels, offset, plan.inStride, plan.inJump);
+            layout(!deinterleave, channels, offset, plan.outStride, plan.outJump);
+            rtConvertPrepare(plan, inFormat, RTAUDIO_FLOAT32);
+            cur.in = (char *) in;
+            cur.out = (char *) out;
+
+            double a = bench_best(old, count) / FRAMES * 1e9;
+            double b = bench_best(cur, count) / FRAMES * 1e9;
+            printf(" %10.2f %10.2f", a, b);
+        }
+        printf("\n");
+    }
+}
+
+int main() {
+    float *f = (float *) calloc(FRAMES * MAX_CHANNELS, sizeof(float));
+    short *s = (short *) calloc(FRAMES * MAX_CHANNELS, sizeof(short));
+    float *out = (float *) calloc(FRAMES * MAX_CHANNELS, sizeof(float));
+    for (int i = 0; i < FRAMES * MAX_CHANNELS; i++) {
+        f[i] = (i % 201) * 0.005f - 0.5f;
+        s[i] = (short) (i * 37);
+    }
+
+    printf("channel transposes, %d frame buffers (%s)\n", FRAMES, rtConvertIsa());
+    run("float32 to float32", RTAUDIO_FLOAT32, f, out);
+    run("int16 to float32", RTAUDIO_SINT16, s, out);
+
+    free(f);
+    free(s);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,109 @@
+//-----------------------------------------------------------------------------
+// name: blep.h
+// desc: band-limited saw and pulse shapes (PolyBLEP / PolyBLAMP).
+//
+//       The naive shapes from oscillator.h jump (pulse) or bend (saw) in
+//       between two samples, which folds harmonics above Nyquist back into
+//       the audible band. Here the two samples around every jump get a
+//       quadratic step residual (BLEP), and the two samples around every bend
+//       get its integral, a cubic ramp residual (BLAMP). The corrections are
+//       a few multiplies on the samples next to a discontinuity and nothing
+//       elsewhere, cheap enough for 192kHz streams without oversampling.
+//       Both discontinuities (the wrap and the duty cycle) follow g_width.
+//-----------------------------------------------------------------------------
+#ifndef __BLEP_H
+#define __BLEP_H
+
+#include "oscillator.h"
+
+/*
+ * @function blep_residual Band-limited minus naive unit step.
+ * @param x Distance from the step in samples, in (-1, 1).
+ * @return The correction to add for a step of height one.
+ */
+inline double blep_residual(double x) {
+    if (x < 0) {
+        x += 1.0;
+        return 0.5 * x * x;
+    }
+    x = 1.0 - x;
+    return -0.5 * x * x;
+}
+
+/*
+ * @function blamp_residual Band-limited minus naive unit ramp (integral of blep_residual).
+ * @param x Distance from the bend in samples, in (-1, 1).
+ * @return The correction to add for a slope change of one per sample.
+ */
+inline double blamp_residual(double x) {
+    if (x < 0) x += 1.0;
+    else x = 1.0 - x;
+    return x * x * x * (1.0 / 6.0);
+}
+
+// true if a discontinuity at signed distance d (accumulator steps) is within one sample
+inline bool blep_near(int32_t d, uint32_t inc) {
+    uint32_t a = d < 0 ? 0u - (uint32_t) d : (uint32_t) d;
+    return a < inc;
+}
+
+/*
+ * @function blep_saw Renders the band-limited saw (rises until the width, then falls).
+ * @param osc Oscillator to render from. Its phase is advanced by numFrames.
+ * @param mono Output buffer of numFrames samples.
+ * @param numFrames Number of frames to render.
+ */
+inline void blep_saw(Oscillator &osc, double *mono, unsigned int numFrames) {
+    Oscillator o = osc;
+
+    // distance to a bend is measured in samples: accumulator steps / inc
+    double perStep = 1.0 / o.inc;
+
+    // slope change at each bend, per sample
+    double bend = (o.rise + o.fall) * o.inc * PHASE_SCALE;
+
+    for (unsigned int i = 0; i < numFrames; i++) {
+        double s = osc_saw(o);
+
+        // signed distances (already wrapped) to the bends at the wrap and at the width
+        int32_t d0 = (int32_t) o.phase;
+        int32_t dw = (int32_t) (o.phase - o.width);
+
+        if (blep_near(d0, o.inc)) s += bend * blamp_residual(d0 * perStep);
+        if (blep_near(dw, o.inc)) s -= bend * blamp_residual(dw * perStep);
+
+        mono[i] = s;
+        osc_tick(o);
+    }
+
+    osc.phase = o.phase;
+}
+
+/*
+ * @function blep_pulse Renders the band-limited pulse (high until the width, then low).
+ * @param osc Oscillator to render from. Its phase is advanced by numFrames.
+ * @param mono Output buffer of numFrames samples.
+ * @param numFrames Number of frames to render.
+ */
+inline void blep_pulse(Oscillator &osc, double *mono, unsigned int numFrames) {
+    Oscillator o = osc;
+    double perStep = 1.0 / o.inc;
+
+    for (unsigned int i = 0; i < numFrames; i++) {
+        double s = osc_pulse(o);
+
+        // signed distances to the rising edge (wrap) and the falling edge (width)
+        int32_t d0 = (int32_t) o.phase;
+        int32_t dw = (int32_t) (o.phase - o.width);
+
+        if (blep_near(d0, o.inc)) s += 2.0 * blep_residual(d0 * perStep);
+        if (blep_near(dw, o.inc)) s -= 2.0 * blep_residual(dw * perStep);
+
+        mono[i] = s;
+        osc_tick(o);
+    }
+
+    osc.phase = o.phase;
+}
+
+#endif
@@ -0,0 +1,173 @@
+//-----------------------------------------------------------------------------
+// name: control.h
+// desc: live parameter changes from a control thread into the audio callback.
+//
+//       A single-producer/single-consumer ring of messages carries new
+//       frequency and width values. Pushing and popping are wait-free: each
+//       side only stores its own index (release) and reads the other's
+//       (acquire), so the audio thread never locks or allocates. Values that
+//       arrive during a block are ramped in over the next block in short
+//       equal steps, which keeps width and pitch changes free of clicks and
+//       zipper noise. The phase itself is continuous no matter what.
+//-----------------------------------------------------------------------------
+#ifndef __CONTROL_H
+#define __CONTROL_H
+
+#include "oscillator.h"
+
+// messages the queue can hold (a power of two)
+#define CONTROL_QUEUE_SIZE 256
+
+// frames between two steps of a parameter ramp
+#define CONTROL_RAMP_FRAMES 32
+
+// parameters that may change while the stream runs
+enum ControlParam {
+    CONTROL_FREQ,   // frequency in Hz
+    CONTROL_WIDTH   // duty cycle in (0, 1)
+};
+
+struct ControlMessage {
+    int param;
+    double value;
+};
+
+struct ControlQueue {
+    ControlMessage slots[CONTROL_QUEUE_SIZE];
+
+    // next slot to read, only written by the audio thread
+    unsigned int head;
+
+    // next slot to write, only written by the control thread
+    unsigned int tail;
+};
+
+/* ----------------------------queue----------------- */
+
+inline void control_init(ControlQueue &q) {
+    q.head = 0;
+    q.tail = 0;
+}
+
+/*
+ * @function control_push Queues a parameter change (control thread only).
+ * @param q Queue shared with the audio thread.
+ * @param param One of the ControlParam values.
+ * @param value New value of the parameter.
+ * @return False if the queue is full and the change was dropped.
+ */
+inline bool control_push(ControlQueue &q, int param, double value) {
+    unsigned int tail = q.tail;
+    if (tail - __atomic_load_n(&q.head, __ATOMIC_ACQUIRE) == CONTROL_QUEUE_SIZE) return false;
+
+    ControlMessage &msg = q.slots[tail & (CONTROL_QUEUE_SIZE - 1)];
+    msg.param = param;
+    msg.value = value;
+    __atomic_store_n(&q.tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+ * @function control_pop Takes the oldest parameter change (audio thread only).
+ * @param q Queue shared with the control thread.
+ * @param msg Receives the change.
+ * @return False if the queue is empty.
+ */
+inline bool control_pop(ControlQueue &q, ControlMessage &msg) {
+    unsigned int head = q.head;
+    if (head == __atomic_load_n(&q.tail, __ATOMIC_ACQUIRE)) return false;
+
+    msg = q.slots[head & (CONTROL_QUEUE_SIZE - 1)];
+    __atomic_store_n(&q.head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* ----------------------------ramps----------------- */
+
+// where the oscillator parameters are heading, and how fast
+struct ControlRamp {
+
+    // sample rate used to turn Hz into phase increments
+    double srate;
+
+    // current width (the oscillator only keeps its scaled copy)
+    double width;
+
+    // increment and width added per step, and steps left to go
+    double incStep;
+    double widthStep;
+    unsigned int steps;
+
+    // values the ramp ends on
+    uint32_t targetInc;
+    double targetWidth;
+};
+
+/*
+ * @function control_ramp_init Starts without a ramp at the oscillator's current settings.
+ * @param ramp Ramp to reset.
+ * @param width Current duty cycle.
+ * @param srate Sample rate in Hz.
+ */
+inline void control_ramp_init(ControlRamp &ramp, double width, double srate) {
+    ramp.srate = srate;
+    ramp.width = width;
+    ramp.targetWidth = width;
+    ramp.targetInc = 0;
+    ramp.incStep = 0;
+    ramp.widthStep = 0;
+    ramp.steps = 0;
+}
+
+/*
+ * @function control_apply Drains the queue at the start of a block (audio thread only).
+            Only the last value of each parameter counts, and the ramp towards it spans
+            the block.
+ * @param q Queue shared with the control thread.
+ * @param ramp Ramp state of the generator.
+ * @param osc Oscillator being ramped.
+ * @param numFrames Length of the block the ramp should span.
+ */
+inline void control_apply(ControlQueue &q, ControlRamp &ramp, const Oscillator &osc, unsigned int numFrames) {
+    ControlMessage msg;
+    bool changed = false;
+
+    // an unfinished ramp continues from where it is towards its old target
+    uint32_t inc = ramp.steps > 0 ? ramp.targetInc : osc.inc;
+    double width = ramp.steps > 0 ? ramp.targetWidth : ramp.width;
+
+    while (control_pop(q, msg)) {
+        if (msg.param == CONTROL_FREQ) inc = osc_phase(msg.value / ramp.srate);
+        else if (msg.param == CONTROL_WIDTH) width = msg.value;
+        changed = true;
+    }
+    if (!changed) return;
+
+    unsigned int steps = numFrames / CONTROL_RAMP_FRAMES;
+    if (steps == 0) steps = 1;
+
+    ramp.targetInc = inc;
+    ramp.targetWidth = width;
+    ramp.incStep = ((double) inc - (double) osc.inc) / steps;
+    ramp.widthStep = (width - ramp.width) / steps;
+    ramp.steps = steps;
+}
+
+/*
+ * @function control_ramp_step Moves the oscillator one step along a running ramp.
+ * @param ramp Ramp state of the generator (steps must be above zero).
+ * @param osc Oscillator being ramped.
+ */
+inline void control_ramp_step(ControlRamp &ramp, Oscillator &osc) {
+    if (--ramp.steps == 0) {
+        osc.inc = ramp.targetInc;
+        ramp.width = ramp.targetWidth;
+    }
+    else {
+        osc.inc = (uint32_t) ((double) osc.inc + ramp.incStep + 0.5);
+        ramp.width += ramp.widthStep;
+    }
+    osc_set_width(osc, ramp.width);
+}
+
+#endif
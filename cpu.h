@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// name: cpu.h
+// desc: run-time CPU feature checks for the SIMD generators.
+//
+//       Kernels for wider instruction sets are compiled with a target
+//       attribute (CPU_AVX2_TARGET) and only called when the CPU running
+//       the program reports support for them, so the makefile flags stay
+//       portable.
+//-----------------------------------------------------------------------------
+#ifndef __CPU_H
+#define __CPU_H
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPU_SSE2
+#endif
+
+#if defined(CPU_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CPU_AVX2
+#define CPU_AVX2_TARGET __attribute__((target("avx2")))
+
+/*
+ * @function cpu_has_avx2 Checks (once) whether the running CPU supports AVX2.
+ * @return True if AVX2 kernels may be called.
+ */
+inline bool cpu_has_avx2() {
+    static const bool have = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+    return have;
+}
+#endif
+
+// Advanced SIMD is part of every AArch64 CPU, so it needs no run-time check
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define CPU_NEON
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// name: noise.h
+// desc: white, pink and brown noise for sig_gen.
+//
+//       White noise comes from eight xorshift128 generators running side by
+//       side, one per SIMD lane (two SSE2 registers or one AVX2 register per
+//       step), so the sample order is identical whichever instruction set
+//       produced it. Each channel owns a NoiseState seeded from the stream
+//       seed and its channel index, which makes every render reproducible.
+//       Pink and brown noise filter the same white source.
+//-----------------------------------------------------------------------------
+#ifndef __NOISE_H
+#define __NOISE_H
+
+#include <stdint.h>
+
+// number of generators stepped together
+#define NOISE_LANES 8
+
+struct NoiseState {
+
+    // xorshift128 state, one column per lane
+    uint32_t x[NOISE_LANES];
+    uint32_t y[NOISE_LANES];
+    uint32_t z[NOISE_LANES];
+    uint32_t w[NOISE_LANES];
+
+    // samples of the last step that have not been handed out yet
+    double pending[NOISE_LANES];
+    unsigned int pendingCount;
+
+    // pink / brown filter memory
+    double b[7];
+};
+
+/*
+ * @function noise_seed Resets a channel's generators.
+ * @param ns State to reset.
+ * @param seed Stream seed (the same seed always gives the same noise).
+ * @param channel Channel index, so every channel gets its own sequence.
+ */
+void noise_seed(NoiseState &ns, uint64_t seed, unsigned int channel);
+
+/*
+ * @function noise_white Fills a buffer with white noise uniform in [-1, 1).
+ * @param ns Generator state of the channel.
+ * @param out Output buffer of numFrames samples.
+ * @param numFrames Number of samples to generate.
+ */
+void noise_white(NoiseState &ns, double *out, unsigned int numFrames);
+
+/*
+ * @function noise_pink Fills a buffer with pink (-3dB/octave) noise, roughly within [-1, 1].
+ * @param ns Generator state of the channel.
+ * @param out Output buffer of numFrames samples.
+ * @param numFrames Number of samples to generate.
+ */
+void noise_pink(NoiseState &ns, double *out, unsigned int numFrames);
+
+/*
+ * @function noise_brown Fills a buffer with brown (-6dB/octave) noise, roughly within [-1, 1].
+ * @param ns Generator state of the channel.
+ * @param out Output buffer of numFrames samples.
+ * @param numFrames Number of samples to generate.
+ */
+void noise_brown(NoiseState &ns, double *out, unsigned int numFrames);
+
+#endif
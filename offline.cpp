@@ -0,0 +1,153 @@
+//-----------------------------------------------------------------------------
+// name: offline.cpp
+// desc: offline rendering to WAV or raw files (see offline.h).
+//-----------------------------------------------------------------------------
+#include "offline.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// one part of a render and the state it starts from
+struct OfflineJob {
+    const OfflineSettings *settings;
+    RenderFunc render;
+    Generator gen;
+
+    // private copy of the generator's voices, if it has any
+    OscBank bank;
+
+    // frames of the part, and the byte offset of its first frame in the file
+    uint64_t first;
+    uint64_t frames;
+    uint64_t offset;
+
+    pthread_t thread;
+    bool ok;
+};
+
+/* -------------------------helpers------------------ */
+
+static double offline_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool offline_seek(FILE *file, uint64_t offset) {
+#if defined(_WIN32)
+    return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+// moves a copy of the generator forward to the first frame of its part
+static bool offline_skip(OfflineJob &job) {
+    uint64_t first = job.first;
+    Oscillator &osc = job.gen.osc;
+    osc.phase += (uint32_t) (first * osc.inc);
+
+    if (job.gen.bank != NULL) {
+        if (!bank_copy(job.bank, *job.gen.bank)) return false;
+        for (unsigned int v = 0; v < job.bank.count; v++)
+            job.bank.phase[v] += (uint32_t) (first * job.bank.inc[v]);
+        job.gen.bank = &job.bank;
+
+        // the pool renders the original bank, not this copy
+        job.gen.pool = NULL;
+    }
+    return true;
+}
+
+/* --------------------------render------------------ */
+
+// renders one part into its own region of the file
+static void *offline_job(void *arg) {
+    OfflineJob &job = *(OfflineJob *) arg;
+    const OfflineSettings &s = *job.settings;
+    job.ok = false;
+
+    FILE *file = fopen(s.path, "r+b");
+    if (file == NULL) return NULL;
+
+    size_t samples = (size_t) OFFLINE_BLOCK * s.channels;
+    double *buffer = (double *) malloc(samples * sizeof(double));
+    unsigned char *bytes = (unsigned char *) malloc(samples * wav_sample_bytes(s.format));
+
+    bool ok = buffer != NULL && bytes != NULL && offline_seek(file, job.offset);
+    uint64_t left = job.frames;
+    while (ok && left > 0) {
+        unsigned int n = left < OFFLINE_BLOCK ? (unsigned int) left : OFFLINE_BLOCK;
+        job.render(job.gen, buffer, NULL, n);
+
+        size_t size = wav_convert(s.format, buffer, (size_t) n * s.channels, bytes);
+        ok = fwrite(bytes, 1, size, file) == size;
+        left -= n;
+    }
+
+    free(buffer);
+    free(bytes);
+    if (fclose(file) != 0) ok = false;
+    job.ok = ok;
+    return NULL;
+}
+
+bool offline_render(const OfflineSettings &settings, RenderFunc render, Generator &gen, OfflineStats &stats) {
+    double start = offline_now();
+
+    int jobs = settings.jobs;
+    if (jobs < 1) jobs = 1;
+    if (jobs > OFFLINE_MAX_JOBS) jobs = OFFLINE_MAX_JOBS;
+    if ((uint64_t) jobs > settings.frames / OFFLINE_BLOCK) jobs = (int) (settings.frames / OFFLINE_BLOCK);
+    if (jobs < 1) jobs = 1;
+
+    // create the file (and its header) before the jobs open it for update
+    FILE *file = fopen(settings.path, "wb");
+    if (file == NULL) return false;
+    bool ok = true;
+    if (settings.wav)
+        ok = wav_write_header(file, settings.format, settings.channels, settings.srate, settings.frames);
+    if (fclose(file) != 0) ok = false;
+    if (!ok) return false;
+
+    uint64_t header = settings.wav ? WAV_HEADER_BYTES : 0;
+    uint64_t frameBytes = (uint64_t) settings.channels * wav_sample_bytes(settings.format);
+
+    OfflineJob *job = new OfflineJob[jobs];
+    for (int k = 0; k < jobs; k++) {
+        job[k].settings = &settings;
+        job[k].render = render;
+        job[k].gen = gen;
+        job[k].bank.block = NULL;
+        job[k].first = settings.frames * k / jobs;
+        job[k].frames = settings.frames * (k + 1) / jobs - job[k].first;
+        job[k].offset = header + job[k].first * frameBytes;
+        job[k].ok = false;
+    }
+
+    // a single job renders the generator itself, so it ends where the render does
+    if (jobs == 1) {
+        offline_job(&job[0]);
+        gen = job[0].gen;
+    }
+    else {
+        int started = 0;
+        for (; started < jobs; started++) {
+            if (!offline_skip(job[started])) break;
+            if (pthread_create(&job[started].thread, NULL, offline_job, &job[started]) != 0) break;
+        }
+        for (int k = 0; k < started; k++) pthread_join(job[k].thread, NULL);
+        if (started < jobs) job[started].ok = false;
+    }
+
+    for (int k = 0; k < jobs; k++) {
+        if (!job[k].ok) ok = false;
+        if (job[k].bank.block != NULL) bank_free(job[k].bank);
+    }
+    delete[] job;
+
+    stats.seconds = offline_now() - start;
+    stats.bytes = header + settings.frames * frameBytes;
+    stats.factor = stats.seconds > 0 ? settings.frames / (double) settings.srate / stats.seconds : 0;
+    return ok;
+}
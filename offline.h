@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// name: offline.h
+// desc: renders a generator straight to a WAV or raw file, as fast as it can.
+//
+//       The same render kernel that serves the audio callback is called in
+//       a tight loop with large blocks, and each block is converted and
+//       written in one piece. A long render can be cut into contiguous parts
+//       rendered by separate threads into the same file. Each part starts
+//       from a copy of the generator moved forward to its first frame, which
+//       works for every signal driven by the phase accumulator alone (not
+//       the noise generators, whose state cannot skip ahead).
+//-----------------------------------------------------------------------------
+#ifndef __OFFLINE_H
+#define __OFFLINE_H
+
+#include "render.h"
+#include "wavfile.h"
+
+// frames rendered and written per block
+#define OFFLINE_BLOCK 8192
+
+// most threads a render can be split across
+#define OFFLINE_MAX_JOBS 64
+
+// what to render and where to
+struct OfflineSettings {
+    const char *path;
+
+    // WAV header, or raw interleaved samples only
+    bool wav;
+
+    // one of the WavFormat values
+    int format;
+
+    int channels;
+    unsigned int srate;
+    uint64_t frames;
+
+    // threads to split the render across
+    int jobs;
+};
+
+// how long the render took
+struct OfflineStats {
+    double seconds;
+    uint64_t bytes;
+
+    // seconds of audio rendered per second of wall-clock time
+    double factor;
+};
+
+/*
+ * @function offline_render Renders a generator to a file.
+ * @param settings File, format and length of the render.
+ * @param render Kernel for the generator's waveform and settings.channels (no ring modulation).
+ * @param gen Generator at the first frame. It is advanced when rendered by one job;
+          with several jobs each one renders from its own copy.
+ * @param stats Receives the timing of the render.
+ * @return False if the file could not be written.
+ */
+bool offline_render(const OfflineSettings &settings, RenderFunc render, Generator &gen, OfflineStats &stats);
+
+#endif
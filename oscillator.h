@@ -0,0 +1,123 @@
+//-----------------------------------------------------------------------------
+// name: oscillator.h
+// desc: phase-accumulator oscillator core used by sig_gen's audio callback.
+//
+//       The phase of a wave is kept as an unsigned 32-bit integer where one
+//       full period maps onto [0, 2^32). Advancing by one frame is a single
+//       integer add and wrapping at the end of a period is the free unsigned
+//       overflow, so the cost (and precision) of every sample is the same
+//       after ten days of streaming as it is after ten seconds.
+//-----------------------------------------------------------------------------
+#ifndef __OSCILLATOR_H
+#define __OSCILLATOR_H
+
+#include <math.h>
+#include <stdint.h>
+
+// one full period of the phase accumulator (2^32)
+#define PHASE_ONE 4294967296.0
+
+// scales an accumulator phase back into [0, 1)
+#define PHASE_SCALE (1.0 / PHASE_ONE)
+
+#define OSC_TWO_PI 6.28318530717958647692
+
+/* ----------------------oscillator------------------ */
+
+struct Oscillator {
+
+    // current position in the period, scaled to [0, 2^32)
+    uint32_t phase;
+
+    // amount the phase advances every frame (freq / srate, scaled)
+    uint32_t inc;
+
+    // duty cycle of the saw and pulse shapes, scaled like the phase
+    uint32_t width;
+
+    // slope of the rising (left) portion of the saw, per unit of phase
+    double rise;
+
+    // slope of the falling (right) portion of the saw, per unit of phase
+    double fall;
+};
+
+/*
+ * @function osc_phase Converts a normalized value in [0, 1) to an accumulator phase.
+ * @param x Normalized phase or width.
+ * @return The same position scaled to [0, 2^32), rounded to the nearest step.
+ */
+inline uint32_t osc_phase(double x) {
+    x -= floor(x);
+    return (uint32_t) (uint64_t) (x * PHASE_ONE + 0.5);
+}
+
+/*
+ * @function osc_set_freq Retunes the oscillator without resetting its phase.
+ * @param osc The oscillator to retune.
+ * @param freq Frequency in Hz.
+ * @param srate Sample rate in Hz.
+ */
+inline void osc_set_freq(Oscillator &osc, double freq, double srate) {
+    osc.inc = osc_phase(freq / srate);
+}
+
+/*
+ * @function osc_set_width Changes the duty cycle used by the saw and pulse shapes.
+ * @param osc The oscillator to change.
+ * @param width Duty cycle in the range (0, 1).
+ */
+inline void osc_set_width(Oscillator &osc, double width) {
+    osc.width = osc_phase(width);
+    osc.rise = 2.0 / width;
+    osc.fall = 2.0 / (1.0 - width);
+}
+
+/*
+ * @function osc_init Resets the oscillator to the start of a period.
+ * @param osc The oscillator to initialize.
+ * @param freq Frequency in Hz.
+ * @param width Duty cycle in the range (0, 1).
+ * @param srate Sample rate in Hz.
+ */
+inline void osc_init(Oscillator &osc, double freq, double width, double srate) {
+    osc.phase = 0;
+    osc_set_freq(osc, freq, srate);
+    osc_set_width(osc, width);
+}
+
+/* -----------------------waveforms------------------ */
+
+// sine
+inline double osc_sine(const Oscillator &osc) {
+    return sin(OSC_TWO_PI * PHASE_SCALE * osc.phase);
+}
+
+/* saw: steps up the left portion's hypotenuse until the width, then steps
+ * down the right portion's hypotenuse back to the baseline. */
+inline double osc_saw(const Oscillator &osc) {
+    double pos = PHASE_SCALE * osc.phase;
+    if (osc.phase <= osc.width) return osc.rise * pos;
+    return osc.fall * (1.0 - pos);
+}
+
+// pulse: above the baseline until the width, below it for the rest of the period
+inline double osc_pulse(const Oscillator &osc) {
+    return osc.phase < osc.width ? 1.0 : -1.0;
+}
+
+// impulse train: one impulse on the first frame of every period
+inline double osc_impulse(const Oscillator &osc) {
+    return osc.phase < osc.inc ? 1.0 : 0.0;
+}
+
+/*
+ * @function osc_tick Advances the oscillator by one frame. The wrap at the end
+            of a period is the unsigned overflow of the add.
+ * @param osc The oscillator to advance.
+ */
+inline void osc_tick(Oscillator &osc) {
+    osc.phase += osc.inc;
+}
+
+#endif
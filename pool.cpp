@@ -0,0 +1,329 @@
+//-----------------------------------------------------------------------------
+// name: pool.cpp
+// desc: multi-core rendering of an oscillator bank (see pool.h).
+//
+//       A cursor holds the generation in its top 24 bits, the end of the
+//       range in the next 20 and the next slice in the low 20. A thread that
+//       wakes up late still holds the old generation, so its compare-and-swap
+//       fails instead of claiming a slice of a period it knows nothing about.
+//       A period only ends once every slice is finished, so the frame count
+//       read after a successful claim is always the right one.
+//-----------------------------------------------------------------------------
+#include "pool.h"
+#include "cpu.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+#define POOL_FIELD_MASK ((1u << 20) - 1)
+#define POOL_TAG_MASK ((1u << 24) - 1)
+
+// spins on the generation before a worker starts to nap between checks
+#define POOL_SPINS 256
+
+// nanoseconds of each nap
+#define POOL_NAP 20000
+
+/* -------------------------helpers------------------ */
+
+static double pool_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline void pool_pause() {
+#if defined(CPU_SSE2)
+    _mm_pause();
+#endif
+}
+
+static inline uint64_t pool_cursor(unsigned int gen, unsigned int begin, unsigned int end) {
+    return ((uint64_t) (gen & POOL_TAG_MASK) << 40) | ((uint64_t) end << 20) | begin;
+}
+
+// takes the next slice of a range if the range still belongs to generation gen
+static bool pool_claim(uint64_t *cursor, unsigned int gen, unsigned int &slice) {
+    uint64_t c = __atomic_load_n(cursor, __ATOMIC_ACQUIRE);
+    while ((c >> 40) == (gen & POOL_TAG_MASK) && (c & POOL_FIELD_MASK) < ((c >> 20) & POOL_FIELD_MASK)) {
+        if (__atomic_compare_exchange_n(cursor, &c, c + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            slice = (unsigned int) (c & POOL_FIELD_MASK);
+            return true;
+        }
+    }
+    return false;
+}
+
+// renders slices of period gen: the participant's own range first, then the others'
+static void pool_participate(VoicePool &pool, PoolThread &self, unsigned int gen) {
+    int active = __atomic_load_n(&pool.active, __ATOMIC_RELAXED);
+    if (self.index >= active) return;
+
+    // the audio thread leaves the mix of a busy participant out of a period it gives up on
+    __atomic_store_n(&self.busy, 1, __ATOMIC_SEQ_CST);
+    for (int k = 0; k < active; k++) {
+        PoolThread &victim = pool.worker[(self.index + k) % active];
+        unsigned int slice;
+
+        while (pool_claim(&victim.cursor, gen, slice)) {
+            unsigned int frames = pool.frames;
+            if (self.mixGen != gen) {
+                memset(self.mix, 0, frames * sizeof(double));
+                self.mixGen = gen;
+            }
+
+            unsigned int first = slice * POOL_SLICE_VOICES;
+            bank_accumulate(*pool.bank, first, first + POOL_SLICE_VOICES, self.lanes, self.mix, frames);
+            __atomic_fetch_add(&pool.done, 1, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_store_n(&self.busy, 0, __ATOMIC_RELEASE);
+}
+
+// blocks until the generation moves on from seen or the pool quits
+static void pool_park(VoicePool &pool, unsigned int seen) {
+
+    // whichever of sleeping and the generation is written first, the other side sees it
+    pthread_mutex_lock(&pool.lock);
+    __atomic_fetch_add(&pool.sleeping, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&pool.generation, __ATOMIC_SEQ_CST) == seen &&
+           !__atomic_load_n(&pool.quit, __ATOMIC_SEQ_CST))
+        pthread_cond_wait(&pool.wake, &pool.lock);
+    __atomic_fetch_sub(&pool.sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// the cores the calling thread may run on (by taskset or a cpuset, say), up to max of them
+static int pool_cores(int *core, int max) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > max) count = max;
+    for (int k = 0; k < count; k++) core[k] = k;
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        count = 0;
+        for (int c = 0; c < CPU_SETSIZE && count < max; c++)
+            if (CPU_ISSET(c, &set)) core[count++] = c;
+    }
+#endif
+    return count > 0 ? (int) count : 1;
+}
+
+// pins a thread to one core
+static void pool_pin(pthread_t thread, int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+#endif
+}
+
+static void *pool_thread(void *arg) {
+    PoolThread &self = *(PoolThread *) arg;
+    VoicePool &pool = *self.pool;
+    unsigned int seen = __atomic_load_n(&pool.generation, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        unsigned int gen;
+        int spins = 0;
+        double idle = 0;
+        while ((gen = __atomic_load_n(&pool.generation, __ATOMIC_ACQUIRE)) == seen) {
+            if (__atomic_load_n(&pool.quit, __ATOMIC_RELAXED)) return NULL;
+            if (++spins < POOL_SPINS) pool_pause();
+            else if (spins == POOL_SPINS) idle = pool_now();
+            else if (pool_now() - idle > POOL_IDLE) {
+                pool_park(pool, seen);
+                spins = 0;
+            }
+            else {
+                struct timespec nap = { 0, POOL_NAP };
+                nanosleep(&nap, NULL);
+            }
+        }
+        seen = gen;
+        pool_participate(pool, self, gen);
+    }
+}
+
+/* -------------------------lifetime----------------- */
+
+bool pool_start(VoicePool &pool, OscBank &bank, int threads, double srate) {
+    // a worker sharing a core with another participant only adds contention
+    int core[POOL_MAX_THREADS];
+    int cores = pool_cores(core, POOL_MAX_THREADS);
+    if (threads > cores) threads = cores;
+    if (threads < 1) threads = 1;
+    if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+    size_t lanesBytes = BANK_CHUNK * BANK_LANES * sizeof(float);
+    size_t mixBytes = POOL_MAX_FRAMES * sizeof(double);
+    pool.block = malloc(threads * (lanesBytes + mixBytes) + 63);
+    if (pool.block == NULL) return false;
+    char *p = (char *) (((uintptr_t) pool.block + 63) & ~(uintptr_t) 63);
+
+    pool.bank = &bank;
+    pool.threads = threads;
+    pool.active = threads;
+    pool.generation = 0;
+    pool.frames = 0;
+    pool.slices = 0;
+    pool.done = 0;
+    pool.quit = 0;
+    pool.sleeping = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.wake, NULL);
+    pool.budget = POOL_BUDGET / srate;
+    pool.clean = 0;
+    memset(&pool.stats, 0, sizeof(pool.stats));
+
+    for (int t = 0; t < threads; t++) {
+        PoolThread &w = pool.worker[t];
+        w.cursor = 0;
+        w.pool = &pool;
+        w.index = t;
+        w.started = false;
+        w.lanes = (float *) p;
+        w.mix = (double *) (p + lanesBytes);
+        w.mixGen = 0;
+        w.busy = 0;
+        p += lanesBytes + mixBytes;
+    }
+
+    for (int t = 1; t < threads; t++) {
+        PoolThread &w = pool.worker[t];
+        if (pthread_create(&w.thread, NULL, pool_thread, &w) != 0) {
+            pool_stop(pool);
+            return false;
+        }
+        w.started = true;
+
+        /* one core per worker, from the last allowed core down, so the first
+         * stays free for the audio thread (whose affinity is its owner's
+         * business) and RtAudio's conversion helpers, which count up from
+         * the second, meet the workers only when there are too few cores */
+        pool_pin(w.thread, core[cores - t]);
+    }
+
+    return true;
+}
+
+void pool_stop(VoicePool &pool) {
+    pthread_mutex_lock(&pool.lock);
+    __atomic_store_n(&pool.quit, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for (int t = 1; t < pool.threads; t++) {
+        if (pool.worker[t].started) pthread_join(pool.worker[t].thread, NULL);
+        pool.worker[t].started = false;
+    }
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.wake);
+
+    free(pool.block);
+    pool.block = NULL;
+    pool.threads = 0;
+}
+
+/* --------------------------render------------------ */
+
+static void pool_period(VoicePool &pool, double *out, unsigned int numFrames) {
+    double start = pool_now();
+    OscBank &bank = *pool.bank;
+
+    // a slice given up on last period is still being rendered; its voices
+    // cannot be touched until it is done, so this period is lost as well
+    if (__atomic_load_n(&pool.done, __ATOMIC_ACQUIRE) != pool.slices) {
+        memset(out, 0, numFrames * sizeof(double));
+        pool.stats.periods++;
+        pool.stats.misses++;
+        pool.clean = 0;
+        return;
+    }
+
+    unsigned int slices = (bank.count + POOL_SLICE_VOICES - 1) / POOL_SLICE_VOICES;
+    int active = pool.active;
+
+    if (active == 1 || slices < 2) {
+        memset(out, 0, numFrames * sizeof(double));
+        bank_accumulate(bank, 0, bank.count, pool.worker[0].lanes, out, numFrames);
+    }
+    else {
+        unsigned int gen = pool.generation + 1;
+
+        // no participant touches these until the new generation is published
+        pool.frames = numFrames;
+        pool.slices = slices;
+        pool.done = 0;
+        for (int t = 0; t < active; t++)
+            __atomic_store_n(&pool.worker[t].cursor,
+                pool_cursor(gen, slices * t / active, slices * (t + 1) / active), __ATOMIC_RELAXED);
+        __atomic_store_n(&pool.generation, gen, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pool.sleeping, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&pool.lock);
+            pthread_cond_broadcast(&pool.wake);
+            pthread_mutex_unlock(&pool.lock);
+        }
+
+        pool_participate(pool, pool.worker[0], gen);
+
+        /* slices still in flight belong to workers; they cannot be taken back,
+         * so wait, yielding the core in case the worker is waiting for it, but
+         * no longer than the period lasts: then the late workers' mixes are
+         * left out and the period counts as a miss */
+        double deadline = start + numFrames * pool.budget / POOL_BUDGET;
+        bool late = false;
+        int spins = 0;
+        while (__atomic_load_n(&pool.done, __ATOMIC_ACQUIRE) != slices) {
+            if (++spins < POOL_SPINS) pool_pause();
+            else if (pool_now() > deadline) {
+                late = true;
+                break;
+            }
+            else sched_yield();
+        }
+
+        // a worker that read a stale participant count may have helped too
+        memset(out, 0, numFrames * sizeof(double));
+        for (int t = 0; t < pool.threads; t++) {
+            PoolThread &w = pool.worker[t];
+            if (late && __atomic_load_n(&w.busy, __ATOMIC_ACQUIRE)) continue;
+            if (w.mixGen != gen) continue;
+
+            const double *mix = w.mix;
+            unsigned int i = 0;
+#if defined(CPU_SSE2)
+            for (; i + 2 <= numFrames; i += 2)
+                _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(out + i), _mm_load_pd(mix + i)));
+#endif
+            for (; i < numFrames; i++) out[i] += mix[i];
+        }
+    }
+
+    double elapsed = pool_now() - start;
+    pool.stats.periods++;
+    pool.stats.busy += elapsed;
+    if (elapsed > pool.stats.worst) pool.stats.worst = elapsed;
+
+    // late: fewer participants means less waking up and less contention
+    if (elapsed > numFrames * pool.budget) {
+        pool.stats.misses++;
+        pool.clean = 0;
+        if (active > 1) __atomic_store_n(&pool.active, active / 2, __ATOMIC_RELAXED);
+    }
+    else if (++pool.clean >= POOL_RECOVER_PERIODS && active < pool.threads) {
+        pool.clean = 0;
+        __atomic_store_n(&pool.active, active + 1, __ATOMIC_RELAXED);
+    }
+}
+
+void pool_render(VoicePool &pool, double *out, unsigned int numFrames) {
+    while (numFrames > 0) {
+        unsigned int n = numFrames < POOL_MAX_FRAMES ? numFrames : POOL_MAX_FRAMES;
+        pool_period(pool, out, n);
+        out += n;
+        numFrames -= n;
+    }
+}
@@ -0,0 +1,147 @@
+//-----------------------------------------------------------------------------
+// name: pool.h
+// desc: renders the voices of an oscillator bank on several cores at once.
+//
+//       The voices are cut into slices of POOL_SLICE_VOICES. At the start of
+//       every period the audio thread hands each participant (itself and
+//       the pinned worker threads) a contiguous range of slices. Each
+//       participant works through its own range first and then steals the
+//       slices others have not reached yet, claiming one at a time with a
+//       compare-and-swap on the owner's cursor. Every participant mixes into
+//       its own buffer and the audio thread adds the buffers up at the end.
+//       Nothing is locked or allocated while rendering. A period that ends
+//       past its deadline halves the number of participants; they are added
+//       back one at a time after POOL_RECOVER_PERIODS periods on time.
+//       The audio thread waits for slices in flight no longer than the period
+//       lasts; it then leaves out the late workers' mixes, and the periods
+//       until the late slices are done come out silent. Workers with no
+//       period for POOL_IDLE seconds (a stopped stream) block until the next
+//       one starts. Each worker is pinned to a core of its own, counting down
+//       from the last core the process may run on; the audio thread is not
+//       pinned.
+//-----------------------------------------------------------------------------
+#ifndef __POOL_H
+#define __POOL_H
+
+#include "bank.h"
+#include <pthread.h>
+
+// most threads rendering at once, the audio thread included
+#define POOL_MAX_THREADS 32
+
+// voices claimed at a time (a multiple of BANK_LANES)
+#define POOL_SLICE_VOICES (4 * BANK_LANES)
+
+// frames rendered per period; longer blocks are rendered as several periods
+#define POOL_MAX_FRAMES 4096
+
+// share of the period's duration the voices may take before it counts as late
+#define POOL_BUDGET 0.75
+
+// periods on time before another participant is given work
+#define POOL_RECOVER_PERIODS 2000
+
+// seconds without a period before a worker blocks
+#define POOL_IDLE 0.1
+
+struct VoicePool;
+
+// one participant; the first is the audio thread, the others own a worker thread
+struct PoolThread {
+
+    // next slice, end of the range and generation, packed so a single
+    // compare-and-swap claims a slice of the current period only
+    uint64_t cursor;
+
+    VoicePool *pool;
+    int index;
+    pthread_t thread;
+    bool started;
+
+    // BANK_CHUNK * BANK_LANES floats of scratch for bank_accumulate
+    float *lanes;
+
+    // POOL_MAX_FRAMES frames of this participant's share of the mix
+    double *mix;
+
+    // generation the mix was last cleared for
+    unsigned int mixGen;
+
+    // set while the participant may be claiming or rendering slices
+    int busy;
+
+} __attribute__((aligned(64)));
+
+// counters the audio thread keeps about its periods
+struct PoolStats {
+    unsigned long periods;
+    unsigned long misses;
+
+    // seconds spent rendering, in total and in the longest period
+    double busy;
+    double worst;
+};
+
+struct VoicePool {
+    PoolThread worker[POOL_MAX_THREADS];
+
+    // bank being rendered
+    OscBank *bank;
+
+    // participants started, and how many of them get work right now
+    int threads;
+    int active;
+
+    // bumped by the audio thread to start a period
+    unsigned int generation;
+
+    // frames and slices of the current period, and slices finished so far
+    unsigned int frames;
+    unsigned int slices;
+    unsigned int done;
+
+    // set to make the worker threads exit
+    int quit;
+
+    // workers blocked on wake, waiting for a period after idling
+    unsigned int sleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+
+    // seconds per frame the voices may take, and periods since the last miss
+    double budget;
+    unsigned int clean;
+
+    PoolStats stats;
+
+    // block returned by malloc for the scratch and mix buffers
+    void *block;
+};
+
+/*
+ * @function pool_start Allocates the buffers and starts the worker threads.
+ * @param pool Pool to set up.
+ * @param bank Bank the pool renders. Voices may not be added or removed while it runs.
+ * @param threads Threads rendering at once, the audio thread included (1 to POOL_MAX_THREADS,
+            and no more than the cores the process may run on).
+ * @param srate Sample rate in Hz, used for the deadline.
+ * @return False if memory or a thread could not be had (nothing is left running).
+ */
+bool pool_start(VoicePool &pool, OscBank &bank, int threads, double srate);
+
+/*
+ * @function pool_stop Stops the worker threads and releases the buffers.
+ * @param pool Pool to stop. The audio thread must no longer be rendering with it.
+ */
+void pool_stop(VoicePool &pool);
+
+/*
+ * @function pool_render Renders the mix of all voices (audio thread only).
+ * @param pool Running pool.
+ * @param out Mono output buffer of numFrames samples (overwritten).
+ * @param numFrames Number of frames to render.
+ */
+void pool_render(VoicePool &pool, double *out, unsigned int numFrames);
+
+#endif
@@ -0,0 +1,230 @@
+//-----------------------------------------------------------------------------
+// name: render.h
+// desc: compile-time specialized render kernels for sig_gen.
+//
+//       Every combination of waveform, ring modulation and channel count is
+//       its own instantiation of render_block, so the per-frame loop carries
+//       no switch on the waveform, no test of the --input flag and no
+//       run-time channel loop. The right instantiation is picked once when
+//       the arguments are checked. Each waveform fills a chunk of mono
+//       frames, either one sample at a time or with a block generator, and
+//       the chunk is then ring modulated and spread across the channels.
+//-----------------------------------------------------------------------------
+#ifndef __RENDER_H
+#define __RENDER_H
+
+#include "oscillator.h"
+#include "sine.h"
+#include "noise.h"
+#include "blep.h"
+#include "wavetable.h"
+#include "control.h"
+#include "bank.h"
+#include "pool.h"
+
+// frames generated per pass before they are spread across the channels
+#define RENDER_CHUNK 256
+
+// widest channel count a kernel is instantiated for
+#define RENDER_MAX_CHANNELS 8
+
+// everything a render kernel reads and advances
+struct Generator {
+
+    // phase accumulator shared by every channel
+    Oscillator osc;
+
+    // independent noise source for every channel
+    NoiseState noise[RENDER_MAX_CHANNELS];
+
+    // octave tables read by the wavetable shape (shared, never written)
+    const Wavetable *table;
+
+    // ramp towards frequency and width values sent by the control thread
+    ControlRamp ramp;
+
+    // voices mixed by the bank shape
+    OscBank *bank;
+
+    // threads sharing the bank's voices, or NULL to render them on the audio thread
+    VoicePool *pool;
+};
+
+/*
+ * @function fill_samples Generates a run of mono frames one sample at a time.
+ * @param osc Oscillator to render from. Its phase is advanced by numFrames.
+ * @param mono Output buffer of numFrames samples.
+ * @param numFrames Number of frames to generate.
+ */
+template <class Wave>
+inline void fill_samples(Oscillator &osc, double *mono, unsigned int numFrames) {
+
+    // work on a local copy so the loop never re-reads state through memory
+    Oscillator o = osc;
+
+    for (unsigned int i = 0; i < numFrames; i++) {
+        mono[i] = Wave::sample(o);
+        osc_tick(o);
+    }
+
+    osc.phase = o.phase;
+}
+
+/* ----------------------waveform tags--------------- */
+
+/* Every tag provides fill(gen, channel, mono, numFrames). Tags with PER_CHANNEL
+ * set are filled once for every channel; the others are filled once and the
+ * result is copied to every channel. */
+
+// sine, generated a block at a time by the tier picked with --quality=
+template <SineQuality QUALITY>
+struct SineWave {
+    static const bool PER_CHANNEL = false;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        sine_block(QUALITY, gen.osc.phase, gen.osc.inc, mono, numFrames);
+        gen.osc.phase += numFrames * gen.osc.inc;
+    }
+};
+
+struct SawWave {
+    static const bool PER_CHANNEL = false;
+    static inline double sample(const Oscillator &osc) { return osc_saw(osc); }
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        fill_samples<SawWave>(gen.osc, mono, numFrames);
+    }
+};
+
+struct PulseWave {
+    static const bool PER_CHANNEL = false;
+    static inline double sample(const Oscillator &osc) { return osc_pulse(osc); }
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        fill_samples<PulseWave>(gen.osc, mono, numFrames);
+    }
+};
+
+// band-limited saw (PolyBLAMP)
+struct BlSawWave {
+    static const bool PER_CHANNEL = false;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        blep_saw(gen.osc, mono, numFrames);
+    }
+};
+
+// band-limited pulse (PolyBLEP)
+struct BlPulseWave {
+    static const bool PER_CHANNEL = false;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        blep_pulse(gen.osc, mono, numFrames);
+    }
+};
+
+// waveform loaded from disk, read from the octave table that suits the pitch
+template <bool CUBIC>
+struct WavetableWave {
+    static const bool PER_CHANNEL = false;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        wavetable_render(*gen.table, CUBIC, gen.osc.phase, gen.osc.inc, mono, numFrames);
+        gen.osc.phase += numFrames * gen.osc.inc;
+    }
+};
+
+// mix of every voice in the oscillator bank
+struct BankWave {
+    static const bool PER_CHANNEL = false;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        if (gen.pool != NULL) pool_render(*gen.pool, mono, numFrames);
+        else bank_render(*gen.bank, mono, numFrames);
+    }
+};
+
+// white noise, independent on every channel
+struct NoiseWave {
+    static const bool PER_CHANNEL = true;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        noise_white(gen.noise[channel], mono, numFrames);
+    }
+};
+
+// pink noise, independent on every channel
+struct PinkWave {
+    static const bool PER_CHANNEL = true;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        noise_pink(gen.noise[channel], mono, numFrames);
+    }
+};
+
+// brown noise, independent on every channel
+struct BrownWave {
+    static const bool PER_CHANNEL = true;
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        noise_brown(gen.noise[channel], mono, numFrames);
+    }
+};
+
+struct ImpulseWave {
+    static const bool PER_CHANNEL = false;
+    static inline double sample(const Oscillator &osc) { return osc_impulse(osc); }
+    static inline void fill(Generator &gen, int channel, double *mono, unsigned int numFrames) {
+        fill_samples<ImpulseWave>(gen.osc, mono, numFrames);
+    }
+};
+
+/* -----------------------render kernel-------------- */
+
+/*
+ * @function render_block Renders one block of interleaved frames.
+ * @param gen Generator to render from. Its state is advanced by numFrames.
+ * @param out Interleaved output buffer of numFrames * CHANNELS samples.
+ * @param in Interleaved input buffer (only read when RING is true).
+ * @param numFrames Number of frames to render.
+ */
+template <class Wave, bool RING, int CHANNELS>
+inline void render_block(Generator &gen, double *out, const double *in, unsigned int numFrames) {
+
+    double mono[RENDER_CHUNK];
+
+    while (numFrames > 0) {
+        unsigned int n = numFrames < RENDER_CHUNK ? numFrames : RENDER_CHUNK;
+
+        // while a parameter ramp runs, render in short steps between its values
+        if (gen.ramp.steps > 0) {
+            if (n > CONTROL_RAMP_FRAMES) n = CONTROL_RAMP_FRAMES;
+            control_ramp_step(gen.ramp, gen.osc);
+        }
+
+        if (Wave::PER_CHANNEL) {
+            for (int j = 0; j < CHANNELS; j++) {
+                Wave::fill(gen, j, mono, n);
+
+                for (unsigned int i = 0; i < n; i++) {
+                    double s = mono[i];
+                    if (RING) s *= in[i * CHANNELS];
+                    out[i * CHANNELS + j] = s;
+                }
+            }
+        }
+        else {
+            Wave::fill(gen, 0, mono, n);
+
+            for (unsigned int i = 0; i < n; i++) {
+                double s = mono[i];
+
+                // ring modulation (multiplies wave output by the first input channel)
+                if (RING) s *= in[i * CHANNELS];
+
+                // every channel carries the same signal
+                for (int j = 0; j < CHANNELS; j++)
+                    out[i * CHANNELS + j] = s;
+            }
+        }
+
+        out += n * CHANNELS;
+        if (RING) in += n * CHANNELS;
+        numFrames -= n;
+    }
+}
+
+// a render_block instantiation, picked once for the waveform, ring modulation and channel count
+typedef void (*RenderFunc)(Generator &gen, double *out, const double *in, unsigned int numFrames);
+
+#endif
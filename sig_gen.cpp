@@ -7,9 +7,14 @@
 //   uses: RtAudio by Gary Scavone
 //-----------------------------------------------------------------------------
 #include "RtAudio.h"
+#include "render.h"
+#include "offline.h"
 #include <math.h>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <string>
 using namespace std;
 
 /* ----------------------#defines-------------------- */
@@ -20,10 +25,10 @@ using namespace std;
 // RtAudio's data format type. Normalized between +- 1
 #define MY_FORMAT RTAUDIO_FLOAT64
 
-// Sample Rate = (avg. # of samples)/second = 1/T, where T is sampling interval
+// Sample Rate = (avg. # of samples)/second = 1/T, where T is sampling interval (default of --srate=)
 #define MY_SRATE 44100
 
-// number of channels
+// number of channels (default of --channels=)
 #define MY_CHANNELS 2
 
 #define MY_PIE 3.14159265358979
@@ -38,8 +43,14 @@ using namespace std;
 // frequency
 SAMPLE g_freq = 440;
 
-// sample number
-SAMPLE g_t = 0;
+// oscillator and per-channel noise state driving every waveform (see render.h)
+Generator g_gen;
+
+// frequency and width changes from the control (main) thread to the audio thread
+ControlQueue g_control;
+
+// seed of the noise generators (--seed=), fixed so every run is reproducible
+unsigned long long g_seed = 1;
 
 // wave width (default square wave)
 SAMPLE g_width = 0.5;
@@ -50,10 +61,50 @@ int g_sig = 0;
 // --input flag (default turned off)
 bool flag = false;
 
+// accuracy tier of the --sine generator (--quality=exact|poly|fast|rotation)
+SineQuality g_quality = SINE_POLY;
+
+// single-cycle waveform file read by --wavetable (--table=), and its octave tables
+string g_table_path;
+Wavetable g_table;
+
+// interpolation between wavetable points (--interp=linear|cubic)
+bool g_cubic = true;
+
+// number of simultaneous tones (--voices=) and the spacing between them in Hz (--spacing=)
+int g_voices = 0;
+double g_spacing = 10.0;
+OscBank g_bank;
+
+// threads rendering the voice bank, the audio thread included (--threads=)
+int g_threads = 1;
+VoicePool g_pool;
+
+// sample rate and channel count of the stream or file (--srate=, --channels=)
+unsigned int g_srate = MY_SRATE;
+int g_channels = MY_CHANNELS;
+
+// resampling when the device cannot run at g_srate (--resample=off|fast|medium|best)
+RtAudioResampleQuality g_resample = RTAUDIO_RESAMPLE_MEDIUM;
+
+// how ALSA moves the samples: read/write calls or the mmap area (--transfer=rw|mmap)
+bool g_mmap = false;
+
+// file written instead of playing (--render=), its length (--seconds=), sample format
+// (--format=) and the threads rendering it (--jobs=)
+string g_render_path;
+double g_seconds = 10.0;
+int g_format = WAV_F32;
+int g_jobs = 1;
+
+// render kernel specialized for the requested signal, picked in check_args
+RenderFunc g_render = NULL;
+
 /*---------------------------------------------------- */
 
 /*
- * @funtion audio_callback The RtAudioCallback function.
+ * @funtion audio_callback The RtAudioCallback function. Renders with the kernel check_args
+            picked for the waveform, ring modulation setting and channel count.
  * @param outputBuffer Pointer to the buffer that holds the output.
  * @param inputBuffer Pointer to the buffer that holds the input.
  * @param numFrames The number of sample frames held by input buffer
@@ -68,18 +119,6 @@ bool flag = false;
 int audio_callback(void *outputBuffer, void *inputBuffer, unsigned int numFrames,
      double streamTime, RtAudioStreamStatus status, void *data) {
 
-         // Fundamental period of the wave.
-         double period = 1 / g_freq;
-
-         // Difference between period and the width. Used by the right part of a saw tooth.
-         double rmdr = period - (g_width * period);
-
-         // Difference in value between consecutive samples for the left portion of the saw.
-         double left_sample_step = (MAX_AMP * 2) / (g_width * period);
-
-         // Difference in value between consecutive samples for the right portion of the saw.
-         double right_sample_step = (MAX_AMP * 2) / rmdr;
-
          // stderr prints info and err messages (info about callback here)
          cerr << ".";
 
@@ -87,85 +126,75 @@ int audio_callback(void *outputBuffer, void *inputBuffer, unsigned int numFrames
          SAMPLE *buffer = (SAMPLE *) outputBuffer;
          SAMPLE *ibuffer = (SAMPLE *) inputBuffer;
 
-         for (int i = 0; i < numFrames; i++)
-         {
-            // Position of the current sample relative to the current wave period.
-            double sample_pos = fmod(g_t / MY_SRATE, period);
-
-            /* Create different waveforms based on user input by first generating a signal in the
-             * even-indexed slots of the buffer. */
-            switch(g_sig) {
-
-                // sine
-                case 1:
-                    buffer[i * MY_CHANNELS] = sin(2 * MY_PIE * g_freq * g_t / MY_SRATE);
-                    break;
-
-                // saw
-                case 2:
-
-                    /* Produces left portion of saw wave (pos. slope). Steps up the left portion's
-                       hypotenuse with values based on the current sample position. */
-                    if (sample_pos <= g_width * period) {
-                        buffer[i * MY_CHANNELS] = left_sample_step * sample_pos;
-                    }
-
-                    /* Produces right portion of saw wave (neg. slope). Steps down the right portion's
-                       hypotenuse. Uses the difference of the period and the current position. */
-                    else {
-                        buffer[i * MY_CHANNELS] = right_sample_step * (period - sample_pos);
-                    }
-                    break;
-
-                // pulse
-                case 3:
-
-                    /* (Sample % period) <= delay time of the wave.
-                     * Produces rectangular wave above the baseline. */
-                    if (sample_pos <= g_width * period) {
-                        buffer[i * MY_CHANNELS] = MAX_AMP;
-                    }
-
-                    /* (Sample % period) >= delay time of the wave.
-                     * Produces rectangular wave below the baseline. */
-                    else if (sample_pos >= g_width * period) {
-                        buffer[i * MY_CHANNELS] = MIN_AMP;
-                    }
-                    break;
-
-                // noise
-                case 4:
-                    buffer[i * MY_CHANNELS] = (rand() % 100) / 10;
-                    break;
-
-                // impulse train
-                case 5:
-
-                    // signal sample shoots an impulse at the given frequency's fundamental period
-                    if (fmod(g_t, round(period * MY_SRATE)) == 0) {
-                        buffer[i * MY_CHANNELS] = MAX_AMP;
-                    } else {
-                        buffer[i * MY_CHANNELS] = BASELINE;
-                    }
-                    break;
-
-                // if none of the above, stop the stream immediately.
-                default:
-                    return 2;
-            }
+         // pick up live parameter changes and ramp them in over this block
+         control_apply(g_control, g_gen.ramp, g_gen.osc, numFrames);
 
-            // ring modulation if --input flag specified (multiplies wave output by input)
-            if (flag) 
-                buffer[i * MY_CHANNELS] *= ibuffer[i * MY_CHANNELS];
+         g_render(g_gen, buffer, ibuffer, numFrames);
+         return 0;
+}
 
-            // copy signal into odd-indexed slots of the buffer
-            for(int j = 1; j < MY_CHANNELS; j++)
-                 buffer[i * MY_CHANNELS + j] = buffer[i * MY_CHANNELS];
+/*
+ * @funtion select_ring Picks the ring modulated or plain kernel for a waveform.
+ * @param ring True if the --input flag was given.
+ * @return The matching render_block instantiation.
+ */
+template <class Wave, int CHANNELS>
+RenderFunc select_ring(bool ring) {
+    if (ring) return &render_block<Wave, true, CHANNELS>;
+    return &render_block<Wave, false, CHANNELS>;
+}
 
-            // increment sample number
-            g_t += 1.0;
-         }
-         return 0;
+/*
+ * @funtion select_wave Picks the kernel for a waveform at a fixed channel count.
+ * @param sig Signal number returned by determine_signal.
+ * @param ring True if the --input flag was given.
+ * @return The matching render_block instantiation, or NULL for an unknown signal.
+ */
+template <int CHANNELS>
+RenderFunc select_wave(int sig, bool ring) {
+
+    // a voice bank renders every voice, whatever shape each one has
+    if (g_voices > 0) return select_ring<BankWave, CHANNELS>(ring);
+
+    switch(sig) {
+        case 1:
+            switch(g_quality) {
+                case SINE_POLY: return select_ring<SineWave<SINE_POLY>, CHANNELS>(ring);
+                case SINE_FAST: return select_ring<SineWave<SINE_FAST>, CHANNELS>(ring);
+                case SINE_ROTATION: return select_ring<SineWave<SINE_ROTATION>, CHANNELS>(ring);
+                default: return select_ring<SineWave<SINE_EXACT>, CHANNELS>(ring);
+            }
+        case 2: return select_ring<SawWave, CHANNELS>(ring);
+        case 3: return select_ring<PulseWave, CHANNELS>(ring);
+        case 4: return select_ring<NoiseWave, CHANNELS>(ring);
+        case 5: return select_ring<ImpulseWave, CHANNELS>(ring);
+        case 6: return select_ring<PinkWave, CHANNELS>(ring);
+        case 7: return select_ring<BrownWave, CHANNELS>(ring);
+        case 8: return select_ring<BlSawWave, CHANNELS>(ring);
+        case 9: return select_ring<BlPulseWave, CHANNELS>(ring);
+        case 10:
+            if (g_cubic) return select_ring<WavetableWave<true>, CHANNELS>(ring);
+            return select_ring<WavetableWave<false>, CHANNELS>(ring);
+        default: return NULL;
+    }
+}
+
+/*
+ * @funtion select_render Picks the specialized render kernel once, so the per-frame
+            loop never has to branch on the waveform, the --input flag or the channel count.
+ * @param sig Signal number returned by determine_signal.
+ * @param ring True if the --input flag was given.
+ * @param channels Number of interleaved channels in the stream.
+ * @return The matching render_block instantiation, or NULL if there is none.
+ */
+RenderFunc select_render(int sig, bool ring, int channels) {
+    switch(channels) {
+        case 1: return select_wave<1>(sig, ring);
+        case 2: return select_wave<2>(sig, ring);
+        case 4: return select_wave<4>(sig, ring);
+        case 8: return select_wave<8>(sig, ring);
+        default: return NULL;
+    }
 }
 
 /*
@@ -205,23 +234,245 @@ int determine_signal(int argc, const char *type) {
         return 5;
     }
 
+    // pink noise
+    else if (arg == "--pink") {
+        return 6;
+    }
+
+    // brown noise
+    else if (arg == "--brown") {
+        return 7;
+    }
+
+    // band-limited saw
+    else if (arg == "--blsaw") {
+        return 8;
+    }
+
+    // band-limited pulse
+    else if (arg == "--blpulse") {
+        return 9;
+    }
+
+    // wavetable loaded from the file given with --table=
+    else if (arg == "--wavetable") {
+        return 10;
+    }
+
     // arg is some other input not defined by this program
     else {
-        cout << "Must provide a valid type of waveform. --sine, --saw, --noise, --pulse, --impulse." << endl;
+        cout << "Must provide a valid type of waveform. --sine, --saw, --noise, --pulse, --impulse, --pink, --brown, --blsaw, --blpulse, --wavetable." << endl;
+        return -1;
+    }
+}
+
+/*
+ * @funtion parse_option Handles an optional argument of the form --name=value.
+ * @param arg Command line argument.
+ * @return 1 if arg was a valid option, 0 if arg is not an option, -1 if the option is invalid.
+ */
+int parse_option(const char *arg) {
+
+    string opt = string(arg);
+    size_t eq = opt.find('=');
+
+    // options always start with -- and carry a value after =
+    if (opt.compare(0, 2, "--") != 0 || eq == string::npos) return 0;
+
+    string name = opt.substr(2, eq - 2);
+    string value = opt.substr(eq + 1);
+
+    // accuracy tier of the sine generator
+    if (name == "quality") {
+        for (int q = SINE_EXACT; q <= SINE_ROTATION; q++) {
+            if (value == sine_quality_name((SineQuality) q)) {
+                g_quality = (SineQuality) q;
+                return 1;
+            }
+        }
+        cout << "--quality must be one of";
+        for (int q = SINE_EXACT; q <= SINE_ROTATION; q++) {
+            cout << (q == SINE_EXACT ? " " : q == SINE_ROTATION ? " or " : ", ")
+                 << sine_quality_name((SineQuality) q);
+        }
+        cout << "." << endl;
         return -1;
     }
+
+    // single-cycle waveform for --wavetable
+    if (name == "table") {
+        g_table_path = value;
+        return 1;
+    }
+
+    // interpolation between wavetable points
+    if (name == "interp") {
+        if (value == "linear") g_cubic = false;
+        else if (value == "cubic") g_cubic = true;
+        else {
+            cout << "--interp must be linear or cubic." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // number of simultaneous tones
+    if (name == "voices") {
+        char *endptr = 0;
+        g_voices = (int) strtol(value.c_str(), &endptr, 10);
+        if (*endptr != '\0' || value.empty() || g_voices < 1) {
+            cout << "--voices must be an integer above 0." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // spacing between the tones of the voice bank
+    if (name == "spacing") {
+        char *endptr = 0;
+        g_spacing = strtod(value.c_str(), &endptr);
+        if (*endptr != '\0' || value.empty() || g_spacing < 0) {
+            cout << "--spacing must be a double of at least 0." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // threads sharing the voices of the bank
+    if (name == "threads") {
+        char *endptr = 0;
+        g_threads = (int) strtol(value.c_str(), &endptr, 10);
+        if (*endptr != '\0' || value.empty() || g_threads < 1 || g_threads > POOL_MAX_THREADS) {
+            cout << "--threads must be an integer from 1 to " << POOL_MAX_THREADS << "." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // render to a file instead of the default output device
+    if (name == "render") {
+        if (value.empty()) {
+            cout << "--render needs a file name." << endl;
+            return -1;
+        }
+        g_render_path = value;
+        return 1;
+    }
+
+    // length of the file written by --render
+    if (name == "seconds") {
+        char *endptr = 0;
+        g_seconds = strtod(value.c_str(), &endptr);
+        if (*endptr != '\0' || value.empty() || g_seconds <= 0) {
+            cout << "--seconds must be a double above 0." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // sample format of the file written by --render
+    if (name == "format") {
+        if (value == "s16") g_format = WAV_S16;
+        else if (value == "s24") g_format = WAV_S24;
+        else if (value == "f32") g_format = WAV_F32;
+        else {
+            cout << "--format must be s16, s24 or f32." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // threads splitting the file written by --render
+    if (name == "jobs") {
+        char *endptr = 0;
+        g_jobs = (int) strtol(value.c_str(), &endptr, 10);
+        if (*endptr != '\0' || value.empty() || g_jobs < 1 || g_jobs > OFFLINE_MAX_JOBS) {
+            cout << "--jobs must be an integer from 1 to " << OFFLINE_MAX_JOBS << "." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // sample rate of the stream or file
+    if (name == "srate") {
+        char *endptr = 0;
+        long srate = strtol(value.c_str(), &endptr, 10);
+        if (*endptr != '\0' || value.empty() || srate < 1000 || srate > 1000000) {
+            cout << "--srate must be an integer from 1000 to 1000000." << endl;
+            return -1;
+        }
+        g_srate = (unsigned int) srate;
+        return 1;
+    }
+
+    // resampling of a stream the device cannot run at --srate
+    if (name == "resample") {
+        if (value == "off") g_resample = RTAUDIO_RESAMPLE_NONE;
+        else if (value == "fast") g_resample = RTAUDIO_RESAMPLE_FAST;
+        else if (value == "medium") g_resample = RTAUDIO_RESAMPLE_MEDIUM;
+        else if (value == "best") g_resample = RTAUDIO_RESAMPLE_BEST;
+        else {
+            cout << "--resample must be one of off, fast, medium or best." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // transfer mode of an ALSA stream
+    if (name == "transfer") {
+        if (value == "rw") g_mmap = false;
+        else if (value == "mmap") g_mmap = true;
+        else {
+            cout << "--transfer must be rw or mmap." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // channels of the stream or file
+    if (name == "channels") {
+        g_channels = atoi(value.c_str());
+        if (value != "1" && value != "2" && value != "4" && value != "8") {
+            cout << "--channels must be 1, 2, 4 or 8." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    // seed of the noise generators
+    if (name == "seed") {
+        char *endptr = 0;
+        g_seed = strtoull(value.c_str(), &endptr, 10);
+        if (*endptr != '\0' || value.empty()) {
+            cout << "--seed must be a non-negative integer." << endl;
+            return -1;
+        }
+        return 1;
+    }
+
+    cout << "Unknown option --" << name << "." << endl;
+    return -1;
 }
 
 /*
  * @funtion check_args Provides error-checking and robustness on command line arguments given by a user.
  * @param argc Number of command line arguments.
  * @param arg Array of strings containing command line arguments.
- * @return An integer in range [1,5] signifying the signal. Returns -1 if there are any argument errors. 
+ * @return An integer in range [1,10] signifying the signal. Returns -1 if there are any argument errors. 
  */
 int check_args(int argc, const char* argv[]) {
 
     char *endptr = 0;
 
+        // pull out the --name=value options first so the positional arguments keep their places
+        int kept = 1;
+        for (int i = 1; i < argc; i++) {
+            int opt = parse_option(argv[i]);
+            if (opt == -1) return -1;
+            if (opt == 0) argv[kept++] = argv[i];
+        }
+        argc = kept;
+
         // error: ./sig_gen with no additional arguments
         if (argc <= 1) {
             cout << "Not enough arguments. Must at least give type of wave." << endl;
@@ -294,14 +545,178 @@ int check_args(int argc, const char* argv[]) {
         // error: more than five arguments
         if (argc > 5) cout << "Ignoring extraneous arguments..." << endl;
 
+        // build the octave tables once, before anything reads them
+        if (g_sig == 10) {
+            if (g_table_path.empty()) {
+                cout << "--wavetable needs a waveform file given with --table=." << endl;
+                return -1;
+            }
+            if (!wavetable_load(g_table, g_table_path.c_str())) {
+                cout << "Could not read a waveform from " << g_table_path << "." << endl;
+                return -1;
+            }
+            g_gen.table = &g_table;
+        }
+
+        // fill the voice bank: tones spaced evenly upwards from the frequency, sharing the signal's shape
+        if (g_voices > 0) {
+            int shape;
+            if (g_sig == 1) shape = BANK_SINE;
+            else if (g_sig == 2) shape = BANK_SAW;
+            else if (g_sig == 3) shape = BANK_PULSE;
+            else {
+                cout << "--voices works with --sine, --saw and --pulse only." << endl;
+                return -1;
+            }
+
+            if (!bank_init(g_bank, g_voices)) {
+                cout << "Not enough memory for " << g_voices << " voices." << endl;
+                return -1;
+            }
+
+            int skipped = 0;
+            for (int k = 0; k < g_voices; k++) {
+                double freq = g_freq + k * g_spacing;
+                if (freq >= g_srate / 2.0) { skipped++; continue; }
+                bank_add(g_bank, osc_phase(freq / g_srate), (float) (1.0 / g_voices), shape, g_width);
+            }
+            if (skipped > 0) cout << "Skipping " << skipped << " voices above Nyquist." << endl;
+
+            g_gen.bank = &g_bank;
+
+            // spread the voices over several cores
+            if (g_threads > 1) {
+                if (!pool_start(g_pool, g_bank, g_threads, g_srate)) {
+                    cout << "Could not start " << g_threads << " render threads." << endl;
+                    return -1;
+                }
+                g_gen.pool = &g_pool;
+            }
+        }
+
+        // a file has no input to ring modulate
+        if (!g_render_path.empty() && flag) {
+            cout << "--input needs a live stream and cannot be used with --render." << endl;
+            return -1;
+        }
+
+        // pick the render kernel once, now that the signal and --input flag are known
+        g_render = select_render(g_sig, flag, g_channels);
+        if (g_render == NULL) {
+            cout << "No render kernel for " << g_channels << " channels." << endl;
+            return -1;
+        }
+
         return g_sig;
 }
 
+/*
+ * @funtion control_loop Reads parameter changes from stdin and queues them for the audio
+            thread until an empty line (or end of input) is read. Runs on the main thread.
+ */
+void control_loop() {
+
+    string line;
+    while (getline(cin, line) && !line.empty()) {
+
+        char param = 0;
+        double value = 0;
+        if (sscanf(line.c_str(), " %c %lf", &param, &value) != 2) {
+            cout << "Expected f <frequency> or w <width>." << endl;
+            continue;
+        }
+
+        // frequency
+        if (param == 'f' && value > 0) {
+            if (!control_push(g_control, CONTROL_FREQ, value)) cout << "Control queue full." << endl;
+        }
+
+        // width
+        else if (param == 'w' && value > 0 && value < 1.0) {
+            if (!control_push(g_control, CONTROL_WIDTH, value)) cout << "Control queue full." << endl;
+        }
+
+        else {
+            cout << "The frequency must be above 0 and the width in the range (0, 1)." << endl;
+        }
+    }
+}
+
+/*
+ * @funtion free_generator Releases the wavetable, render threads and voice bank, printing
+            the timing of the render threads first.
+ */
+void free_generator() {
+
+    if (g_table.block != NULL) wavetable_free(g_table);
+    if (g_pool.block != NULL) {
+        const PoolStats &st = g_pool.stats;
+        cout << "voice pool: " << g_pool.threads << " threads, " << st.periods << " periods, "
+             << (st.periods > 0 ? st.busy / st.periods * 1e6 : 0) << " us mean, "
+             << st.worst * 1e6 << " us worst, " << st.misses << " late" << endl;
+        pool_stop(g_pool);
+    }
+    if (g_bank.block != NULL) bank_free(g_bank);
+}
+
+/*
+ * @funtion render_file Renders --seconds of the signal to the --render file as fast as
+            possible and reports how much faster than real time that was.
+ * @return Zero on success, one if the file could not be written.
+ */
+int render_file() {
+
+    OfflineSettings settings;
+    settings.path = g_render_path.c_str();
+    settings.format = g_format;
+    settings.channels = g_channels;
+    settings.srate = g_srate;
+    settings.frames = (uint64_t) (g_seconds * g_srate + 0.5);
+    settings.jobs = g_jobs;
+
+    // files named .wav get a header, anything else is raw interleaved samples
+    size_t dot = g_render_path.rfind('.');
+    string ext = dot == string::npos ? "" : g_render_path.substr(dot);
+    settings.wav = ext == ".wav" || ext == ".WAV";
+
+    // noise cannot skip ahead to the start of a later part
+    if (settings.jobs > 1 && (g_sig == 4 || g_sig == 6 || g_sig == 7)) {
+        cout << "Noise is rendered by a single job." << endl;
+        settings.jobs = 1;
+    }
+
+    OfflineStats stats;
+    if (!offline_render(settings, g_render, g_gen, stats)) {
+        cout << "Could not write " << g_render_path << "." << endl;
+        return 1;
+    }
+
+    cout << "rendered " << g_seconds << " s (" << stats.bytes / 1048576.0 << " MB) in "
+         << stats.seconds << " s: " << stats.factor << "x real time" << endl;
+    return 0;
+}
+
 int main(int argc, char const *argv[]) {
 
     // checks the command line args and determines the desired signal
     if ((g_sig = check_args(argc, argv)) == -1) exit(1);
 
+    // start the oscillator at the beginning of a period, with no ramp or pending changes
+    osc_init(g_gen.osc, g_freq, g_width, g_srate);
+    control_ramp_init(g_gen.ramp, g_width, g_srate);
+    control_init(g_control);
+
+    // give every channel its own reproducible noise sequence
+    for (int j = 0; j < RENDER_MAX_CHANNELS; j++)
+        noise_seed(g_gen.noise[j], g_seed, j);
+
+    // write a file instead of opening a stream
+    if (!g_render_path.empty()) {
+        int result = render_file();
+        free_generator();
+        return result;
+    }
+
     // instantiate RtAudio object
     RtAudio *audio = new RtAudio(RtAudio::MACOSX_CORE);
 
@@ -319,21 +734,38 @@ int main(int argc, char const *argv[]) {
     // let RtAudio print messages to stderr.
     audio->showWarnings(true);
 
-    // set input and output parameters
+    // every channel of a signal other than noise is the same, so render it once
+    // and let RtAudio copy it to each device channel while it converts the buffer
+    int streamChannels = g_channels;
+    if (g_sig != 4 && g_sig != 6 && g_sig != 7) {
+        streamChannels = 1;
+        g_render = select_render(g_sig, flag, 1);
+    }
+
+    // set input and output parameters (ring modulation only reads the first input channel)
     RtAudio::StreamParameters iParams, oParams;
     iParams.deviceId = audio->getDefaultInputDevice();
-    iParams.nChannels = MY_CHANNELS;
+    iParams.nChannels = streamChannels;
     iParams.firstChannel = 0;
     oParams.deviceId = audio->getDefaultOutputDevice();
-    oParams.nChannels = MY_CHANNELS;
+    oParams.nChannels = streamChannels;
     oParams.firstChannel = 0;
+    if (streamChannels < g_channels) {
+        oParams.mixChannels = g_channels;
+        oParams.mixMatrix.assign(g_channels, 1.0f);
+    }
 
-    // create stream options
+    // create stream options, keeping the stream at g_srate even if the device is not
     RtAudio::StreamOptions options;
+    options.resampleQuality = g_resample;
+    if (g_mmap) options.flags |= RTAUDIO_ALSA_MMAP;
+
+    // the voice pool's workers already hold the spare cores
+    if (g_gen.pool != NULL) options.convertThreads = 0;
 
     try {
         // open a stream
-        audio->openStream(&oParams, &iParams, MY_FORMAT, MY_SRATE, &bufferFrames,
+        audio->openStream(&oParams, &iParams, MY_FORMAT, g_srate, &bufferFrames,
             &audio_callback, (void *) &bufferBytes, &options);
     }
     catch(RtError& e)
@@ -343,20 +775,24 @@ int main(int argc, char const *argv[]) {
     }
 
     // compute
-    bufferBytes = bufferFrames * MY_CHANNELS * sizeof(SAMPLE);
+    bufferBytes = bufferFrames * streamChannels * sizeof(SAMPLE);
 
     // test RtAudio functionality for reporting latency.
     cout << "stream latency: " << audio->getStreamLatency() << " frames" << endl;
+    cout << "stream conversion: " << audio->getStreamConversion() << endl;
+
+    // ring modulation multiplies by input from this many frames before the output it makes
+    if (flag) cout << "round trip: " << audio->getStreamDuplexOffset() << " frames" << endl;
 
     // go for it
     try {
         // start stream
         audio->startStream();
 
-        // get input
-        char input;
+        // read live parameter changes until an empty line
         std::cout << "running... press <enter> to quit (buffer frames: " << bufferFrames << ")" << endl;
-        std::cin.get(input);
+        std::cout << "type f <frequency> or w <width> to retune the running generator" << endl;
+        control_loop();
 
         // stop the stream.
         audio->stopStream();
@@ -373,5 +809,7 @@ int main(int argc, char const *argv[]) {
         if(audio->isStreamOpen())
             audio->closeStream();
 
+        free_generator();
+
     return 0;
 }
@@ -0,0 +1,188 @@
+//-----------------------------------------------------------------------------
+// name: sine.cpp
+// desc: block sine generator with selectable accuracy tiers (see sine.h).
+//
+//       The polynomial tiers reduce the phase in integer arithmetic and
+//       evaluate an odd polynomial (see sine_simd.h), on doubles or on floats.
+//-----------------------------------------------------------------------------
+#include "sine.h"
+#include "sine_simd.h"
+#include <math.h>
+
+/* -------------------------scalar------------------- */
+
+static void sine_exact(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    for (unsigned int i = 0; i < numFrames; i++)
+        out[i] = sin((uint32_t) (phase + i * inc) * SINE_RAD);
+}
+
+static void sine_poly_scalar(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    for (unsigned int i = 0; i < numFrames; i++)
+        out[i] = sine_poly(sine_fold(phase + i * inc) * SINE_RAD);
+}
+
+static void sine_fast_scalar(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    for (unsigned int i = 0; i < numFrames; i++)
+        out[i] = sine_polyf(sine_fold(phase + i * inc) * (float) SINE_RAD);
+}
+
+/*
+ * Four interleaved rotators, each stepping every fourth frame by a fixed
+ * complex rotation. The rotators are rebuilt from the exact phase on every
+ * call, so rounding error never accumulates for longer than one block. The
+ * fixed-length lane loop is left for the compiler to vectorize.
+ */
+static void sine_rotation(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    double re[4], im[4];
+    for (int k = 0; k < 4; k++) {
+        double a = (uint32_t) (phase + k * inc) * SINE_RAD;
+        re[k] = cos(a);
+        im[k] = sin(a);
+    }
+
+    double step = (uint32_t) (4 * inc) * SINE_RAD;
+    double c = cos(step);
+    double s = sin(step);
+
+    unsigned int i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        for (int k = 0; k < 4; k++) {
+            out[i + k] = im[k];
+            double r = re[k] * c - im[k] * s;
+            im[k] = re[k] * s + im[k] * c;
+            re[k] = r;
+        }
+    }
+    for (int k = 0; i < numFrames; i++, k++)
+        out[i] = im[k];
+}
+
+/* --------------------------SSE2-------------------- */
+
+#if defined(CPU_SSE2)
+
+static void sine_poly_sse2(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    __m128i p = _mm_setr_epi32(phase, phase + inc, phase + 2 * inc, phase + 3 * inc);
+    __m128i step = _mm_set1_epi32(4 * inc);
+    __m128d rad = _mm_set1_pd(SINE_RAD);
+
+    unsigned int i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128i s = sine_fold_sse2(p);
+        __m128d lo = _mm_mul_pd(_mm_cvtepi32_pd(s), rad);
+        __m128d hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2))), rad);
+        _mm_storeu_pd(out + i, sine_poly_sse2(lo));
+        _mm_storeu_pd(out + i + 2, sine_poly_sse2(hi));
+        p = _mm_add_epi32(p, step);
+    }
+    sine_poly_scalar(phase + i * inc, inc, out + i, numFrames - i);
+}
+
+static void sine_fast_sse2(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    __m128i p = _mm_setr_epi32(phase, phase + inc, phase + 2 * inc, phase + 3 * inc);
+    __m128i step = _mm_set1_epi32(4 * inc);
+    __m128 rad = _mm_set1_ps((float) SINE_RAD);
+
+    unsigned int i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 y = sine_polyf_sse2(_mm_mul_ps(_mm_cvtepi32_ps(sine_fold_sse2(p)), rad));
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(y));
+        _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(y, y)));
+        p = _mm_add_epi32(p, step);
+    }
+    sine_fast_scalar(phase + i * inc, inc, out + i, numFrames - i);
+}
+
+#endif
+
+/* --------------------------AVX2-------------------- */
+
+#if defined(CPU_AVX2)
+
+CPU_AVX2_TARGET
+static __m256i sine_phases_avx2(uint32_t phase, uint32_t inc) {
+    return _mm256_setr_epi32(phase, phase + inc, phase + 2 * inc, phase + 3 * inc,
+                             phase + 4 * inc, phase + 5 * inc, phase + 6 * inc, phase + 7 * inc);
+}
+
+CPU_AVX2_TARGET
+static void sine_poly_avx2(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    __m256i p = sine_phases_avx2(phase, inc);
+    __m256i step = _mm256_set1_epi32(8 * inc);
+    __m256d rad = _mm256_set1_pd(SINE_RAD);
+
+    unsigned int i = 0;
+    for (; i + 8 <= numFrames; i += 8) {
+        __m256i s = sine_fold_avx2(p);
+        __m256d lo = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(s)), rad);
+        __m256d hi = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(s, 1)), rad);
+        _mm256_storeu_pd(out + i, sine_poly_avx2(lo));
+        _mm256_storeu_pd(out + i + 4, sine_poly_avx2(hi));
+        p = _mm256_add_epi32(p, step);
+    }
+    sine_poly_scalar(phase + i * inc, inc, out + i, numFrames - i);
+}
+
+CPU_AVX2_TARGET
+static void sine_fast_avx2(uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    __m256i p = sine_phases_avx2(phase, inc);
+    __m256i step = _mm256_set1_epi32(8 * inc);
+    __m256 rad = _mm256_set1_ps((float) SINE_RAD);
+
+    unsigned int i = 0;
+    for (; i + 8 <= numFrames; i += 8) {
+        __m256 y = sine_polyf_avx2(_mm256_mul_ps(_mm256_cvtepi32_ps(sine_fold_avx2(p)), rad));
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(y)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)));
+        p = _mm256_add_epi32(p, step);
+    }
+    sine_fast_scalar(phase + i * inc, inc, out + i, numFrames - i);
+}
+
+#endif
+
+/* --------------------------public------------------ */
+
+void sine_block(SineQuality quality, uint32_t phase, uint32_t inc, double *out, unsigned int numFrames) {
+    switch(quality) {
+
+        case SINE_POLY:
+#if defined(CPU_AVX2)
+            if (cpu_has_avx2()) { sine_poly_avx2(phase, inc, out, numFrames); return; }
+#endif
+#if defined(CPU_SSE2)
+            sine_poly_sse2(phase, inc, out, numFrames);
+#else
+            sine_poly_scalar(phase, inc, out, numFrames);
+#endif
+            return;
+
+        case SINE_FAST:
+#if defined(CPU_AVX2)
+            if (cpu_has_avx2()) { sine_fast_avx2(phase, inc, out, numFrames); return; }
+#endif
+#if defined(CPU_SSE2)
+            sine_fast_sse2(phase, inc, out, numFrames);
+#else
+            sine_fast_scalar(phase, inc, out, numFrames);
+#endif
+            return;
+
+        case SINE_ROTATION:
+            sine_rotation(phase, inc, out, numFrames);
+            return;
+
+        default:
+            sine_exact(phase, inc, out, numFrames);
+            return;
+    }
+}
+
+const char *sine_quality_name(SineQuality quality) {
+    switch(quality) {
+        case SINE_POLY: return "poly";
+        case SINE_FAST: return "fast";
+        case SINE_ROTATION: return "rotation";
+        default: return "exact";
+    }
+}
@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// name: sine.h
+// desc: block sine generator with selectable accuracy tiers.
+//
+//       Fills a run of consecutive frames of sin(2 * pi * phase) straight
+//       from the oscillator's 32-bit phase accumulator. The polynomial tiers
+//       use SSE2, or AVX2 when the CPU reports it at run time, and produce
+//       4 to 8 frames per instruction.
+//-----------------------------------------------------------------------------
+#ifndef __SINE_H
+#define __SINE_H
+
+#include <stdint.h>
+
+// accuracy tiers, from most to least accurate
+enum SineQuality {
+    SINE_EXACT,     // libm sin() per frame (reference, slowest)
+    SINE_POLY,      // double precision odd polynomial, max error < 6e-8
+    SINE_FAST,      // single precision odd polynomial, max error < 5e-7
+    SINE_ROTATION   // complex rotation, resynchronized every block, max error < 1e-12
+};
+
+/*
+ * @function sine_block Renders numFrames consecutive frames of a sine.
+ * @param quality Accuracy tier to use.
+ * @param phase Accumulator phase of the first frame.
+ * @param inc Accumulator increment per frame.
+ * @param out Mono output buffer of numFrames samples.
+ * @param numFrames Number of frames to render.
+ */
+void sine_block(SineQuality quality, uint32_t phase, uint32_t inc, double *out, unsigned int numFrames);
+
+/*
+ * @function sine_quality_name Name of a tier as accepted by --quality=.
+ * @param quality Accuracy tier.
+ * @return Tier name.
+ */
+const char *sine_quality_name(SineQuality quality);
+
+#endif
@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+// name: sine_simd.h
+// desc: sine primitives shared by the block sine generator and the oscillator bank.
+//
+//       Phases are 32-bit accumulator values. Read as a signed value the
+//       accumulator covers [-pi, pi), and folding the outer quarters back
+//       onto [-pi/2, pi/2] uses sin(pi - x) = sin(x). What is left is an odd
+//       degree-11 Taylor polynomial, on doubles or on floats, scalar or SIMD.
+//-----------------------------------------------------------------------------
+#ifndef __SINE_SIMD_H
+#define __SINE_SIMD_H
+
+#include "cpu.h"
+#include <stdint.h>
+
+// radians per accumulator step
+#define SINE_RAD (6.28318530717958647692 / 4294967296.0)
+
+// a quarter period (pi / 2) in accumulator steps
+#define SINE_QUARTER 0x40000000
+
+// Taylor coefficients of sin(x)
+#define SINE_C3 (-1.0 / 6.0)
+#define SINE_C5 (1.0 / 120.0)
+#define SINE_C7 (-1.0 / 5040.0)
+#define SINE_C9 (1.0 / 362880.0)
+#define SINE_C11 (-1.0 / 39916800.0)
+
+/* -------------------------scalar------------------- */
+
+// folds a phase onto [-pi/2, pi/2], still in accumulator steps
+inline int32_t sine_fold(uint32_t phase) {
+    int32_t s = (int32_t) phase;
+    if (s > SINE_QUARTER || s < -SINE_QUARTER) s = (int32_t) (0x80000000u - phase);
+    return s;
+}
+
+inline double sine_poly(double x) {
+    double x2 = x * x;
+    return x + x * x2 * (SINE_C3 + x2 * (SINE_C5 + x2 * (SINE_C7 + x2 * (SINE_C9 + x2 * SINE_C11))));
+}
+
+inline float sine_polyf(float x) {
+    float x2 = x * x;
+    return x + x * x2 * ((float) SINE_C3 + x2 * ((float) SINE_C5 + x2 * ((float) SINE_C7
+        + x2 * ((float) SINE_C9 + x2 * (float) SINE_C11))));
+}
+
+/* --------------------------SSE2-------------------- */
+
+#if defined(CPU_SSE2)
+
+inline __m128i sine_fold_sse2(__m128i s) {
+    __m128i m = _mm_or_si128(_mm_cmpgt_epi32(s, _mm_set1_epi32(SINE_QUARTER)),
+                             _mm_cmplt_epi32(s, _mm_set1_epi32(-SINE_QUARTER)));
+    __m128i f = _mm_sub_epi32(_mm_set1_epi32((int) 0x80000000u), s);
+    return _mm_or_si128(_mm_and_si128(m, f), _mm_andnot_si128(m, s));
+}
+
+inline __m128d sine_poly_sse2(__m128d x) {
+    __m128d x2 = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(SINE_C11);
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SINE_C9));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SINE_C7));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SINE_C5));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(SINE_C3));
+    return _mm_add_pd(x, _mm_mul_pd(_mm_mul_pd(x, x2), p));
+}
+
+inline __m128 sine_polyf_sse2(__m128 x) {
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps((float) SINE_C11);
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps((float) SINE_C9));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps((float) SINE_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps((float) SINE_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps((float) SINE_C3));
+    return _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, x2), p));
+}
+
+#endif
+
+/* --------------------------AVX2-------------------- */
+
+#if defined(CPU_AVX2)
+
+CPU_AVX2_TARGET
+inline __m256i sine_fold_avx2(__m256i s) {
+    __m256i m = _mm256_or_si256(_mm256_cmpgt_epi32(s, _mm256_set1_epi32(SINE_QUARTER)),
+                                _mm256_cmpgt_epi32(_mm256_set1_epi32(-SINE_QUARTER), s));
+    __m256i f = _mm256_sub_epi32(_mm256_set1_epi32((int) 0x80000000u), s);
+    return _mm256_blendv_epi8(s, f, m);
+}
+
+CPU_AVX2_TARGET
+inline __m256d sine_poly_avx2(__m256d x) {
+    __m256d x2 = _mm256_mul_pd(x, x);
+    __m256d p = _mm256_set1_pd(SINE_C11);
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(SINE_C9));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(SINE_C7));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(SINE_C5));
+    p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(SINE_C3));
+    return _mm256_add_pd(x, _mm256_mul_pd(_mm256_mul_pd(x, x2), p));
+}
+
+CPU_AVX2_TARGET
+inline __m256 sine_polyf_avx2(__m256 x) {
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps((float) SINE_C11);
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps((float) SINE_C9));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps((float) SINE_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps((float) SINE_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps((float) SINE_C3));
+    return _mm256_add_ps(x, _mm256_mul_ps(_mm256_mul_ps(x, x2), p));
+}
+
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// name: alias.cpp
+// desc: checks that the band-limited saw and pulse from blep.h fold less
+//       energy back below Nyquist than the naive shapes from oscillator.h.
+//
+//       The fundamental sits exactly on a DFT bin and the accumulator period
+//       divides the window, so every harmonic below Nyquist lands on a
+//       multiple of that bin and anything on another bin is aliasing. Exits
+//       non-zero if a band-limited shape does not beat its naive shape by
+//       MIN_GAIN dB at every width and frequency tried.
+//-----------------------------------------------------------------------------
+#include "../blep.h"
+#include <stdio.h>
+
+#define SRATE 48000
+#define N 4096
+#define MIN_GAIN 6.0
+
+// one period of the DFT's twiddle factors
+static double tcos[N], tsin[N];
+
+/*
+ * @function aliasing Energy outside the harmonics, relative to all energy.
+ * @param x N samples of a signal whose fundamental is on bin k0.
+ * @param k0 Bin of the fundamental. Odd, so its multiples never wrap onto each other.
+ * @return Ratio in dB.
+ */
+static double aliasing(const double *x, int k0) {
+    double harmonic = 0, other = 0;
+    for (int k = 1; k <= N / 2; k++) {
+        double a = 0, b = 0;
+        for (int n = 0; n < N; n++) {
+            int j = (int) ((long) k * n % N);
+            a += x[n] * tcos[j];
+            b -= x[n] * tsin[j];
+        }
+        if (k % k0 == 0) harmonic += a * a + b * b;
+        else other += a * a + b * b;
+    }
+    return 10 * log10(other / (harmonic + other));
+}
+
+int main() {
+    static double naive[N], limited[N];
+    static const int bins[] = { 23, 187, 701 };
+    static const double widths[] = { 0.5, 0.25, 0.9 };
+    int failed = 0;
+
+    for (int n = 0; n < N; n++) {
+        tcos[n] = cos(OSC_TWO_PI * n / N);
+        tsin[n] = sin(OSC_TWO_PI * n / N);
+    }
+
+    printf("aliased energy in dB below the total, %d point DFT at %d Hz\n", N, SRATE);
+    printf("%-6s %9s %6s %10s %10s\n", "shape", "freq", "width", "naive", "blep");
+
+    for (int shape = 0; shape < 2; shape++) {
+        for (int f = 0; f < 3; f++) {
+            for (int w = 0; w < 3; w++) {
+                Oscillator osc;
+                osc_init(osc, (double) bins[f] * SRATE / N, widths[w], SRATE);
+
+                Oscillator o = osc;
+                for (int n = 0; n < N; n++) {
+                    naive[n] = shape ? osc_pulse(o) : osc_saw(o);
+                    osc_tick(o);
+                }
+                o = osc;
+                if (shape) blep_pulse(o, limited, N);
+                else blep_saw(o, limited, N);
+
+                double a = aliasing(naive, bins[f]);
+                double b = aliasing(limited, bins[f]);
+                bool ok = a - b >= MIN_GAIN;
+                if (!ok) failed++;
+                printf("%-6s %9.1f %6.2f %10.1f %10.1f%s\n", shape ? "pulse" : "saw",
+                       (double) bins[f] * SRATE / N, widths[w], a, b, ok ? "" : "  FAILED");
+            }
+        }
+    }
+
+    if (failed) {
+        printf("%d case(s) alias within %.0f dB of the naive shape\n", failed, MIN_GAIN);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,272 @@
+//-----------------------------------------------------------------------------
+// name: convert.cpp
+// desc: checks the sample format conversions of RtConvert.cpp against its
+//       one-sample-at-a-time formulas, bit for bit.
+//
+//       The file is included whole, for the scalar references it keeps to
+//       itself (rtScalar, rtSwapScalar and rtMeterScalar). Every kernel,
+//       byte swap and meter the running CPU picks is compared with them on
+//       odd lengths and unaligned starts, and every conversion plan with
+//       interleaved and per-channel buffers on either side, byte swapped or
+//       not, for channel counts that take the tiled transposes and those
+//       that do not. Floating-point input mixes in-range samples with ones
+//       beyond plus/minus 1, the largest values, infinities and NaNs. Output
+//       is surrounded by guard bytes no store may touch. Exits non-zero if
+//       anything differs.
+//-----------------------------------------------------------------------------
+#include "../RtConvert.cpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+
+#define GUARD 64
+#define GUARD_BYTE 0x5a
+#define MAX_SAMPLES 4099
+
+static const RtAudioFormat formats[] = { RTAUDIO_SINT8, RTAUDIO_SINT16, RTAUDIO_SINT24_PACKED,
+                                         RTAUDIO_SINT24, RTAUDIO_SINT32, RTAUDIO_FLOAT32,
+                                         RTAUDIO_FLOAT64 };
+static const char *names[] = { "s8", "s16", "s24p", "s24", "s32", "f32", "f64" };
+static const int bytes[] = { 1, 2, 3, 4, 4, 4, 8 };
+
+static unsigned int seed = 1;
+static unsigned int rnd() { seed = seed * 1664525u + 1013904223u; return seed >> 8; }
+
+template <class In> static RtConvertKernel scalarTo( int o ) {
+    if ( o == 0 ) return &rtScalar<In, RtS8>;
+    if ( o == 1 ) return &rtScalar<In, RtS16>;
+    if ( o == 2 ) return &rtScalar<In, RtS24P>;
+    if ( o == 3 ) return &rtScalar<In, RtS24>;
+    if ( o == 4 ) return &rtScalar<In, RtS32>;
+    if ( o == 5 ) return &rtScalar<In, RtF32>;
+    return &rtScalar<In, RtF64>;
+}
+
+// the one-sample-at-a-time conversion between formats i and o
+static RtConvertKernel scalar( int i, int o ) {
+    if ( i == 0 ) return scalarTo<RtS8>( o );
+    if ( i == 1 ) return scalarTo<RtS16>( o );
+    if ( i == 2 ) return scalarTo<RtS24P>( o );
+    if ( i == 3 ) return scalarTo<RtS24>( o );
+    if ( i == 4 ) return scalarTo<RtS32>( o );
+    if ( i == 5 ) return scalarTo<RtF32>( o );
+    return scalarTo<RtF64>( o );
+}
+
+static RtConvertKernel swapScalar( int b ) {
+    if ( b == 2 ) return &rtSwapScalar<2>;
+    if ( b == 3 ) return &rtSwapScalar<3>;
+    if ( b == 4 ) return &rtSwapScalar<4>;
+    return &rtSwapScalar<8>;
+}
+
+// A floating-point sample: mostly within plus/minus 2.5, with every
+// edge case the conversions clamp, saturate or pass through mixed in.
+static double floatSample( bool single ) {
+    static const double edges[] = { 0.0, -0.0, 1.0, -1.0, 1.0 + 1e-7, -1.0 - 1e-7, 1.0 - 1e-9,
+                                    0.5, -0.5, 1e30, -1e30, DBL_MIN, -DBL_MIN, 4e-320,
+                                    HUGE_VAL, -HUGE_VAL, NAN, -NAN };
+    unsigned int r = rnd();
+    if ( r % 4 == 0 ) {
+        double v = edges[( r >> 2 ) % ( sizeof( edges ) / sizeof( edges[0] ) )];
+        if ( single && v == 1e30 ) v = FLT_MAX;
+        if ( single && v == -1e30 ) v = -FLT_MAX;
+        return v;
+    }
+    return ( (double) ( r & 0xfffff ) / 0x80000 - 1.0 ) * 2.5;
+}
+
+// fills n samples of format f, integers with any bits at all
+static void fill( char *buffer, int f, unsigned int n ) {
+    if ( formats[f] == RTAUDIO_FLOAT32 ) {
+        for ( unsigned int i = 0; i < n; i++ ) ( (float *) buffer )[i] = (float) floatSample( true );
+    }
+    else if ( formats[f] == RTAUDIO_FLOAT64 ) {
+        for ( unsigned int i = 0; i < n; i++ ) ( (double *) buffer )[i] = floatSample( false );
+    }
+    else {
+        for ( unsigned int i = 0; i < n * bytes[f]; i++ ) buffer[i] = (char) rnd();
+    }
+}
+
+// A buffer with guard bytes on both sides.
+struct Guarded {
+    std::vector<char> data;
+    Guarded( size_t size ) : data( size + 2 * GUARD, (char) GUARD_BYTE ) {}
+    char *get() { return &data[GUARD]; }
+    bool intact() {
+        for ( int i = 0; i < GUARD; i++ )
+            if ( data[i] != (char) GUARD_BYTE || data[data.size() - 1 - i] != (char) GUARD_BYTE ) return false;
+        return true;
+    }
+};
+
+static int failed = 0;
+
+static void check( bool ok, const char *what, int i, int o, unsigned int n, const char *layout ) {
+    if ( ok ) return;
+    if ( failed++ < 20 )
+        printf( "FAILED: %s %s to %s, %u samples%s%s\n", what, names[i], names[o], n,
+                layout[0] ? ", " : "", layout );
+}
+
+// Every contiguous kernel against its scalar reference, starting on a
+// sample boundary that is and one that is not vector aligned.
+static int kernels() {
+    static const unsigned int lengths[] = { 0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 255, 1001, MAX_SAMPLES };
+    int tried = 0;
+    for ( int i = 0; i < 7; i++ ) {
+        for ( int o = 0; o < 7; o++ ) {
+            RtConvertKernel kernel = rtConvertKernel( formats[i], formats[o] );
+            if ( kernel == NULL ) continue;
+            tried++;
+            for ( unsigned int l = 0; l < sizeof( lengths ) / sizeof( lengths[0] ); l++ ) {
+                for ( int skew = 0; skew < 2; skew++ ) {
+                    unsigned int n = lengths[l];
+                    std::vector<char> in( ( n + 1 ) * bytes[i] );
+                    Guarded out( n * bytes[o] ), ref( n * bytes[o] );
+                    fill( &in[0], i, n + 1 );
+                    const char *src = &in[skew * bytes[i]];
+                    kernel( out.get(), src, n );
+                    scalar( i, o )( ref.get(), src, n );
+                    check( out.intact() && memcmp( out.get(), ref.get(), n * bytes[o] ) == 0,
+                           "kernel", i, o, n, skew ? "unaligned" : "" );
+                }
+            }
+        }
+    }
+    return tried;
+}
+
+// The byte swaps, out of place and in place, and the meters.
+static void swapsAndMeters() {
+    for ( int f = 1; f < 7; f++ ) {
+        RtConvertKernel swap = rtSwapKernel( formats[f] );
+        for ( unsigned int n = 0; n < 200; n += ( n < 70 ? 1 : 43 ) ) {
+            std::vector<char> in( n * bytes[f] + 1 );
+            Guarded out( n * bytes[f] ), ref( n * bytes[f] );
+            fill( &in[0], f, n );
+            swap( out.get(), &in[0], n );
+            swapScalar( bytes[f] )( ref.get(), &in[0], n );
+            check( out.intact() && memcmp( out.get(), ref.get(), n * bytes[f] ) == 0, "swap", f, f, n, "" );
+            swap( &in[0], &in[0], n );
+            check( memcmp( &in[0], ref.get(), n * bytes[f] ) == 0, "swap", f, f, n, "in place" );
+        }
+    }
+
+    for ( int f = 5; f < 7; f++ ) {
+        RtMeterKernel meter = rtMeterKernel( formats[f] );
+        RtMeterKernel reference = ( f == 5 ) ? &rtMeterScalar<RtF32> : &rtMeterScalar<RtF64>;
+        for ( unsigned int n = 0; n < 300; n += ( n < 70 ? 1 : 37 ) ) {
+            std::vector<char> in( n * bytes[f] + 8 );
+            fill( &in[0], f, n );
+            double peak = -1.0, refPeak = -1.0;
+            unsigned int clipped = meter( &in[0], n, &peak );
+            unsigned int refClipped = reference( &in[0], n, &refPeak );
+            check( clipped == refClipped && memcmp( &peak, &refPeak, sizeof( double ) ) == 0,
+                   "meter", f, f, n, "" );
+        }
+    }
+}
+
+// A whole buffer through a conversion plan, set up the way
+// RtApi::setConvertInfo does it, against the references one sample at a
+// time. The device has one channel more than the user side, which skips
+// it, so the device side never starts at sample 0.
+static void plan( int userFormat, int deviceFormat, bool output, bool userInterleaved,
+                  bool deviceInterleaved, bool byteSwap, int channels, unsigned int frames ) {
+    int deviceChannels = channels + 1;
+    int i = output ? userFormat : deviceFormat, o = output ? deviceFormat : userFormat;
+    unsigned int inChannels = output ? channels : deviceChannels;
+    unsigned int outChannels = output ? deviceChannels : channels;
+    bool inInterleaved = output ? userInterleaved : deviceInterleaved;
+    bool outInterleaved = output ? deviceInterleaved : userInterleaved;
+
+    RtConvertPlan plan;
+    plan.channels = channels;
+    plan.inJump = inInterleaved ? inChannels : 1;
+    plan.outJump = outInterleaved ? outChannels : 1;
+    plan.inStride = inInterleaved ? 1 : frames;
+    plan.outStride = outInterleaved ? 1 : frames;
+    plan.inBase = output ? 0 : plan.inStride;
+    plan.outBase = output ? plan.outStride : 0;
+    if ( channels == 1 ) plan.inStride = plan.outStride = 0;
+    if ( byteSwap ) {
+        plan.swap = rtSwapKernel( formats[deviceFormat] );
+        plan.swapInput = !output;
+        plan.swapChannels = deviceChannels;
+        plan.swapStride = deviceInterleaved ? 1 : frames;
+        plan.swapPitch = deviceInterleaved ? deviceChannels : 1;
+    }
+    rtConvertPrepare( plan, formats[i], formats[o] );
+
+    unsigned int inSamples = inChannels * frames, outSamples = outChannels * frames;
+    std::vector<char> in( inSamples * bytes[i] + 1 );
+    Guarded out( outSamples * bytes[o] ), ref( outSamples * bytes[o] );
+    fill( &in[0], i, inSamples );
+    fill( out.get(), o, outSamples );
+    memcpy( ref.get(), out.get(), outSamples * bytes[o] );
+
+    // the device samples as the conversion sees them
+    std::vector<char> source( in );
+    if ( byteSwap && !output ) swapScalar( bytes[i] )( &source[0], &in[0], inSamples );
+
+    RtConvertKernel kernel = scalar( i, o );
+    for ( unsigned int f = 0; f < frames; f++ ) {
+        for ( int k = 0; k < channels; k++ ) {
+            int s = plan.inBase + k * plan.inStride + f * plan.inJump;
+            int d = plan.outBase + k * plan.outStride + f * plan.outJump;
+            kernel( ref.get() + d * bytes[o], &source[s * bytes[i]], 1 );
+        }
+    }
+    if ( byteSwap && output ) swapScalar( bytes[o] )( ref.get(), ref.get(), outSamples );
+
+    plan.function( plan, out.get(), &in[0], frames );
+
+    char layout[128];
+    snprintf( layout, sizeof( layout ), "%s, %d of %d channels %s to %s%s (%s)",
+              output ? "output" : "input", channels, deviceChannels,
+              inInterleaved ? "interleaved" : "in blocks", outInterleaved ? "interleaved" : "in blocks",
+              byteSwap ? ", swapped" : "", plan.name.c_str() );
+    bool ok = out.intact() && memcmp( out.get(), ref.get(), outSamples * bytes[o] ) == 0;
+    if ( byteSwap && !output ) ok = ok && memcmp( &in[0], &source[0], inSamples * bytes[i] ) == 0;
+    check( ok, "plan", i, o, frames, layout );
+}
+
+int main() {
+    static const int channels[] = { 1, 2, 3, 4, 5, 8, 16, 31, 32, 33, 600 };
+    static const unsigned int frames[] = { 1, 7, 67, 1001 };
+
+    printf( "conversions against the scalar references (%s)\n", rtConvertIsa() );
+    int tried = kernels();
+    printf( "%d kernels\n", tried );
+    swapsAndMeters();
+    printf( "swaps and meters\n" );
+
+    int plans = 0;
+    for ( int u = 0; u < 7; u++ ) {
+        for ( int d = 0; d < 7; d++ ) {
+            for ( int layout = 0; layout < 16; layout++ ) {
+                bool byteSwap = ( layout & 8 ) != 0;
+                if ( byteSwap && bytes[d] == 1 ) continue;
+                for ( unsigned int c = 0; c < sizeof( channels ) / sizeof( channels[0] ); c++ ) {
+                    for ( unsigned int f = 0; f < sizeof( frames ) / sizeof( frames[0] ); f++ ) {
+                        if ( channels[c] * frames[f] > 40000 ) continue;
+                        plan( u, d, layout & 1, ( layout & 2 ) != 0, ( layout & 4 ) != 0, byteSwap,
+                              channels[c], frames[f] );
+                        plans++;
+                    }
+                }
+            }
+        }
+    }
+    printf( "%d plans\n", plans );
+
+    if ( failed ) {
+        printf( "%d case(s) differ from the scalar references\n", failed );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+//-----------------------------------------------------------------------------
+// name: wavetable.cpp
+// desc: mip-mapped wavetable oscillator (see wavetable.h).
+//
+//       The top WT_BITS of the accumulator phase index a table point and the
+//       remaining 21 bits are the fraction between two points. Table k keeps
+//       harmonics 1 to (WT_SIZE / 2) >> k, so it is alias-free as long as the
+//       phase moves at most 2^k points per frame.
+//-----------------------------------------------------------------------------
+#include "wavetable.h"
+#include "cpu.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define WT_TWO_PI 6.28318530717958647692
+
+// accumulator bits below the table index, and their scale into [0, 1)
+#define WT_FRAC_BITS (32 - WT_BITS)
+#define WT_FRAC_SCALE (1.0f / (1 << WT_FRAC_BITS))
+
+/* -------------------------loading------------------ */
+
+bool wavetable_load(Wavetable &wt, const char *path) {
+    wt.data = NULL;
+    wt.block = NULL;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    std::vector<float> cycle;
+    float buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, sizeof(float), 1024, file)) > 0)
+        cycle.insert(cycle.end(), buffer, buffer + n);
+    fclose(file);
+
+    size_t length = cycle.size();
+    if (length < 2) return false;
+
+    // analyze the cycle into harmonics (plain DFT, done once at load time)
+    size_t harmonics = length / 2 < WT_SIZE / 2 ? length / 2 : WT_SIZE / 2;
+    std::vector<double> re(harmonics + 1), im(harmonics + 1);
+    std::vector<double> cosines(length), sines(length);
+    for (size_t i = 0; i < length; i++) {
+        cosines[i] = cos(WT_TWO_PI * i / length);
+        sines[i] = sin(WT_TWO_PI * i / length);
+    }
+    for (size_t h = 0; h <= harmonics; h++) {
+        double a = 0, b = 0;
+        size_t k = 0;
+        for (size_t i = 0; i < length; i++) {
+            a += cycle[i] * cosines[k];
+            b += cycle[i] * sines[k];
+            k += h;
+            if (k >= length) k -= length;
+        }
+        re[h] = a / length;
+        im[h] = b / length;
+    }
+
+    // one aligned block for every table
+    wt.block = malloc(WT_LEVELS * WT_STRIDE * sizeof(float) + 63);
+    if (wt.block == NULL) return false;
+    wt.data = (float *) (((uintptr_t) wt.block + 63) & ~(uintptr_t) 63);
+
+    // rebuild each octave from the harmonics it may hold
+    std::vector<double> table(WT_SIZE), tcos(WT_SIZE), tsin(WT_SIZE);
+    for (int i = 0; i < WT_SIZE; i++) {
+        tcos[i] = cos(WT_TWO_PI * i / WT_SIZE);
+        tsin[i] = sin(WT_TWO_PI * i / WT_SIZE);
+    }
+
+    double peak = 0;
+    for (int level = 0; level < WT_LEVELS; level++) {
+        size_t top = (WT_SIZE / 2) >> level;
+        if (top > harmonics) top = harmonics;
+
+        for (int i = 0; i < WT_SIZE; i++) {
+            double s = re[0];
+            for (size_t h = 1; h <= top; h++) {
+                size_t k = (h * i) & (WT_SIZE - 1);
+
+                // the Nyquist bin of an even-length cycle has no mirror image and no sine part
+                if (2 * h == length) s += re[h] * tcos[k];
+                else s += 2.0 * (re[h] * tcos[k] + im[h] * tsin[k]);
+            }
+            table[i] = s;
+            if (level == 0 && fabs(s) > peak) peak = fabs(s);
+        }
+
+        // point j of the table is stored at j + 1, with wrapped guards on both sides
+        float *t = wt.data + level * WT_STRIDE;
+        double gain = peak > 0 ? 1.0 / peak : 1.0;
+        for (int i = 0; i < WT_SIZE; i++) t[i + 1] = (float) (table[i] * gain);
+        t[0] = t[WT_SIZE];
+        t[WT_SIZE + 1] = t[1];
+        t[WT_SIZE + 2] = t[2];
+    }
+
+    return true;
+}
+
+void wavetable_free(Wavetable &wt) {
+    free(wt.block);
+    wt.block = NULL;
+    wt.data = NULL;
+}
+
+/* --------------------------render------------------ */
+
+// picks the octave table whose harmonics stay below Nyquist for this increment
+static int wavetable_level(uint32_t inc) {
+    int level = 0;
+    uint32_t points = (inc - 1) >> WT_FRAC_BITS;
+    while (points > 0 && level < WT_LEVELS - 1) {
+        points >>= 1;
+        level++;
+    }
+    return level;
+}
+
+static inline float wavetable_cubic(const float *t, float f) {
+    float ym1 = t[-1], y0 = t[0], y1 = t[1], y2 = t[2];
+    float c1 = 0.5f * (y1 - ym1);
+    float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+    float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+    return ((c3 * f + c2) * f + c1) * f + y0;
+}
+
+static void wavetable_scalar(const float *t, bool cubic, uint32_t phase, uint32_t inc,
+                             double *out, unsigned int numFrames) {
+    for (unsigned int i = 0; i < numFrames; i++, phase += inc) {
+        const float *p = t + (phase >> WT_FRAC_BITS);
+        float f = (phase & ((1 << WT_FRAC_BITS) - 1)) * WT_FRAC_SCALE;
+        out[i] = cubic ? wavetable_cubic(p, f) : p[0] + f * (p[1] - p[0]);
+    }
+}
+
+#if defined(CPU_SSE2)
+
+// SSE2 has no gather, so the table points are loaded one lane at a time
+static void wavetable_sse2(const float *t, bool cubic, uint32_t phase, uint32_t inc,
+                           double *out, unsigned int numFrames) {
+    __m128i p = _mm_setr_epi32(phase, phase + inc, phase + 2 * inc, phase + 3 * inc);
+    __m128i step = _mm_set1_epi32(4 * inc);
+    __m128i fracMask = _mm_set1_epi32((1 << WT_FRAC_BITS) - 1);
+    __m128 fracScale = _mm_set1_ps(WT_FRAC_SCALE);
+    int32_t idx[4];
+
+    unsigned int i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        _mm_storeu_si128((__m128i *) idx, _mm_srli_epi32(p, WT_FRAC_BITS));
+        __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, fracMask)), fracScale);
+        const float *p0 = t + idx[0], *p1 = t + idx[1], *p2 = t + idx[2], *p3 = t + idx[3];
+        __m128 y0 = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+        __m128 y1 = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+        __m128 y;
+
+        if (cubic) {
+            __m128 ym1 = _mm_setr_ps(p0[-1], p1[-1], p2[-1], p3[-1]);
+            __m128 y2 = _mm_setr_ps(p0[2], p1[2], p2[2], p3[2]);
+            __m128 c1 = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(y1, ym1));
+            __m128 c2 = _mm_add_ps(_mm_sub_ps(ym1, _mm_mul_ps(_mm_set1_ps(2.5f), y0)),
+                                   _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f), y1),
+                                              _mm_mul_ps(_mm_set1_ps(0.5f), y2)));
+            __m128 c3 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.5f), _mm_sub_ps(y2, ym1)),
+                                   _mm_mul_ps(_mm_set1_ps(1.5f), _mm_sub_ps(y0, y1)));
+            y = _mm_add_ps(_mm_mul_ps(c3, f), c2);
+            y = _mm_add_ps(_mm_mul_ps(y, f), c1);
+            y = _mm_add_ps(_mm_mul_ps(y, f), y0);
+        }
+        else {
+            y = _mm_add_ps(y0, _mm_mul_ps(f, _mm_sub_ps(y1, y0)));
+        }
+
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(y));
+        _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(y, y)));
+        p = _mm_add_epi32(p, step);
+    }
+    wavetable_scalar(t, cubic, phase + i * inc, inc, out + i, numFrames - i);
+}
+
+#endif
+
+#if defined(CPU_AVX2)
+
+CPU_AVX2_TARGET
+static void wavetable_avx2(const float *t, bool cubic, uint32_t phase, uint32_t inc,
+                           double *out, unsigned int numFrames) {
+    __m256i p = _mm256_setr_epi32(phase, phase + inc, phase + 2 * inc, phase + 3 * inc,
+                                  phase + 4 * inc, phase + 5 * inc, phase + 6 * inc, phase + 7 * inc);
+    __m256i step = _mm256_set1_epi32(8 * inc);
+    __m256i fracMask = _mm256_set1_epi32((1 << WT_FRAC_BITS) - 1);
+    __m256 fracScale = _mm256_set1_ps(WT_FRAC_SCALE);
+    __m256i one = _mm256_set1_epi32(1);
+
+    unsigned int i = 0;
+    for (; i + 8 <= numFrames; i += 8) {
+        __m256i idx = _mm256_srli_epi32(p, WT_FRAC_BITS);
+        __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(p, fracMask)), fracScale);
+        __m256 y0 = _mm256_i32gather_ps(t, idx, 4);
+        __m256 y1 = _mm256_i32gather_ps(t + 1, idx, 4);
+        __m256 y;
+
+        if (cubic) {
+            __m256 ym1 = _mm256_i32gather_ps(t - 1, idx, 4);
+            __m256 y2 = _mm256_i32gather_ps(t + 1, _mm256_add_epi32(idx, one), 4);
+            __m256 c1 = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_sub_ps(y1, ym1));
+            __m256 c2 = _mm256_add_ps(_mm256_sub_ps(ym1, _mm256_mul_ps(_mm256_set1_ps(2.5f), y0)),
+                                      _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), y1),
+                                                    _mm256_mul_ps(_mm256_set1_ps(0.5f), y2)));
+            __m256 c3 = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_sub_ps(y2, ym1)),
+                                      _mm256_mul_ps(_mm256_set1_ps(1.5f), _mm256_sub_ps(y0, y1)));
+            y = _mm256_add_ps(_mm256_mul_ps(c3, f), c2);
+            y = _mm256_add_ps(_mm256_mul_ps(y, f), c1);
+            y = _mm256_add_ps(_mm256_mul_ps(y, f), y0);
+        }
+        else {
+            y = _mm256_add_ps(y0, _mm256_mul_ps(f, _mm256_sub_ps(y1, y0)));
+        }
+
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(y)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)));
+        p = _mm256_add_epi32(p, step);
+    }
+    wavetable_scalar(t, cubic, phase + i * inc, inc, out + i, numFrames - i);
+}
+
+#endif
+
+void wavetable_render(const Wavetable &wt, bool cubic, uint32_t phase, uint32_t inc,
+                      double *out, unsigned int numFrames) {
+
+    // skip the leading guard so index 0 is the first table point
+    const float *t = wt.data + wavetable_level(inc) * WT_STRIDE + 1;
+
+#if defined(CPU_AVX2)
+    if (cpu_has_avx2()) { wavetable_avx2(t, cubic, phase, inc, out, numFrames); return; }
+#endif
+#if defined(CPU_SSE2)
+    wavetable_sse2(t, cubic, phase, inc, out, numFrames);
+#else
+    wavetable_scalar(t, cubic, phase, inc, out, numFrames);
+#endif
+}
@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// name: wavetable.h
+// desc: mip-mapped wavetable oscillator for arbitrary single-cycle waveforms.
+//
+//       A waveform loaded from disk is analyzed once and rebuilt as one table
+//       per octave, each holding only the harmonics that stay below Nyquist
+//       for the pitches it serves. All tables live in one cache-line-aligned
+//       block that is never written after loading, so any number of voices
+//       can read from the same Wavetable at once. Reads interpolate linearly
+//       or cubically between table points, four frames at a time with SSE2 or
+//       eight with AVX2.
+//-----------------------------------------------------------------------------
+#ifndef __WAVETABLE_H
+#define __WAVETABLE_H
+
+#include <stdint.h>
+
+// points per table (a power of two) and the accumulator bits above the index
+#define WT_BITS 11
+#define WT_SIZE (1 << WT_BITS)
+
+// one table per octave, from all WT_SIZE / 2 harmonics down to a single one
+#define WT_LEVELS (WT_BITS)
+
+// distance between tables: a leading guard point, the table, trailing guards,
+// padded so every table starts on a cache line
+#define WT_STRIDE (WT_SIZE + 16)
+
+struct Wavetable {
+
+    // WT_LEVELS tables of WT_STRIDE points, 64-byte aligned
+    float *data;
+
+    // block returned by malloc, freed by wavetable_free
+    void *block;
+};
+
+/*
+ * @function wavetable_load Reads a single cycle of raw 32-bit floats (host byte order)
+            and builds the octave tables, normalized to a peak of 1.
+ * @param wt Wavetable to fill.
+ * @param path File to read.
+ * @return False if the file could not be read or holds fewer than two samples.
+ */
+bool wavetable_load(Wavetable &wt, const char *path);
+
+/*
+ * @function wavetable_free Releases the tables of a loaded wavetable.
+ * @param wt Wavetable to release.
+ */
+void wavetable_free(Wavetable &wt);
+
+/*
+ * @function wavetable_render Renders numFrames consecutive frames from the octave
+            table that suits the increment.
+ * @param wt Loaded wavetable (only read).
+ * @param cubic True for 4-point cubic interpolation, false for linear.
+ * @param phase Accumulator phase of the first frame.
+ * @param inc Accumulator increment per frame.
+ * @param out Mono output buffer of numFrames samples.
+ * @param numFrames Number of frames to render.
+ */
+void wavetable_render(const Wavetable &wt, bool cubic, uint32_t phase, uint32_t inc,
+                      double *out, unsigned int numFrames);
+
+#endif
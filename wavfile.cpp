@@ -0,0 +1,124 @@
+//-----------------------------------------------------------------------------
+// name: wavfile.cpp
+// desc: little-endian sample conversion and WAV headers (see wavfile.h).
+//-----------------------------------------------------------------------------
+#include "wavfile.h"
+#include <string.h>
+
+// WAVE format tags
+#define WAV_TAG_PCM 1
+#define WAV_TAG_FLOAT 3
+
+/* -------------------------helpers------------------ */
+
+static unsigned char *wav_put16(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+    return p + 2;
+}
+
+static unsigned char *wav_put32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+    return p + 4;
+}
+
+static unsigned char *wav_put64(unsigned char *p, uint64_t v) {
+    p = wav_put32(p, (uint32_t) v);
+    return wav_put32(p, (uint32_t) (v >> 32));
+}
+
+static unsigned char *wav_tag(unsigned char *p, const char *tag) {
+    memcpy(p, tag, 4);
+    return p + 4;
+}
+
+static inline double wav_clip(double x) {
+    return x > 1.0 ? 1.0 : (x < -1.0 ? -1.0 : x);
+}
+
+// rounds half away from zero without calling into libm
+static inline int32_t wav_round(double x) {
+    return (int32_t) (x < 0 ? x - 0.5 : x + 0.5);
+}
+
+/* --------------------------header------------------ */
+
+int wav_sample_bytes(int format) {
+    switch(format) {
+        case WAV_S16: return 2;
+        case WAV_S24: return 3;
+        default: return 4;
+    }
+}
+
+bool wav_write_header(FILE *file, int format, int channels, unsigned int srate, uint64_t frames) {
+    unsigned char header[WAV_HEADER_BYTES];
+    unsigned char *p = header;
+
+    int bytes = wav_sample_bytes(format);
+    uint64_t dataBytes = frames * channels * bytes;
+    uint64_t riffBytes = dataBytes + WAV_HEADER_BYTES - 8;
+    bool rf64 = riffBytes > 0xFFFFFFFFu;
+
+    p = wav_tag(p, rf64 ? "RF64" : "RIFF");
+    p = wav_put32(p, rf64 ? 0xFFFFFFFFu : (uint32_t) riffBytes);
+    p = wav_tag(p, "WAVE");
+
+    // ds64 for RF64, otherwise a JUNK chunk of the same size that readers skip
+    p = wav_tag(p, rf64 ? "ds64" : "JUNK");
+    p = wav_put32(p, 28);
+    p = wav_put64(p, rf64 ? riffBytes : 0);
+    p = wav_put64(p, rf64 ? dataBytes : 0);
+    p = wav_put64(p, rf64 ? frames : 0);
+    p = wav_put32(p, 0);
+
+    p = wav_tag(p, "fmt ");
+    p = wav_put32(p, 16);
+    p = wav_put16(p, format == WAV_F32 ? WAV_TAG_FLOAT : WAV_TAG_PCM);
+    p = wav_put16(p, channels);
+    p = wav_put32(p, srate);
+    p = wav_put32(p, srate * channels * bytes);
+    p = wav_put16(p, channels * bytes);
+    p = wav_put16(p, bytes * 8);
+
+    p = wav_tag(p, "data");
+    p = wav_put32(p, rf64 ? 0xFFFFFFFFu : (uint32_t) dataBytes);
+
+    return fwrite(header, 1, WAV_HEADER_BYTES, file) == WAV_HEADER_BYTES;
+}
+
+/* -------------------------samples------------------ */
+
+size_t wav_convert(int format, const double *in, size_t samples, unsigned char *out) {
+    unsigned char *p = out;
+
+    switch(format) {
+        case WAV_S16:
+            for (size_t i = 0; i < samples; i++)
+                p = wav_put16(p, (uint32_t) wav_round(wav_clip(in[i]) * 32767.0));
+            break;
+
+        case WAV_S24:
+            for (size_t i = 0; i < samples; i++, p += 3) {
+                uint32_t v = (uint32_t) wav_round(wav_clip(in[i]) * 8388607.0);
+                p[0] = (unsigned char) v;
+                p[1] = (unsigned char) (v >> 8);
+                p[2] = (unsigned char) (v >> 16);
+            }
+            break;
+
+        default:
+            for (size_t i = 0; i < samples; i++) {
+                float f = (float) in[i];
+                uint32_t v;
+                memcpy(&v, &f, 4);
+                p = wav_put32(p, v);
+            }
+            break;
+    }
+
+    return p - out;
+}
@@ -0,0 +1,57 @@
+//-----------------------------------------------------------------------------
+// name: wavfile.h
+// desc: little-endian sample conversion and WAV headers for offline renders.
+//
+//       The header always takes WAV_HEADER_BYTES, so the byte offset of any
+//       frame is known before a single sample is written and several threads
+//       can write their parts of one file at once. Files whose data would not
+//       fit the 32-bit sizes of plain RIFF are written as RF64: the JUNK chunk
+//       reserved for that becomes the ds64 chunk that holds the 64-bit sizes.
+//-----------------------------------------------------------------------------
+#ifndef __WAVFILE_H
+#define __WAVFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+// RIFF header, JUNK or ds64 chunk, fmt chunk and the data chunk header
+#define WAV_HEADER_BYTES 80
+
+// sample formats an offline render can write
+enum WavFormat {
+    WAV_S16,    // 16-bit signed integer
+    WAV_S24,    // 24-bit signed integer, packed in three bytes
+    WAV_F32     // 32-bit IEEE float
+};
+
+/*
+ * @function wav_sample_bytes Size of one sample.
+ * @param format One of the WavFormat values.
+ * @return Bytes per sample.
+ */
+int wav_sample_bytes(int format);
+
+/*
+ * @function wav_write_header Writes a complete header at the current file position.
+ * @param file File open for writing.
+ * @param format One of the WavFormat values.
+ * @param channels Interleaved channels per frame.
+ * @param srate Sample rate in Hz.
+ * @param frames Frames the data chunk will hold.
+ * @return False if the header could not be written.
+ */
+bool wav_write_header(FILE *file, int format, int channels, unsigned int srate, uint64_t frames);
+
+/*
+ * @function wav_convert Converts samples in [-1, 1] to little-endian bytes. Integer
+            formats are clipped and rounded.
+ * @param format One of the WavFormat values.
+ * @param in Samples to convert.
+ * @param samples Number of samples (not frames).
+ * @param out Receives samples * wav_sample_bytes(format) bytes.
+ * @return Number of bytes written to out.
+ */
+size_t wav_convert(int format, const double *in, size_t samples, unsigned char *out);
+
+#endif